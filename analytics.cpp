@@ -1,152 +1,472 @@
 #include "analytics.h"
 
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-struct analytics_t analytics_init(void)
-{
-    struct analytics_t out;
-
-    out.powerpose_count = 0;
-    out.t_count = 0;
-    out.victory_count = 0;
-    out.usain_count = 0;
-    out.stop_count = 0;
-    out.flying_count = 0;
-    out.waving_r_count = 0;
-    out.waving_l_count = 0;
-    out.pointing_trf_count = 0;
-    out.pointing_rf_count = 0;
-    out.pointing_tlf_count = 0;
-    out.pointing_lf_count = 0;
-    out.pointing_tr_count = 0;
-    out.pointing_r_count = 0;
-    out.pointing_tl_count = 0;
-    out.pointing_l_count = 0;
-
-    return out;
-}
-
-void updateAnalytics(struct analytics_t counts) {
-    int result; // file renaming and removing error checking
-    char filename[] = "/home/capstone38/Desktop/electricTree/analytics.txt";
-    char temp_filename[] = "/home/capstone38/Desktop/electricTree/temp_analytics.txt";
-
-    // Update Analytics
-    if(ENABLE_ANALYTICS == true) {
-        bool error_detected_in = false;
-        bool error_detected_out = false;
-
-        ifstream inFile;
-        inFile.open(filename);
-        if(!inFile.is_open()) {
-            error_detected_in = true;
+analytics_counter_t analytics_counts[GESTURE_UNDEFINED];
+
+static uint32_t crc_table[256];
+
+static bool buildCrcTable(void)
+{
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for(int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+    return true;
+}
+
+uint32_t analyticsChecksum(const void *data, size_t size)
+{
+    static bool built = buildCrcTable();
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t crc = 0xffffffff;
+
+    (void)built;
+    for(size_t i = 0; i < size; i++)
+    {
+        crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+uint32_t analyticsDay(void)
+{
+    time_t now = time(nullptr);
+    struct tm local;
+
+    localtime_r(&now, &local);
+    return (uint32_t)((now + local.tm_gmtoff) / 86400);
+}
+
+// Write path through a temporary file and rename it into place, so readers
+// only ever see the old or the new contents
+static bool replaceFile(const string &path, const void *data, size_t size)
+{
+    string temp = path + ".tmp";
+    FILE *file = fopen(temp.c_str(), "wb");
+
+    if(!file)
+    {
+        perror("Error opening analytics file");
+        return false;
+    }
+
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = fflush(file) == 0 && ok;
+    ok = fsync(fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+
+    if(!ok || rename(temp.c_str(), path.c_str()) != 0)
+    {
+        perror("Error writing analytics file");
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// AnalyticsStore
+
+bool AnalyticsStore::open(const string &path, bool writable)
+{
+    size_t expected = sizeof(analytics_store_header_t) + GESTURE_UNDEFINED * sizeof(analytics_slot_t);
+    struct stat st;
+
+    close();
+
+    fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if(fd < 0)
+    {
+        perror("Error opening analytics store");
+        return false;
+    }
+
+    if(fstat(fd, &st) != 0)
+    {
+        perror("Error opening analytics store");
+        close();
+        return false;
+    }
+
+    created = st.st_size == 0 && writable;
+    if(created && ftruncate(fd, expected) != 0)
+    {
+        perror("Error creating analytics store");
+        close();
+        return false;
+    }
+    else if(!created && (size_t)st.st_size != expected)
+    {
+        cerr << "Error: " << path << " is not an analytics store this version can read" << endl;
+        close();
+        return false;
+    }
+
+    void *mem = mmap(nullptr, expected, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if(mem == MAP_FAILED)
+    {
+        perror("Error mapping analytics store");
+        close();
+        return false;
+    }
+
+    size = expected;
+    header = (analytics_store_header_t *)mem;
+    slots = (analytics_slot_t *)(header + 1);
+
+    if(created)
+    {
+        // The file is all zeroes; the magic goes in last
+        header->version = ANALYTICS_VERSION;
+        header->numGestures = GESTURE_UNDEFINED;
+        header->slotSize = sizeof(analytics_slot_t);
+        header->day = analyticsDay();
+        memcpy(header->magic, ANALYTICS_STORE_MAGIC, sizeof(header->magic));
+        sync();
+    }
+    else if(memcmp(header->magic, ANALYTICS_STORE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != ANALYTICS_VERSION || header->numGestures != GESTURE_UNDEFINED ||
+            header->slotSize != sizeof(analytics_slot_t))
+    {
+        cerr << "Error: " << path << " is not an analytics store this version can read" << endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void AnalyticsStore::close(void)
+{
+    if(header)
+    {
+        munmap(header, size);
+        header = nullptr;
+        slots = nullptr;
+    }
+
+    if(fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void AnalyticsStore::add(const analytics_delta_t &delta, uint64_t record)
+{
+    analytics_slot_t &slot = slots[delta.gesture];
+
+    if(__atomic_load_n(&slot.lastRecord, __ATOMIC_ACQUIRE) >= record)
+    {
+        return;
+    }
+
+    if(delta.day > __atomic_load_n(&header->day, __ATOMIC_RELAXED))
+    {
+        for(int g = 0; g < GESTURE_UNDEFINED; g++)
+        {
+            __atomic_store_n(&slots[g].today, 0, __ATOMIC_RELAXED);
         }
+        __atomic_store_n(&header->day, delta.day, __ATOMIC_RELEASE);
+    }
+
+    if(delta.day == __atomic_load_n(&header->day, __ATOMIC_RELAXED))
+    {
+        __atomic_fetch_add(&slot.today, delta.count, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&slot.overall, delta.count, __ATOMIC_RELAXED);
+
+    // The counts and the record number share a cache line
+    __atomic_store_n(&slot.lastRecord, record, __ATOMIC_RELEASE);
+}
+
+bool AnalyticsStore::sync(void)
+{
+    if(msync(header, size, MS_SYNC) != 0)
+    {
+        perror("Error syncing analytics store");
+        return false;
+    }
+    return true;
+}
+
+uint64_t AnalyticsStore::generation(void) const
+{
+    return __atomic_load_n(&header->generation, __ATOMIC_ACQUIRE);
+}
+
+void AnalyticsStore::setGeneration(uint64_t generation)
+{
+    __atomic_store_n(&header->generation, generation, __ATOMIC_RELEASE);
+}
+
+uint64_t AnalyticsStore::today(gestures_e gesture) const
+{
+    // A count from an earlier day is no longer today's
+    if(__atomic_load_n(&header->day, __ATOMIC_ACQUIRE) != analyticsDay())
+    {
+        return 0;
+    }
+    return __atomic_load_n(&slots[gesture].today, __ATOMIC_RELAXED);
+}
+
+uint64_t AnalyticsStore::overall(gestures_e gesture) const
+{
+    return __atomic_load_n(&slots[gesture].overall, __ATOMIC_RELAXED);
+}
+
+bool AnalyticsStore::importText(const string &path)
+{
+    ifstream inFile(path);
+    string line;
+    string name;
+    uint64_t today;
+    uint64_t overall;
+
+    if(!inFile.is_open())
+    {
+        return false;
+    }
+
+    // "ANALYTICS" and the rule under it
+    getline(inFile, line);
+    getline(inFile, line);
+
+    while(inFile >> name >> today >> overall)
+    {
+        if(!name.empty() && name.back() == ':')
+        {
+            name.pop_back();
+        }
+
+        gestures_e gesture = gestureFromName(name);
+        if(gesture < GESTURE_UNDEFINED)
+        {
+            __atomic_store_n(&slots[gesture].overall, overall, __ATOMIC_RELAXED);
+        }
+    }
+
+    return sync();
+}
+
+void AnalyticsStore::exportText(FILE *out) const
+{
+    fprintf(out, "ANALYTICS\n========================\n");
+
+    for(int g = 0; g < GESTURE_IDLE; g++)
+    {
+        fprintf(out, "%s: %llu %llu\n", gestureName((gestures_e)g),
+                (unsigned long long)today((gestures_e)g), (unsigned long long)overall((gestures_e)g));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AnalyticsFlusher
+
+bool AnalyticsFlusher::open(const string &logFile, const string &storeFile, const string &textFile)
+{
+    close();
+
+    logPath = logFile;
+
+    if(!store.open(storeFile, true))
+    {
+        return false;
+    }
+
+    if(store.wasCreated())
+    {
+        store.importText(textFile);
+    }
+
+    // Add whatever the last run logged but may not have got into the store
+    replayLog();
+    store.sync();
+
+    if(!startLog(store.generation() + 1))
+    {
+        return false;
+    }
+
+    running = true;
+    worker = thread(&AnalyticsFlusher::run, this);
+    return true;
+}
+
+void AnalyticsFlusher::close(void)
+{
+    if(running)
+    {
+        running = false;
+        worker.join();
+    }
+
+    if(log)
+    {
+        flush();
+        fclose(log);
+        log = nullptr;
+    }
+
+    store.close();
+}
+
+// Read the whole log in one go and add every record up to the first one
+// that fails its checksum, which can only be a torn write at the tail.
+// Records the store already holds are skipped by AnalyticsStore::add().
+void AnalyticsFlusher::replayLog(void)
+{
+    analytics_log_header_t header;
+    FILE *file = fopen(logPath.c_str(), "rb");
+
+    if(!file)
+    {
+        return;
+    }
+
+    if(fread(&header, sizeof(header), 1, file) != 1 ||
+       memcmp(header.magic, ANALYTICS_LOG_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != ANALYTICS_VERSION || header.recordSize != sizeof(analytics_delta_t))
+    {
+        cerr << "Error: " << logPath << " is not an analytics log this version can read" << endl;
+        fclose(file);
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file) - (long)sizeof(header);
+    fseek(file, sizeof(header), SEEK_SET);
+
+    vector<analytics_delta_t> records(size > 0 ? size / sizeof(analytics_delta_t) : 0);
+    size_t n = records.empty() ? 0 : fread(records.data(), sizeof(analytics_delta_t), records.size(), file);
+    fclose(file);
+
+    for(size_t i = 0; i < n; i++)
+    {
+        const analytics_delta_t &delta = records[i];
+        if(delta.checksum != analyticsChecksum(&delta, offsetof(analytics_delta_t, checksum)) ||
+           delta.gesture >= GESTURE_UNDEFINED)
+        {
+            cerr << "Error: " << logPath << " is torn after " << i << " records" << endl;
+            break;
+        }
+        store.add(delta, analyticsRecord(header.generation, i));
+    }
+}
+
+// The store learns the new generation before the old log goes, so record
+// numbers never go backwards
+bool AnalyticsFlusher::startLog(uint64_t newGeneration)
+{
+    analytics_log_header_t header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ANALYTICS_LOG_MAGIC, sizeof(header.magic));
+    header.version = ANALYTICS_VERSION;
+    header.recordSize = sizeof(analytics_delta_t);
+    header.generation = newGeneration;
+
+    if(log)
+    {
+        fclose(log);
+        log = nullptr;
+    }
+
+    store.setGeneration(newGeneration);
+    if(!store.sync() || !replaceFile(logPath, &header, sizeof(header)))
+    {
+        return false;
+    }
+
+    log = fopen(logPath.c_str(), "ab");
+    if(!log)
+    {
+        perror("Error opening analytics log");
+        return false;
+    }
+
+    generation = newGeneration;
+    logRecords = 0;
+    return true;
+}
+
+void AnalyticsFlusher::flush(void)
+{
+    analytics_delta_t batch[GESTURE_UNDEFINED];
+    uint32_t day = analyticsDay();
+    size_t n = 0;
+
+    for(int g = 0; g < GESTURE_UNDEFINED; g++)
+    {
+        uint32_t count = analytics_counts[g].count.exchange(0, memory_order_relaxed);
+        if(count == 0)
+        {
+            continue;
+        }
+
+        analytics_delta_t &delta = batch[n++];
+        memset(&delta, 0, sizeof(delta));
+        delta.day = day;
+        delta.gesture = (uint8_t)g;
+        delta.count = count;
+        delta.checksum = analyticsChecksum(&delta, offsetof(analytics_delta_t, checksum));
+    }
+
+    if(n == 0)
+    {
+        return;
+    }
+
+    // Log first, so a crash before the store is synced can be replayed
+    if(!log || fwrite(batch, sizeof(analytics_delta_t), n, log) != n || fflush(log) != 0 ||
+       fdatasync(fileno(log)) != 0)
+    {
+        perror("Error writing analytics log");
+    }
+
+    for(size_t i = 0; i < n; i++)
+    {
+        store.add(batch[i], analyticsRecord(generation, logRecords + i));
+    }
+    logRecords += n;
+    store.sync();
+}
+
+void AnalyticsFlusher::run(void)
+{
+    chrono::steady_clock::time_point lastFlush = chrono::steady_clock::now();
+
+    while(running)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
 
-        ofstream outFile;
-        outFile.open(temp_filename);
-        if(!outFile.is_open()) {
-            error_detected_out = true;
+        if(!flushRequested.exchange(false) &&
+           chrono::steady_clock::now() - lastFlush < chrono::seconds(ANALYTICS_FLUSH_SEC))
+        {
+            continue;
         }
+        lastFlush = chrono::steady_clock::now();
 
-        if(error_detected_in == false && error_detected_out == true) inFile.close();
-        if(error_detected_in == true && error_detected_out == false) outFile.close();
-
-        if(error_detected_in == false && error_detected_out == false) {
-
-            inFile >> format;
-            outFile << format << endl;
-
-            inFile >> format;
-            outFile << format << endl;
-
-
-            while(inFile >> gesture >> gestureCount >> totalCount) {
-                if(gesture == "USAIN:"){
-                    totalCount += counts.usain_count;
-                    gestureCount = counts.usain_count;
-                }
-                else if (gesture == "FLEXING:") {
-                    totalCount += counts.powerpose_count;
-                    gestureCount = counts.powerpose_count;
-                }
-                else if (gesture == "VICTORY:") {
-                    totalCount += counts.victory_count;
-                    gestureCount = counts.victory_count;
-                }
-                else if (gesture == "TPOSE:") {
-                    totalCount += counts.t_count;
-                    gestureCount = counts.t_count;
-                }
-                else if (gesture == "STOP:") {
-                    totalCount += counts.stop_count;
-                    gestureCount = counts.stop_count;
-                }
-                else if (gesture == "POINTING_TRF:") {
-                    totalCount += counts.pointing_trf_count;
-                    gestureCount = counts.pointing_trf_count;
-                }
-                else if (gesture == "POINTING_RF:") {
-                    totalCount += counts.pointing_rf_count;
-                    gestureCount = counts.pointing_rf_count;
-                }
-                else if (gesture == "POINTING_TLF:") {
-                    totalCount += counts.pointing_tlf_count;
-                    gestureCount = counts.pointing_tlf_count;
-                }
-                else if (gesture == "POINTING_LF:") {
-                    totalCount += counts.pointing_lf_count;
-                    gestureCount = counts.pointing_lf_count;
-                }
-                else if (gesture == "POINTING_TR:") {
-                    totalCount += counts.pointing_tr_count;
-                    gestureCount = counts.pointing_tr_count;
-                }
-                else if (gesture == "POINTING_R:") {
-                    totalCount += counts.pointing_r_count;
-                    gestureCount = counts.pointing_r_count;
-                }
-                else if (gesture == "POINTING_TL:") {
-                    totalCount += counts.pointing_tl_count;
-                    gestureCount = counts.pointing_tl_count;
-                }
-                else if (gesture == "POINTING_L:") {
-                    totalCount += counts.pointing_l_count;
-                    gestureCount = counts.pointing_l_count;
-                }
-                else if (gesture == "FLYING:") {
-                    totalCount += counts.flying_count;
-                    gestureCount = counts.flying_count;
-                }
-                else if (gesture == "WAVING_R:") {
-                    totalCount += counts.waving_r_count;
-                    gestureCount = counts.waving_r_count;
-                }
-                else if (gesture == "WAVING_L:") {
-                    totalCount += counts.waving_l_count;
-                    gestureCount = counts.waving_l_count;
-                }
-
-                // Present day gestures count
-                outFile << gesture << " " << gestureCount << " ";
-
-
-                // Total Count of Gestures to date
-                outFile << total << " " << totalCount << endl;
-            }
-
-            inFile.close();
-            outFile.close();
-
-            result = remove(filename);
-            if(result != 0)
-                perror("Error deleting file");
-            else
-                puts("File successfully deleted");
-
-            result = rename(temp_filename, filename);
-            if(result != 0)
-                perror("Error renaming file");
-            else
-                puts("File successfully renamed");
+        flush();
+        if(logRecords >= ANALYTICS_COMPACT_RECORDS)
+        {
+            startLog(generation + 1);
         }
     }
 }
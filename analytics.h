@@ -2,42 +2,171 @@
 #define ANALYTICS_H
 
 #include "gesture.h"
-#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
 #include <string>
-#include <fstream>
+#include <thread>
 
 using namespace std;
 
-void updateAnalytics(struct analytics_t counts);
-static string format;  // random strings for formating
-static string total;   // "TOTAL:","TODAY_TOTAL_COUNT:", "OVERALL_TOTAL_COUNT:"
-static int totalCount;  // "TOTAL: X","TODAY_TOTAL_COUNT: X", "OVERALL_TOTAL_COUNT: X"
-static string gesture; // "WAVING_R:", "USAIN:", ...
-static int gestureCount;   // "WAVING_R: X", "USAIN: X", ...
-
 #define ENABLE_ANALYTICS false
 
-struct analytics_t
-{
-    int powerpose_count;
-    int t_count;
-    int victory_count;
-    int usain_count;
-    int stop_count;
-    int flying_count;
-    int waving_r_count;
-    int waving_l_count;
-    int pointing_trf_count;
-    int pointing_rf_count;
-    int pointing_tlf_count;
-    int pointing_lf_count;
-    int pointing_tr_count;
-    int pointing_r_count;
-    int pointing_tl_count;
-    int pointing_l_count;
+#define ANALYTICS_FILE "/home/capstone38/Desktop/electricTree/analytics.txt"
+#define ANALYTICS_STORE_FILE "/home/capstone38/Desktop/electricTree/analytics.store"
+#define ANALYTICS_LOG_FILE "/home/capstone38/Desktop/electricTree/analytics.log"
+
+// Counts reach the log at least this often
+#define ANALYTICS_FLUSH_SEC 10
+// Every record is in the store once flushed; the log starts over at this size
+#define ANALYTICS_COMPACT_RECORDS 4096
+
+#define CACHE_LINE_SIZE 64
+
+// Crash-safe analytics
+//
+// Clips count themselves with countGesture(), a relaxed atomic add on a
+// counter with a cache line to itself. An AnalyticsFlusher thread swaps the
+// counters out every ANALYTICS_FLUSH_SEC, appends the deltas to a log of
+// checksummed records, then adds them in place to a memory-mapped
+// AnalyticsStore and msyncs it. Each store slot remembers the last log
+// record added to it, so replaying a log after a crash never counts a record
+// twice. etanalytics exports the store as the old analytics.txt.
+
+struct alignas(CACHE_LINE_SIZE) analytics_counter_t
+{
+    atomic<uint32_t> count;
 };
 
-struct analytics_t analytics_init(void);
+extern analytics_counter_t analytics_counts[GESTURE_UNDEFINED];
 
-#endif // ANALYTICS_H
+inline void countGesture(gestures_e gesture)
+{
+    analytics_counts[gesture].count.fetch_add(1, memory_order_relaxed);
+}
+
+#define ANALYTICS_LOG_MAGIC "ETAL"
+#define ANALYTICS_STORE_MAGIC "ETAS"
+#define ANALYTICS_VERSION 1
+
+struct analytics_log_header_t
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t generation;
+};
+
+struct analytics_delta_t
+{
+    uint32_t day;               // local days since the epoch when flushed
+    uint8_t gesture;            // gestures_e
+    uint8_t reserved[3];
+    uint32_t count;
+    uint32_t checksum;          // crc32 of the fields above
+};
+
+// Store layout: analytics_store_header_t, then one analytics_slot_t per
+// gesture, all in host byte order
+struct analytics_store_header_t
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t numGestures;
+    uint32_t slotSize;
+    uint32_t day;               // the day every slot's today belongs to
+    uint64_t generation;        // newest log generation started
+    uint64_t reserved[5];
+};
+
+struct analytics_slot_t
+{
+    uint64_t today;
+    uint64_t overall;
+    uint64_t lastRecord;        // newest log record added, see analyticsRecord()
+    uint64_t reserved;
+};
+
+static_assert(sizeof(analytics_log_header_t) == 16, "analytics log header must stay 16 bytes");
+static_assert(sizeof(analytics_delta_t) == 16, "analytics delta must stay 16 bytes");
+static_assert(sizeof(analytics_store_header_t) == 64, "analytics store header must stay 64 bytes");
+static_assert(sizeof(analytics_slot_t) == 32, "analytics slot must stay 32 bytes");
 
+uint32_t analyticsChecksum(const void *data, size_t size);
+uint32_t analyticsDay(void);
+
+// Orders every record ever logged: generation, then position in that log
+inline uint64_t analyticsRecord(uint64_t generation, size_t index)
+{
+    return (generation << 32) | (uint64_t)(index + 1);
+}
+
+class AnalyticsStore
+{
+private:
+    int fd;
+    size_t size;
+    analytics_store_header_t *header;
+    analytics_slot_t *slots;
+    bool created;
+
+    AnalyticsStore(const AnalyticsStore &) = delete;
+    AnalyticsStore &operator=(const AnalyticsStore &) = delete;
+
+public:
+    AnalyticsStore() : fd(-1), size(0), header(nullptr), slots(nullptr), created(false) {}
+    ~AnalyticsStore() { close(); }
+
+    // Maps the store, creating it if writable and it does not exist yet
+    bool open(const string &path, bool writable);
+    void close(void);
+    bool isOpen(void) const { return header != nullptr; }
+    bool wasCreated(void) const { return created; }
+
+    // Add count to a gesture unless the slot already holds this log record
+    void add(const analytics_delta_t &delta, uint64_t record);
+    bool sync(void);
+
+    uint64_t generation(void) const;
+    void setGeneration(uint64_t generation);
+
+    uint64_t today(gestures_e gesture) const;
+    uint64_t overall(gestures_e gesture) const;
+
+    // The analytics.txt format: two header lines, then "NAME: today overall"
+    bool importText(const string &path);
+    void exportText(FILE *out) const;
+};
+
+class AnalyticsFlusher
+{
+private:
+    string logPath;
+    AnalyticsStore store;
+    FILE *log;
+    uint64_t generation;
+    size_t logRecords;
+    atomic<bool> running;
+    atomic<bool> flushRequested;
+    thread worker;
+
+    bool startLog(uint64_t newGeneration);
+    void replayLog(void);
+    void flush(void);
+    void run(void);
+
+public:
+    AnalyticsFlusher() : log(nullptr), generation(0), logRecords(0), running(false), flushRequested(false) {}
+    ~AnalyticsFlusher() { close(); }
+
+    // Recovers whatever an earlier run left in the log, then starts flushing.
+    // A new store starts from the overall counts in textFile, if there is one.
+    bool open(const string &logFile, const string &storeFile, const string &textFile);
+    // Final flush
+    void close(void);
+
+    // Flush on the flusher thread now rather than at the next period
+    void requestFlush(void) { flushRequested = true; }
+};
+
+#endif // ANALYTICS_H
@@ -0,0 +1,189 @@
+#include "boxindex.h"
+
+#include <algorithm>
+#include <climits>
+
+// Per box bounds and centre while the tree is built
+struct box_bounds_t
+{
+    match_band_t band;
+    int32_t lo[NUM_MATCH_VALUES];
+    int32_t hi[NUM_MATCH_VALUES];
+    int64_t centre[NUM_MATCH_VALUES];
+};
+
+void BoxIndex::build(const threshold_box_t *boxes, int n)
+{
+    vector<box_bounds_t> building(n);
+
+    nodes.clear();
+    order.resize(n);
+
+    for(int i = 0; i < n; i++)
+    {
+        box_bounds_t &b = building[i];
+
+        matchEnvelope(boxes[i], b.lo, b.hi, &b.band);
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            // Open sides count as the edge of the coordinate range, so an
+            // unbounded value does not look spread out
+            int64_t lo = max<int64_t>(b.lo[d], -MAXCOORD);
+            int64_t hi = min<int64_t>(b.hi[d], MAXCOORD);
+            b.centre[d] = lo + hi;
+        }
+        order[i] = i;
+    }
+
+    // A tree per form: a one-arm box is open on the other arm's values and
+    // would leave every node above it open there too
+    sort(order.begin(), order.end(), [boxes](int32_t a, int32_t b) { return boxes[a].form < boxes[b].form; });
+    roots.clear();
+    for(int first = 0; first < n; )
+    {
+        int last = first;
+        while(last < n && boxes[order[last]].form == boxes[order[first]].form)
+        {
+            last++;
+        }
+        roots.push_back(buildNode(building.data(), first, last - first, 0));
+        first = last;
+    }
+
+    entries.resize(n);
+    for(int i = 0; i < n; i++)
+    {
+        const box_bounds_t &b = building[order[i]];
+        box_index_entry_t &e = entries[i];
+
+        copy(b.lo, b.lo + NUM_MATCH_VALUES, e.lo);
+        copy(b.hi, b.hi + NUM_MATCH_VALUES, e.hi);
+        e.box = order[i];
+        e.band = b.band.off ? -1 : b.band.right ? DELTA_RY : DELTA_LY;
+        e.below = b.band.below;
+        e.above = b.band.above;
+    }
+    order.clear();
+}
+
+int BoxIndex::buildNode(const box_bounds_t *building, int first, int count, int depth)
+{
+    int self = nodes.size();
+    box_index_node_t node;
+
+    for(int d = 0; d < NUM_MATCH_VALUES; d++)
+    {
+        node.lo[d] = INT_MAX;
+        node.hi[d] = INT_MIN;
+    }
+    for(int i = first; i < first + count; i++)
+    {
+        const box_bounds_t &b = building[order[i]];
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            node.lo[d] = min(node.lo[d], b.lo[d]);
+            node.hi[d] = max(node.hi[d], b.hi[d]);
+        }
+    }
+
+    node.first = first;
+    node.count = count;
+    nodes.push_back(node);
+
+    if(count <= BOX_INDEX_LEAF || depth + 1 >= BOX_INDEX_MAX_DEPTH)
+    {
+        return self;
+    }
+
+    // Split at the median along the value whose box centres spread widest
+    int axis = 0;
+    int64_t widest = -1;
+    for(int d = 0; d < NUM_MATCH_VALUES; d++)
+    {
+        int64_t lo = INT64_MAX;
+        int64_t hi = INT64_MIN;
+        for(int i = first; i < first + count; i++)
+        {
+            lo = min(lo, building[order[i]].centre[d]);
+            hi = max(hi, building[order[i]].centre[d]);
+        }
+        if(hi - lo > widest)
+        {
+            widest = hi - lo;
+            axis = d;
+        }
+    }
+
+    int half = count / 2;
+    nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+                [building, axis](int32_t a, int32_t b) { return building[a].centre[axis] < building[b].centre[axis]; });
+
+    buildNode(building, first, half, depth + 1);
+    int second = buildNode(building, first + half, count - half, depth + 1);
+
+    nodes[self].first = second;
+    nodes[self].count = 0;
+    return self;
+}
+
+int BoxIndex::query(const jointCoords_t &jointCoords, int32_t *hits) const
+{
+    int32_t values[NUM_MATCH_VALUES];
+    int stack[BOX_INDEX_STACK];
+    int depth = 0;
+    int numHits = 0;
+
+    matchValues(jointCoords, values);
+
+    for(int root : roots)
+    {
+        stack[depth++] = root;
+    }
+
+    while(depth > 0)
+    {
+        int n = stack[--depth];
+
+        while(true)
+        {
+            const box_index_node_t &node = nodes[n];
+            int d = 0;
+
+            while(d < NUM_MATCH_VALUES && node.lo[d] <= values[d] && values[d] <= node.hi[d])
+            {
+                d++;
+            }
+            if(d < NUM_MATCH_VALUES)
+            {
+                break;
+            }
+
+            if(node.count > 0)
+            {
+                for(int i = node.first; i < node.first + node.count; i++)
+                {
+                    const box_index_entry_t &e = entries[i];
+                    int d = 0;
+
+                    // Most boxes fail on their first value or two
+                    while(d < NUM_MATCH_VALUES && e.lo[d] <= values[d] && values[d] <= e.hi[d])
+                    {
+                        d++;
+                    }
+                    if(d == NUM_MATCH_VALUES &&
+                       (e.band < 0 || e.below > values[e.band] || values[e.band] > e.above))
+                    {
+                        hits[numHits++] = e.box;
+                    }
+                }
+                break;
+            }
+
+            stack[depth++] = node.first;
+            n++;
+        }
+    }
+
+    sort(hits, hits + numHits);
+    return numHits;
+}
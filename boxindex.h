@@ -0,0 +1,70 @@
+#ifndef BOXINDEX_H
+#define BOXINDEX_H
+
+#include <cstdint>
+#include <vector>
+
+#include "gesture.h"
+#include "boxmatcher.h"
+
+using namespace std;
+
+// Boxes per leaf, tested one by one once the tree narrows down to it
+#define BOX_INDEX_LEAF 8
+// Median splits keep a tree under log2(boxes) + 1 deep; the query stack
+// also holds the roots of the other trees
+#define BOX_INDEX_MAX_DEPTH 40
+#define BOX_INDEX_STACK (BOX_INDEX_MAX_DEPTH + NUM_THRESHOLD_FORMS)
+
+// One node of the tree: the bounds of everything below it over the match
+// values, then either its boxes (leaf) or where its second child starts.
+// The first child of an inner node always follows it directly.
+struct box_index_node_t
+{
+    int32_t lo[NUM_MATCH_VALUES];
+    int32_t hi[NUM_MATCH_VALUES];
+    int32_t first;      // leaf: first of its entries, inner: second child
+    int32_t count;      // leaf: number of boxes, inner: 0
+};
+
+static_assert(sizeof(box_index_node_t) == 64, "box_index_node_t must fill exactly one cache line");
+
+// A box as its leaf tests it: the same rewrite BoxMatcher uses, so the
+// result is exactly boxContains()
+struct box_index_entry_t
+{
+    int32_t lo[NUM_MATCH_VALUES];
+    int32_t hi[NUM_MATCH_VALUES];
+    int32_t box;
+    int32_t band;       // match value of the y band, -1 if none
+    int32_t below;
+    int32_t above;
+};
+
+struct box_bounds_t;
+
+// Bounding box tree over threshold boxes in the space of the match values.
+// A frame only descends into the nodes whose bounds hold its values, so the
+// work grows with the depth of the tree and the number of boxes near the
+// frame, not with the number of boxes. Read-only after build().
+class BoxIndex
+{
+private:
+    vector<box_index_node_t> nodes;
+    vector<int32_t> roots;                 // one tree per threshold form
+    vector<box_index_entry_t> entries;     // grouped by leaf
+    vector<int32_t> order;                 // box numbers while building
+
+    int buildNode(const box_bounds_t *building, int first, int count, int depth);
+
+public:
+    void build(const threshold_box_t *boxes, int n);
+
+    // Numbers of the boxes that contain the frame, ascending, the same set
+    // boxContains() gives. hits must have room for every box.
+    int query(const jointCoords_t &jointCoords, int32_t *hits) const;
+
+    int numNodes(void) const { return nodes.size(); }
+};
+
+#endif // BOXINDEX_H
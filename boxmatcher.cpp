@@ -0,0 +1,277 @@
+#include "boxmatcher.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+typedef void (*match_kernel_t)(const int32_t *rows, int stride, const int32_t *values, uint64_t *mask);
+
+#if !defined(__SSE2__)
+// Portable version of the SIMD kernels below, lane by lane
+static void matchScalar(const int32_t *rows, int stride, const int32_t *values, uint64_t *mask)
+{
+    for(int i = 0; i < stride; i++)
+    {
+        bool fail = false;
+
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            fail |= rows[(MATCH_ROW_LO + d) * stride + i] > values[d];
+            fail |= values[d] > rows[(MATCH_ROW_HI + d) * stride + i];
+        }
+
+        int32_t band = rows[MATCH_ROW_BAND_RIGHT * stride + i] ? values[DELTA_RY] : values[DELTA_LY];
+        bool pass = rows[MATCH_ROW_BAND_BELOW * stride + i] > band ||
+                    band > rows[MATCH_ROW_BAND_ABOVE * stride + i] ||
+                    rows[MATCH_ROW_BAND_OFF * stride + i];
+
+        if(!fail && pass)
+        {
+            mask[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+    }
+}
+#endif
+
+#if defined(__SSE2__)
+static void matchSse2(const int32_t *rows, int stride, const int32_t *values, uint64_t *mask)
+{
+    __m128i v[NUM_MATCH_VALUES];
+    for(int d = 0; d < NUM_MATCH_VALUES; d++)
+    {
+        v[d] = _mm_set1_epi32(values[d]);
+    }
+    const __m128i ones = _mm_set1_epi32(-1);
+
+    for(int i = 0; i < stride; i += 4)
+    {
+        __m128i fail = _mm_setzero_si128();
+
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            __m128i lo = _mm_load_si128((const __m128i *)(rows + (MATCH_ROW_LO + d) * stride + i));
+            __m128i hi = _mm_load_si128((const __m128i *)(rows + (MATCH_ROW_HI + d) * stride + i));
+            fail = _mm_or_si128(fail, _mm_or_si128(_mm_cmpgt_epi32(lo, v[d]), _mm_cmpgt_epi32(v[d], hi)));
+        }
+
+        __m128i right = _mm_load_si128((const __m128i *)(rows + MATCH_ROW_BAND_RIGHT * stride + i));
+        __m128i below = _mm_load_si128((const __m128i *)(rows + MATCH_ROW_BAND_BELOW * stride + i));
+        __m128i above = _mm_load_si128((const __m128i *)(rows + MATCH_ROW_BAND_ABOVE * stride + i));
+        __m128i off = _mm_load_si128((const __m128i *)(rows + MATCH_ROW_BAND_OFF * stride + i));
+        __m128i band = _mm_or_si128(_mm_and_si128(right, v[DELTA_RY]), _mm_andnot_si128(right, v[DELTA_LY]));
+        __m128i pass = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(below, band), _mm_cmpgt_epi32(band, above)), off);
+        fail = _mm_or_si128(fail, _mm_andnot_si128(pass, ones));
+
+        uint64_t matched = ~_mm_movemask_ps(_mm_castsi128_ps(fail)) & 0xf;
+        mask[i >> 6] |= matched << (i & 63);
+    }
+}
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+__attribute__((target("avx2")))
+static void matchAvx2(const int32_t *rows, int stride, const int32_t *values, uint64_t *mask)
+{
+    __m256i v[NUM_MATCH_VALUES];
+    for(int d = 0; d < NUM_MATCH_VALUES; d++)
+    {
+        v[d] = _mm256_set1_epi32(values[d]);
+    }
+    const __m256i ones = _mm256_set1_epi32(-1);
+
+    for(int i = 0; i < stride; i += 8)
+    {
+        __m256i fail = _mm256_setzero_si256();
+
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            __m256i lo = _mm256_load_si256((const __m256i *)(rows + (MATCH_ROW_LO + d) * stride + i));
+            __m256i hi = _mm256_load_si256((const __m256i *)(rows + (MATCH_ROW_HI + d) * stride + i));
+            fail = _mm256_or_si256(fail, _mm256_or_si256(_mm256_cmpgt_epi32(lo, v[d]), _mm256_cmpgt_epi32(v[d], hi)));
+        }
+
+        __m256i right = _mm256_load_si256((const __m256i *)(rows + MATCH_ROW_BAND_RIGHT * stride + i));
+        __m256i below = _mm256_load_si256((const __m256i *)(rows + MATCH_ROW_BAND_BELOW * stride + i));
+        __m256i above = _mm256_load_si256((const __m256i *)(rows + MATCH_ROW_BAND_ABOVE * stride + i));
+        __m256i off = _mm256_load_si256((const __m256i *)(rows + MATCH_ROW_BAND_OFF * stride + i));
+        __m256i band = _mm256_blendv_epi8(v[DELTA_LY], v[DELTA_RY], right);
+        __m256i pass = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(below, band), _mm256_cmpgt_epi32(band, above)), off);
+        fail = _mm256_or_si256(fail, _mm256_andnot_si256(pass, ones));
+
+        uint64_t matched = ~_mm256_movemask_ps(_mm256_castsi256_ps(fail)) & 0xff;
+        mask[i >> 6] |= matched << (i & 63);
+    }
+}
+#endif
+
+static match_kernel_t selectKernel(const char **name)
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return matchAvx2;
+    }
+#endif
+#if defined(__SSE2__)
+    *name = "sse2";
+    return matchSse2;
+#else
+    *name = "scalar";
+    return matchScalar;
+#endif
+}
+
+static const char *kernel_name = nullptr;
+static match_kernel_t kernel(void)
+{
+    static match_kernel_t selected = selectKernel(&kernel_name);
+    return selected;
+}
+
+const char *BoxMatcher::kernelName(void)
+{
+    kernel();
+    return kernel_name;
+}
+
+void matchEnvelope(const threshold_box_t &box, int32_t *lo, int32_t *hi, match_band_t *band)
+{
+    int32_t below = 0;
+    int32_t above = 0;
+    int32_t right = 0;
+    int32_t off = -1;
+
+    for(int d = 0; d < NUM_MATCH_VALUES; d++)
+    {
+        lo[d] = INT_MIN;
+        hi[d] = INT_MAX;
+    }
+
+    switch(box.form)
+    {
+    case THRESHOLD_FORM_LEFT_ARM:
+        for(int d = DELTA_LX; d <= DELTA_LZ; d++)
+        {
+            lo[d] = box.min[d];
+            hi[d] = box.max[d];
+        }
+        below = box.max[DELTA_RY];
+        above = box.min[DELTA_RY];
+        right = -1;
+        off = 0;
+        break;
+
+    case THRESHOLD_FORM_RIGHT_ARM:
+        for(int d = DELTA_RX; d <= DELTA_RZ; d++)
+        {
+            lo[d] = box.min[d];
+            hi[d] = box.max[d];
+        }
+        below = box.max[DELTA_LY];
+        above = box.min[DELTA_LY];
+        off = 0;
+        break;
+
+    case THRESHOLD_FORM_STOP:
+        lo[DELTA_LX] = box.min[DELTA_LX];
+        hi[DELTA_LX] = box.max[DELTA_LX];
+        lo[DELTA_LY] = box.min[DELTA_LY];
+        hi[DELTA_LY] = box.max[DELTA_LY];
+        hi[MATCH_VALUE_LHANDZ] = box.max[DELTA_LZ];
+        break;
+
+    default:
+        for(int d = 0; d < NUM_DELTAS; d++)
+        {
+            lo[d] = box.min[d];
+            hi[d] = box.max[d];
+        }
+        break;
+    }
+
+    if(band)
+    {
+        band->below = below;
+        band->above = above;
+        band->right = right;
+        band->off = off;
+    }
+}
+
+BoxMatcher::~BoxMatcher()
+{
+    free(rows);
+}
+
+bool BoxMatcher::build(const threshold_box_t *boxes, int n)
+{
+    int padded = (n + MATCH_LANES - 1) / MATCH_LANES * MATCH_LANES;
+    void *mem = nullptr;
+
+    if(padded > 0 && posix_memalign(&mem, MATCH_ALIGN, padded * NUM_MATCH_ROWS * sizeof(int32_t)) != 0)
+    {
+        return false;
+    }
+
+    free(rows);
+    rows = (int32_t *)mem;
+    numBoxes = n;
+    stride = padded;
+
+    for(int i = 0; i < padded; i++)
+    {
+        int32_t lo[NUM_MATCH_VALUES];
+        int32_t hi[NUM_MATCH_VALUES];
+        match_band_t band;
+
+        if(i >= n)
+        {
+            // Padding lanes can never match
+            for(int d = 0; d < NUM_MATCH_VALUES; d++)
+            {
+                lo[d] = INT_MIN;
+                hi[d] = INT_MAX;
+            }
+            lo[DELTA_LX] = INT_MAX;
+            hi[DELTA_LX] = INT_MIN;
+            band.below = 0;
+            band.above = 0;
+            band.right = 0;
+            band.off = -1;
+        }
+        else
+        {
+            matchEnvelope(boxes[i], lo, hi, &band);
+        }
+
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            rows[(MATCH_ROW_LO + d) * stride + i] = lo[d];
+            rows[(MATCH_ROW_HI + d) * stride + i] = hi[d];
+        }
+        rows[MATCH_ROW_BAND_BELOW * stride + i] = band.below;
+        rows[MATCH_ROW_BAND_ABOVE * stride + i] = band.above;
+        rows[MATCH_ROW_BAND_RIGHT * stride + i] = band.right;
+        rows[MATCH_ROW_BAND_OFF * stride + i] = band.off;
+    }
+
+    return true;
+}
+
+void BoxMatcher::match(const jointCoords_t &jointCoords, uint64_t *mask) const
+{
+    int32_t values[NUM_MATCH_VALUES];
+
+    matchValues(jointCoords, values);
+
+    memset(mask, 0, maskWords() * sizeof(uint64_t));
+    if(stride > 0)
+    {
+        kernel()(rows, stride, values, mask);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef BOXMATCHER_H
+#define BOXMATCHER_H
+
+#include <cstdint>
+
+#include "gesture.h"
+
+using namespace std;
+
+// Boxes are matched MATCH_LANES at a time; the row stride is padded to this
+#define MATCH_LANES 8
+#define MATCH_ALIGN 32
+
+// Values a box is tested against: the six shoulder minus hand deltas, plus
+// the absolute left hand depth used by THRESHOLD_FORM_STOP
+#define MATCH_VALUE_LHANDZ NUM_DELTAS
+#define NUM_MATCH_VALUES (NUM_DELTAS + 1)
+
+// Rows of the structure-of-arrays layout, each one int32 per box.
+// Every form is rewritten as: all values inside [lo, hi], and unless the
+// band is off, the band value (right or left y) either below BAND_BELOW or
+// above BAND_ABOVE.
+enum match_row_e
+{
+    MATCH_ROW_LO=0,
+    MATCH_ROW_HI=MATCH_ROW_LO + NUM_MATCH_VALUES,
+    MATCH_ROW_BAND_BELOW=MATCH_ROW_HI + NUM_MATCH_VALUES,
+    MATCH_ROW_BAND_ABOVE,
+    MATCH_ROW_BAND_RIGHT,       // -1 if the band is on right y, 0 for left y
+    MATCH_ROW_BAND_OFF,         // -1 if the box has no band
+    NUM_MATCH_ROWS
+};
+
+// A box rewritten in that form: the band part, then lo and hi per value
+struct match_band_t
+{
+    int32_t below;
+    int32_t above;
+    int32_t right;
+    int32_t off;
+};
+
+// lo and hi hold NUM_MATCH_VALUES each; band may be nullptr. Without the
+// band the bounds are a superset of the box.
+void matchEnvelope(const threshold_box_t &box, int32_t *lo, int32_t *hi, match_band_t *band);
+// The values of one frame, NUM_MATCH_VALUES of them
+inline void matchValues(const jointCoords_t &jointCoords, int32_t *values)
+{
+    values[DELTA_LX] = jointCoords.Lshoulderx - jointCoords.Lhandx;
+    values[DELTA_LY] = jointCoords.Lshouldery - jointCoords.Lhandy;
+    values[DELTA_LZ] = jointCoords.Lshoulderz - jointCoords.Lhandz;
+    values[DELTA_RX] = jointCoords.Rshoulderx - jointCoords.Rhandx;
+    values[DELTA_RY] = jointCoords.Rshouldery - jointCoords.Rhandy;
+    values[DELTA_RZ] = jointCoords.Rshoulderz - jointCoords.Rhandz;
+    values[MATCH_VALUE_LHANDZ] = jointCoords.Lhandz;
+}
+
+inline bool maskBit(const uint64_t *mask, int i)
+{
+    return (mask[i >> 6] >> (i & 63)) & 1;
+}
+
+// Threshold boxes transposed for SIMD matching. One call computes the joint
+// deltas once and sets bit i of the mask for every box i that contains them,
+// bit-identical to boxContains().
+class BoxMatcher
+{
+private:
+    int32_t *rows;
+    int numBoxes;
+    int stride;
+
+    BoxMatcher(const BoxMatcher &) = delete;
+    BoxMatcher &operator=(const BoxMatcher &) = delete;
+
+public:
+    BoxMatcher() : rows(nullptr), numBoxes(0), stride(0) {}
+    ~BoxMatcher();
+
+    bool build(const threshold_box_t *boxes, int n);
+
+    int size(void) const { return numBoxes; }
+    int maskWords(void) const { return (numBoxes + 63) / 64; }
+
+    void match(const jointCoords_t &jointCoords, uint64_t *mask) const;
+
+    // Name of the kernel match() uses on this CPU
+    static const char *kernelName(void);
+};
+
+#endif // BOXMATCHER_H
@@ -0,0 +1,128 @@
+#include "builtinmatcher.h"
+#include "boxmatcher.h"
+#include "gesturedefinitions.h"
+
+static_assert(NUM_BUILTIN_BOXES <= 64, "the built-in set must fit one mask word");
+
+// 1 if lo <= v <= hi; & rather than && so nothing branches
+static inline uint64_t within(int32_t v, int32_t lo, int32_t hi)
+{
+    return (uint64_t)(lo <= v) & (uint64_t)(v <= hi);
+}
+
+template<int Box, int Value>
+static inline uint64_t withinBox(const int32_t *values)
+{
+    return within(values[Value], builtin_boxes[Box].min[Value], builtin_boxes[Box].max[Value]);
+}
+
+// One comparison policy per threshold form, as boxContains() spells them out
+template<threshold_form_e Form, int Box>
+struct FormPolicy;
+
+template<int Box>
+struct FormPolicy<THRESHOLD_FORM_BOTH_ARMS, Box>
+{
+    static inline uint64_t match(const int32_t *v)
+    {
+        return withinBox<Box, DELTA_LX>(v) & withinBox<Box, DELTA_LY>(v) & withinBox<Box, DELTA_LZ>(v) &
+               withinBox<Box, DELTA_RX>(v) & withinBox<Box, DELTA_RY>(v) & withinBox<Box, DELTA_RZ>(v);
+    }
+};
+
+template<int Box>
+struct FormPolicy<THRESHOLD_FORM_LEFT_ARM, Box>
+{
+    static inline uint64_t match(const int32_t *v)
+    {
+        return withinBox<Box, DELTA_LX>(v) & withinBox<Box, DELTA_LY>(v) & withinBox<Box, DELTA_LZ>(v) &
+               ((uint64_t)(v[DELTA_RY] < builtin_boxes[Box].max[DELTA_RY]) |
+                (uint64_t)(v[DELTA_RY] > builtin_boxes[Box].min[DELTA_RY]));
+    }
+};
+
+template<int Box>
+struct FormPolicy<THRESHOLD_FORM_RIGHT_ARM, Box>
+{
+    static inline uint64_t match(const int32_t *v)
+    {
+        return withinBox<Box, DELTA_RX>(v) & withinBox<Box, DELTA_RY>(v) & withinBox<Box, DELTA_RZ>(v) &
+               ((uint64_t)(v[DELTA_LY] < builtin_boxes[Box].max[DELTA_LY]) |
+                (uint64_t)(v[DELTA_LY] > builtin_boxes[Box].min[DELTA_LY]));
+    }
+};
+
+template<int Box>
+struct FormPolicy<THRESHOLD_FORM_STOP, Box>
+{
+    static inline uint64_t match(const int32_t *v)
+    {
+        return withinBox<Box, DELTA_LX>(v) & withinBox<Box, DELTA_LY>(v) &
+               (uint64_t)(v[MATCH_VALUE_LHANDZ] <= builtin_boxes[Box].max[DELTA_LZ]);
+    }
+};
+
+template<int Box>
+static inline uint64_t matchBox(const int32_t *values)
+{
+    return FormPolicy<thresholdFormFor((gestures_e)builtin_boxes[Box].id), Box>::match(values) << Box;
+}
+
+// 0 .. n-1 as a parameter pack, for C++11 which has no integer_sequence
+template<int... Boxes>
+struct box_sequence_t {};
+
+template<int N, int... Boxes>
+struct make_box_sequence : make_box_sequence<N - 1, N - 1, Boxes...> {};
+
+template<int... Boxes>
+struct make_box_sequence<0, Boxes...>
+{
+    typedef box_sequence_t<Boxes...> type;
+};
+
+template<int... Boxes>
+static inline uint64_t matchBoxes(const int32_t *values, box_sequence_t<Boxes...>)
+{
+    uint64_t mask = 0;
+    uint64_t bits[] = { matchBox<Boxes>(values)... };
+
+    for(uint64_t b : bits)
+    {
+        mask |= b;
+    }
+    return mask;
+}
+
+void matchBuiltin(const jointCoords_t &jointCoords, uint64_t *mask)
+{
+    int32_t values[NUM_MATCH_VALUES];
+
+    matchValues(jointCoords, values);
+    mask[0] = matchBoxes(values, make_box_sequence<NUM_BUILTIN_BOXES>::type());
+}
+
+bool isBuiltinGestureSet(const threshold_box_t *boxes, int n)
+{
+    if(n != NUM_BUILTIN_BOXES)
+    {
+        return false;
+    }
+
+    for(int i = 0; i < n; i++)
+    {
+        for(int d = 0; d < NUM_DELTAS; d++)
+        {
+            if(boxes[i].min[d] != builtin_boxes[i].min[d] || boxes[i].max[d] != builtin_boxes[i].max[d])
+            {
+                return false;
+            }
+        }
+        if(boxes[i].form != builtin_boxes[i].form || boxes[i].id != builtin_boxes[i].id)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
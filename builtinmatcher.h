@@ -0,0 +1,20 @@
+#ifndef BUILTINMATCHER_H
+#define BUILTINMATCHER_H
+
+#include <cstdint>
+
+#include "gesture.h"
+
+using namespace std;
+
+// Whether these boxes are the built-in gesture set of gesturedefinitions.h,
+// in its order
+bool isBuiltinGestureSet(const threshold_box_t *boxes, int n);
+
+// Matches the built-in set with code generated at compile time: each box's
+// form and bounds are constants, so the whole set unrolls into one
+// branch-free run of compares. Bit i of mask[0] is set for box i, the same
+// result as BoxMatcher::match() on that set.
+void matchBuiltin(const jointCoords_t &jointCoords, uint64_t *mask);
+
+#endif // BUILTINMATCHER_H
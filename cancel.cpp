@@ -1,13 +1,87 @@
-#include <boost/interprocess/ipc/message_queue.hpp>
+// Control client for a running electricTree. With no arguments it asks the
+// app to quit, as it always has.
 
-using namespace boost::interprocess;
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
 
-int main()
+#include "control.h"
+#include "main.h"
+#include "statemachine.h"
+
+using namespace std;
+
+static void usage(const char *name)
+{
+    cerr << "Usage: " << name << " [quit|pause|resume|reload-gestures|reload-content|flush-analytics|status]" << endl;
+}
+
+static int printStatus(ControlClient &client)
+{
+    control_status_t status;
+
+    if(!client.readStatus(status))
+    {
+        cerr << "Error: electricTree is not publishing its status" << endl;
+        return -1;
+    }
+
+    int64_t now_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+
+    printf("state        %s%s\n", stateName((state_e)status.state), status.paused ? " (paused)" : "");
+    printf("person       %d\n", status.pidInCenter);
+    printf("last gesture %s\n", gestureName((gestures_e)status.lastGesture));
+    printf("frames       %llu, %.1f fps\n", (unsigned long long)status.frames, status.fps);
+    printf("queues       captured %u (%llu dropped), tracked %u (%llu dropped)\n",
+           status.capturedDepth, (unsigned long long)status.capturedDrops,
+           status.trackedDepth, (unsigned long long)status.trackedDrops);
+    printf("updated      %.3f s ago\n", (now_ns - status.updated_ns) / 1e9);
+
+    printf("\n%-12s %10s %10s %10s %10s %10s\n", "latency", "count", "p50 ms", "p95 ms", "p99 ms", "max ms");
+    for(int s = 0; s < NUM_LATENCY_SEGMENTS; s++)
+    {
+        const control_latency_t &l = status.latency[s];
+        printf("%-12s %10llu %10.2f %10.2f %10.2f %10.2f\n", latencySegmentName((latency_segment_e)s),
+               (unsigned long long)l.count, l.p50_us / 1000.0, l.p95_us / 1000.0, l.p99_us / 1000.0, l.max_us / 1000.0);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
 {
-    // Shut down properly
-    message_queue mq
-            (open_only,
-             "etree_message_queue");
-    bool shouldQuit = true;
-    mq.send(&shouldQuit, sizeof(shouldQuit), 0);
+    string command = argc > 1 ? argv[1] : "quit";
+
+    if(argc > 2)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    ControlClient client;
+    if(!client.open())
+    {
+        cerr << "Error: electricTree is not running" << endl;
+        return -1;
+    }
+
+    if(command == "status")
+    {
+        return printStatus(client);
+    }
+
+    control_cmd_e cmd = controlCommandFromName(command);
+    if(cmd == CONTROL_CMD_UNDEFINED)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if(!client.send(cmd))
+    {
+        cerr << "Error: electricTree did not take the command, its queue is full or locked" << endl;
+        return -1;
+    }
+
+    return 0;
 }
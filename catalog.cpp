@@ -0,0 +1,476 @@
+#include "catalog.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+using boost::property_tree::ptree;
+
+// Clip title for each gesture, by gestures_e
+static const char *clip_titles[GESTURE_UNDEFINED] =
+{
+    "bolt",
+    "tpose",
+    "victory",
+    "flexing",
+    "stop",
+    "fly",
+    "rightwave",
+    "leftwave",
+    "jump",
+    "toprightforward",
+    "rightforward",
+    "topleftforward",
+    "leftforward",
+    "topright",
+    "right",
+    "topleft",
+    "left",
+    "running",
+    "idle",
+    "ready"
+};
+
+const char *contentFormatName(content_format_e format)
+{
+    switch(format)
+    {
+    case CONTENT_FORMAT_MP4: return "mp4";
+    case CONTENT_FORMAT_MOV: return "mov";
+    default: return "undefined";
+    }
+}
+
+gestures_e contentGesture(const string &name, content_format_e *format)
+{
+    size_t dot = name.rfind('.');
+    if(dot == string::npos)
+    {
+        return GESTURE_UNDEFINED;
+    }
+
+    string ext = name.substr(dot + 1);
+    transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if(ext == "mp4")
+    {
+        *format = CONTENT_FORMAT_MP4;
+    }
+    else if(ext == "mov")
+    {
+        *format = CONTENT_FORMAT_MOV;
+    }
+    else
+    {
+        return GESTURE_UNDEFINED;
+    }
+
+    // Strip a "(n)" copy number
+    string title = name.substr(0, dot);
+    size_t open = title.rfind('(');
+    if(!title.empty() && title.back() == ')' && open != string::npos && open + 2 < title.size())
+    {
+        bool digits = true;
+        for(size_t i = open + 1; i + 1 < title.size(); i++)
+        {
+            digits = digits && isdigit((unsigned char)title[i]);
+        }
+        if(digits)
+        {
+            title.erase(open);
+        }
+    }
+
+    for(int g = 0; g < GESTURE_UNDEFINED; g++)
+    {
+        if(title == clip_titles[g])
+        {
+            return (gestures_e)g;
+        }
+    }
+    return GESTURE_UNDEFINED;
+}
+
+static uint32_t readBe32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t readBe64(const uint8_t *p)
+{
+    return ((uint64_t)readBe32(p) << 32) | readBe32(p + 4);
+}
+
+// Next box header in [offset, end): its type, and where its payload and the
+// box itself end. False at the end or on a malformed box.
+static bool readBox(int fd, int64_t offset, int64_t end, char type[4], int64_t *payload, int64_t *next)
+{
+    uint8_t header[16];
+
+    if(offset + 8 > end || pread(fd, header, 16, offset) < 8)
+    {
+        return false;
+    }
+
+    uint64_t size = readBe32(header);
+    memcpy(type, header + 4, 4);
+    *payload = offset + 8;
+
+    if(size == 1)
+    {
+        size = readBe64(header + 8);
+        *payload = offset + 16;
+    }
+    else if(size == 0)
+    {
+        size = end - offset;
+    }
+
+    if(size < (uint64_t)(*payload - offset) || offset + (int64_t)size > end)
+    {
+        return false;
+    }
+    *next = offset + size;
+    return true;
+}
+
+static bool findBox(int fd, int64_t offset, int64_t end, const char *want, int64_t *payload, int64_t *boxEnd)
+{
+    char type[4];
+    int64_t next;
+
+    while(readBox(fd, offset, end, type, payload, &next))
+    {
+        if(memcmp(type, want, 4) == 0)
+        {
+            *boxEnd = next;
+            return true;
+        }
+        offset = next;
+    }
+    return false;
+}
+
+double contentDuration(const string &path)
+{
+    struct stat st;
+    int64_t moov;
+    int64_t moovEnd;
+    int64_t mvhd;
+    int64_t mvhdEnd;
+    uint8_t header[32];
+    double duration = 0;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return 0;
+    }
+
+    if(fstat(fd, &st) == 0 &&
+       findBox(fd, 0, st.st_size, "moov", &moov, &moovEnd) &&
+       findBox(fd, moov, moovEnd, "mvhd", &mvhd, &mvhdEnd) &&
+       pread(fd, header, sizeof(header), mvhd) == (ssize_t)sizeof(header))
+    {
+        // Version 1 headers have 64 bit times
+        uint32_t timescale = header[0] == 1 ? readBe32(header + 20) : readBe32(header + 12);
+        uint64_t length = header[0] == 1 ? readBe64(header + 24) : readBe32(header + 16);
+
+        if(timescale > 0)
+        {
+            duration = (double)length / timescale;
+        }
+    }
+
+    close(fd);
+    return duration;
+}
+
+// ---------------------------------------------------------------------------
+// ContentCatalog
+
+static bool byName(const content_clip_t &a, const content_clip_t &b)
+{
+    return a.name < b.name;
+}
+
+static bool readClip(const string &dir, const string &name, content_clip_t &clip, gestures_e *gesture)
+{
+    struct stat st;
+
+    *gesture = contentGesture(name, &clip.format);
+    if(*gesture == GESTURE_UNDEFINED)
+    {
+        return false;
+    }
+
+    clip.name = name;
+    clip.path = dir + name;
+    if(stat(clip.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+    clip.size = st.st_size;
+    clip.duration = contentDuration(clip.path);
+    clip.weight = 1.0;
+    return true;
+}
+
+ContentCatalog::ContentCatalog(const string &dir) :
+    dir(dir),
+    hasPending(false),
+    running(true),
+    rescanRequested(false),
+    generation(0)
+{
+    if(!this->dir.empty() && this->dir.back() != '/')
+    {
+        this->dir += '/';
+    }
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotifyFd < 0 ||
+       inotify_add_watch(inotifyFd, this->dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0)
+    {
+        perror("Error watching the content directory");
+    }
+
+    // Scanned before returning, so the first clip played already has an index
+    building = scan();
+    installed = finish(*building);
+    latest = installed;
+
+    worker = thread(&ContentCatalog::run, this);
+}
+
+ContentCatalog::~ContentCatalog()
+{
+    running = false;
+    worker.join();
+
+    if(inotifyFd >= 0)
+    {
+        close(inotifyFd);
+    }
+}
+
+const content_index_t &ContentCatalog::index(void)
+{
+    if(hasPending.load(memory_order_acquire))
+    {
+        lock_guard<mutex> guard(pendingLock);
+        installed = pending;
+        pending.reset();
+        hasPending.store(false, memory_order_relaxed);
+    }
+    return *installed;
+}
+
+shared_ptr<const content_index_t> ContentCatalog::snapshot(void)
+{
+    lock_guard<mutex> guard(pendingLock);
+    return latest;
+}
+
+// The index as readers see it: weights applied and alias tables built
+shared_ptr<const content_index_t> ContentCatalog::finish(const content_index_t &index)
+{
+    shared_ptr<content_index_t> copy = make_shared<content_index_t>(index);
+
+    for(int g = 0; g < GESTURE_UNDEFINED; g++)
+    {
+        vector<double> w;
+        for(content_clip_t &clip : copy->clips[g])
+        {
+            map<string, double>::const_iterator it = weights.find(clip.name);
+            clip.weight = it != weights.end() ? it->second : 1.0;
+            w.push_back(clip.weight);
+        }
+        buildAliasTable(w, copy->alias[g]);
+    }
+    copy->generation = ++generation;
+    return copy;
+}
+
+void ContentCatalog::readWeights(void)
+{
+    string path = dir + CONTENT_WEIGHTS_FILE;
+    ptree root;
+
+    weights.clear();
+    if(access(path.c_str(), F_OK) != 0)
+    {
+        return;
+    }
+
+    try
+    {
+        read_json(path, root);
+        for(const ptree::value_type &entry : root)
+        {
+            double weight = entry.second.get_value<double>();
+            if(weight < 0)
+            {
+                cerr << "Error: " << path << ": weight of " << entry.first << " is negative" << endl;
+                continue;
+            }
+            weights[entry.first] = weight;
+        }
+    }
+    catch(const boost::property_tree::ptree_error &e)
+    {
+        cerr << "Error: " << e.what() << endl;
+        weights.clear();
+    }
+}
+
+void ContentCatalog::publish(const content_index_t &index)
+{
+    shared_ptr<const content_index_t> copy = finish(index);
+    int clips = 0;
+
+    for(int g = 0; g < GESTURE_UNDEFINED; g++)
+    {
+        clips += index.clips[g].size();
+    }
+
+    lock_guard<mutex> guard(pendingLock);
+    pending = copy;
+    latest = copy;
+    hasPending.store(true, memory_order_release);
+    cout << "Content catalog: " << clips << " clips in " << dir << endl;
+}
+
+shared_ptr<content_index_t> ContentCatalog::scan(void)
+{
+    shared_ptr<content_index_t> index = make_shared<content_index_t>();
+    DIR *d = opendir(dir.c_str());
+
+    readWeights();
+
+    if(!d)
+    {
+        perror("Error reading the content directory");
+        return index;
+    }
+
+    while(struct dirent *entry = readdir(d))
+    {
+        content_clip_t clip;
+        gestures_e gesture;
+
+        if(readClip(dir, entry->d_name, clip, &gesture))
+        {
+            index->clips[gesture].push_back(clip);
+        }
+    }
+    closedir(d);
+
+    for(int g = 0; g < GESTURE_UNDEFINED; g++)
+    {
+        sort(index->clips[g].begin(), index->clips[g].end(), byName);
+    }
+    return index;
+}
+
+// Drop name from the index being built, then add it back if it is there
+void ContentCatalog::update(const string &name, bool present)
+{
+    content_format_e format;
+    gestures_e gesture = contentGesture(name, &format);
+
+    if(name == CONTENT_WEIGHTS_FILE)
+    {
+        readWeights();
+        return;
+    }
+    if(gesture == GESTURE_UNDEFINED)
+    {
+        return;
+    }
+
+    vector<content_clip_t> &clips = building->clips[gesture];
+    for(size_t i = 0; i < clips.size(); i++)
+    {
+        if(clips[i].name == name)
+        {
+            clips.erase(clips.begin() + i);
+            break;
+        }
+    }
+
+    content_clip_t clip;
+    if(present && readClip(dir, name, clip, &gesture))
+    {
+        clips.insert(upper_bound(clips.begin(), clips.end(), clip, byName), clip);
+    }
+}
+
+void ContentCatalog::run(void)
+{
+    // inotify events are variable length; this holds plenty of them
+    alignas(struct inotify_event) char events[4096];
+    bool changed = false;
+    chrono::steady_clock::time_point lastEvent;
+
+    while(running)
+    {
+        struct pollfd pfd;
+        pfd.fd = inotifyFd;
+        pfd.events = POLLIN;
+
+        int ready = inotifyFd >= 0 ? ::poll(&pfd, 1, CATALOG_SETTLE_MS) : 0;
+        if(inotifyFd < 0)
+        {
+            this_thread::sleep_for(chrono::milliseconds(CATALOG_SETTLE_MS));
+        }
+
+        if(rescanRequested.exchange(false))
+        {
+            building = scan();
+            changed = true;
+        }
+
+        if(ready > 0)
+        {
+            ssize_t n;
+            while((n = read(inotifyFd, events, sizeof(events))) > 0)
+            {
+                for(char *p = events; p < events + n; )
+                {
+                    struct inotify_event *event = (struct inotify_event *)p;
+
+                    if(event->mask & IN_Q_OVERFLOW)
+                    {
+                        // Lost track; start from the directory again
+                        building = scan();
+                    }
+                    else if(event->len > 0)
+                    {
+                        update(event->name, event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO));
+                    }
+                    p += sizeof(struct inotify_event) + event->len;
+                }
+            }
+            changed = true;
+            lastEvent = chrono::steady_clock::now();
+            continue;
+        }
+
+        // Quiet for a while; hand the new index over
+        if(changed && chrono::steady_clock::now() - lastEvent >= chrono::milliseconds(CATALOG_SETTLE_MS))
+        {
+            publish(*building);
+            changed = false;
+        }
+    }
+}
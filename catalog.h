@@ -0,0 +1,107 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clipselect.h"
+#include "gesture.h"
+
+using namespace std;
+
+// Clip files are named <title>.<ext> or <title>(<n>).<ext>, where the title
+// says which gesture the clip answers (see catalog.cpp) and ext is mp4 or mov
+#define CONTENT_DIR "/home/capstone38/Desktop/electricTree/videos/"
+
+// Optional JSON object in the content directory giving clips other weights
+// than 1, e.g. { "victory(1).mp4": 3, "bolt.mp4": 0 }. Weight 0 retires a clip.
+#define CONTENT_WEIGHTS_FILE "weights.json"
+
+// Changes seen within this long of each other are published together
+#define CATALOG_SETTLE_MS 250
+
+enum content_format_e
+{
+    CONTENT_FORMAT_MP4=0,
+    CONTENT_FORMAT_MOV,
+    CONTENT_FORMAT_UNDEFINED
+};
+
+struct content_clip_t
+{
+    string name;                // file name within the directory
+    string path;
+    int64_t size;
+    double duration;            // seconds, 0 if the header could not be read
+    content_format_e format;
+    double weight;              // relative chance of being picked
+};
+
+// Every clip in the directory, by gesture. Immutable once published.
+struct content_index_t
+{
+    vector<content_clip_t> clips[GESTURE_UNDEFINED];
+    alias_table_t alias[GESTURE_UNDEFINED];     // over the clip weights
+    uint64_t generation;                        // new for every index published
+};
+
+// Scans the content directory once, then keeps the index current from
+// inotify events on a thread of its own, so new clips pushed by the download
+// scripts can be played without a restart. Each change publishes a new
+// index; the reader swaps it in on its next call to index(), so the play
+// path never touches the filesystem.
+class ContentCatalog
+{
+private:
+    string dir;
+    shared_ptr<const content_index_t> installed;
+
+    mutex pendingLock;
+    shared_ptr<const content_index_t> pending;
+    shared_ptr<const content_index_t> latest;
+    atomic<bool> hasPending;
+
+    atomic<bool> running;
+    atomic<bool> rescanRequested;
+    int inotifyFd;
+    thread worker;
+
+    // Only touched by the worker
+    shared_ptr<content_index_t> building;
+    map<string, double> weights;
+    uint64_t generation;
+
+    shared_ptr<const content_index_t> finish(const content_index_t &index);
+    void publish(const content_index_t &index);
+    void readWeights(void);
+    shared_ptr<content_index_t> scan(void);
+    void update(const string &name, bool present);
+    void run(void);
+
+public:
+    ContentCatalog(const string &dir);
+    ~ContentCatalog();
+
+    // Current index. Call from one thread only, the one that plays clips.
+    const content_index_t &index(void);
+
+    // Newest index, for threads other than the one that plays clips
+    shared_ptr<const content_index_t> snapshot(void);
+
+    // Read the whole directory again, on the catalog's thread
+    void requestRescan(void) { rescanRequested = true; }
+};
+
+// Which gesture a clip file belongs to, GESTURE_UNDEFINED if it is not a clip
+gestures_e contentGesture(const string &name, content_format_e *format);
+// Length of an MP4 or QuickTime file from its movie header, 0 if unknown
+double contentDuration(const string &path);
+const char *contentFormatName(content_format_e format);
+
+#endif // CATALOG_H
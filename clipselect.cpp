@@ -0,0 +1,172 @@
+#include "clipselect.h"
+#include "catalog.h"
+#include "prng.h"
+
+#include <algorithm>
+
+void buildAliasTable(const vector<double> &weights, alias_table_t &table)
+{
+    size_t n = weights.size();
+    vector<double> scaled(n);
+    vector<uint32_t> small;
+    vector<uint32_t> large;
+
+    table.prob.assign(n, 0.0);
+    table.alias.assign(n, 0);
+    table.weights = weights;
+    table.total = 0;
+    table.positive = 0;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        if(weights[i] > 0)
+        {
+            table.total += weights[i];
+            table.positive++;
+        }
+    }
+    if(table.positive == 0)
+    {
+        return;
+    }
+
+    // Vose's variant: scale so the mean is 1, then pair each short column
+    // with a tall one that tops it up
+    for(size_t i = 0; i < n; i++)
+    {
+        scaled[i] = weights[i] > 0 ? weights[i] * n / table.total : 0.0;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    while(!small.empty() && !large.empty())
+    {
+        uint32_t s = small.back();
+        uint32_t l = large.back();
+        small.pop_back();
+        large.pop_back();
+
+        table.prob[s] = scaled[s];
+        table.alias[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        (scaled[l] < 1.0 ? small : large).push_back(l);
+    }
+
+    // Whatever is left is 1 up to rounding
+    for(uint32_t i : large)
+    {
+        table.prob[i] = 1.0;
+        table.alias[i] = i;
+    }
+    uint32_t heaviest = max_element(weights.begin(), weights.end()) - weights.begin();
+    for(uint32_t i : small)
+    {
+        // Only rounding leaves a column here; a zero weight one must still never come up
+        table.prob[i] = weights[i] > 0 ? 1.0 : 0.0;
+        table.alias[i] = weights[i] > 0 ? i : heaviest;
+    }
+}
+
+int sampleAlias(const alias_table_t &table)
+{
+    uint32_t i = prngBelow(table.prob.size());
+    return prngUnit() < table.prob[i] ? i : table.alias[i];
+}
+
+// ---------------------------------------------------------------------------
+// ClipSelector
+
+ClipSelector::ClipSelector() : generation(0)
+{
+    for(int g = 0; g < GESTURE_UNDEFINED; g++)
+    {
+        numRecent[g] = 0;
+    }
+}
+
+bool ClipSelector::isRecent(int gesture, int clip, int window) const
+{
+    for(int i = 0; i < window; i++)
+    {
+        if(recent[gesture][i] == clip)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ClipSelector::window(const content_index_t &index, gestures_e gesture) const
+{
+    if(index.generation != generation)
+    {
+        return 0;
+    }
+    return min(min(CLIP_NO_REPEAT, index.alias[gesture].positive - 1), numRecent[gesture]);
+}
+
+int ClipSelector::pick(const content_index_t &index, gestures_e gesture)
+{
+    const alias_table_t &table = index.alias[gesture];
+
+    if(table.positive == 0)
+    {
+        return -1;
+    }
+
+    // Clip numbers only mean something within one index
+    if(index.generation != generation)
+    {
+        generation = index.generation;
+        for(int g = 0; g < GESTURE_UNDEFINED; g++)
+        {
+            numRecent[g] = 0;
+        }
+    }
+
+    int w = window(index, gesture);
+    int clip = -1;
+
+    for(int attempt = 0; attempt < CLIP_SAMPLE_ATTEMPTS && clip < 0; attempt++)
+    {
+        int c = sampleAlias(table);
+        if(!isRecent(gesture, c, w))
+        {
+            clip = c;
+        }
+    }
+
+    // The recent clips carry nearly all the weight; draw from the rest directly
+    if(clip < 0)
+    {
+        double rest = 0;
+        for(size_t i = 0; i < table.weights.size(); i++)
+        {
+            if(table.weights[i] > 0 && !isRecent(gesture, i, w))
+            {
+                rest += table.weights[i];
+            }
+        }
+
+        double r = prngUnit() * rest;
+        for(size_t i = 0; i < table.weights.size(); i++)
+        {
+            if(table.weights[i] > 0 && !isRecent(gesture, i, w))
+            {
+                clip = i;
+                r -= table.weights[i];
+                if(r < 0)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    for(int i = min(numRecent[gesture], CLIP_NO_REPEAT - 1); i > 0; i--)
+    {
+        recent[gesture][i] = recent[gesture][i - 1];
+    }
+    recent[gesture][0] = clip;
+    numRecent[gesture] = min(numRecent[gesture] + 1, CLIP_NO_REPEAT);
+    return clip;
+}
@@ -0,0 +1,59 @@
+#ifndef CLIPSELECT_H
+#define CLIPSELECT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "gesture.h"
+
+using namespace std;
+
+// A clip is not picked again within this many picks of its gesture, as long
+// as the gesture has more clips than that to choose from
+#define CLIP_NO_REPEAT 2
+// Alias draws tried before falling back to a walk over the remaining clips
+#define CLIP_SAMPLE_ATTEMPTS 16
+
+// Walker's alias method: one uniform index and one coin per draw, whatever
+// the number of clips. Built once per catalog index.
+struct alias_table_t
+{
+    vector<double> prob;
+    vector<uint32_t> alias;
+    vector<double> weights;
+    double total;
+    int positive;               // clips with a weight above 0
+};
+
+void buildAliasTable(const vector<double> &weights, alias_table_t &table);
+// Index drawn in proportion to its weight; the table must have positive > 0
+int sampleAlias(const alias_table_t &table);
+
+struct content_index_t;
+
+// Picks the next clip for each gesture from a catalog index by weight,
+// skipping the ones it picked most recently. Draws are exact: a draw that
+// lands on a recent clip is thrown away, which leaves the weights of the
+// other clips in proportion. Keeps its own history, so each thread that
+// picks clips has its own selector.
+class ClipSelector
+{
+private:
+    uint64_t generation;
+    int recent[GESTURE_UNDEFINED][CLIP_NO_REPEAT];     // newest first
+    int numRecent[GESTURE_UNDEFINED];
+
+    bool isRecent(int gesture, int clip, int window) const;
+
+public:
+    ClipSelector();
+
+    // Index into index.clips[gesture], -1 if no clip there can be picked
+    int pick(const content_index_t &index, gestures_e gesture);
+
+    // Clips a pick may not return right now, newest first
+    int window(const content_index_t &index, gestures_e gesture) const;
+    const int *history(gestures_e gesture) const { return recent[gesture]; }
+};
+
+#endif // CLIPSELECT_H
@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "catalog.h"
+#include "main.h"
+#include "prefetch.h"
+#include "videoplayer.h"
+
+using namespace std;
+
+// Video content: which clips exist, and handing them to the playback engine
+
+VideoPlayer *player = nullptr;
+ContentCatalog *catalog = nullptr;
+ClipPrefetcher *prefetcher = nullptr;
+
+// Only the decision thread plays clips
+static ClipSelector selector;
+
+// Idle and ready clips, picked on the player's thread as each loop goes round
+class ContentLoop : public ClipSource
+{
+private:
+    ClipSelector loopSelector;
+
+public:
+    bool nextClip(gestures_e gesture, string &path)
+    {
+        path = DEFAULT_VIDEO;
+        if(catalog)
+        {
+            shared_ptr<const content_index_t> index = catalog->snapshot();
+            int clip = loopSelector.pick(*index, gesture);
+            if(clip >= 0)
+            {
+                path = index->clips[gesture][clip].path;
+            }
+        }
+        return true;
+    }
+};
+
+static ContentLoop content_loop;
+
+void playContent(gestures_e gesture, const latency_stamps_t *stamps)
+{
+    static const string default_video(DEFAULT_VIDEO);
+    const string *path = &default_video;
+
+    // The player keeps these going by itself
+    if(gesture == GESTURE_IDLE || gesture == GESTURE_READY)
+    {
+        player->loop(gesture, &content_loop);
+        return;
+    }
+
+    // The catalog already knows every clip, so nothing here touches the disk
+    if(catalog && gesture < GESTURE_UNDEFINED)
+    {
+        const content_index_t &index = catalog->index();
+        int clip = selector.pick(index, gesture);
+        if(clip >= 0)
+        {
+            path = &index.clips[gesture][clip].path;
+        }
+    }
+
+    // Every clip a visitor triggered counts, whichever title it plays
+    if(gesture < GESTURE_IDLE)
+    {
+        countGesture(gesture);
+    }
+
+    player->preempt(gesture, *path, stamps);
+}
+
+void prefetchContent(state_e state)
+{
+    if(prefetcher)
+    {
+        prefetcher->hint(state);
+    }
+}
+
+uint64_t contentLoopClips(void)
+{
+    return player->loopClipsStarted();
+}
+
+gestures_e currentVideoType()
+{
+    // Kept up to date by playback events, so this never leaves the process
+    return player->current();
+}
+
+
+int waitUntilContentStart(gestures_e gesture)
+{
+    int retval = 1;
+    int timeout = 100;
+    int i=0;
+    while((currentVideoType() != gesture) && i < timeout)
+    {
+        i++; // wait
+        if(i==timeout)
+        {
+            retval = 0;
+        }
+    }
+
+    return retval;
+}
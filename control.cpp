@@ -0,0 +1,284 @@
+#include "control.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+using namespace boost::interprocess;
+
+struct control_region_t
+{
+    uint32_t magic;
+    uint32_t version;
+
+    // Clients queue under the lock; the server only moves commandTail
+    interprocess_mutex clientLock;
+    atomic<uint32_t> commandHead;
+    atomic<uint32_t> commandTail;
+    uint32_t commands[CONTROL_QUEUE_SIZE];
+
+    atomic<uint32_t> statusSeq; // odd while a publish is in progress
+    control_status_t status;
+
+    int32_t pid;
+    atomic<int64_t> beat_ns;
+    atomic<uint64_t> progress[NUM_CONTROL_STAGES];
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "control region needs lock-free atomics to be shared");
+
+static int64_t steadyNs(void)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char *command_names[CONTROL_CMD_UNDEFINED + 1] =
+{
+    "none",
+    "reload-gestures",
+    "reload-content",
+    "flush-analytics",
+    "pause",
+    "resume",
+    "quit",
+    "undefined"
+};
+
+const char *controlCommandName(control_cmd_e cmd)
+{
+    if(cmd < 0 || cmd > CONTROL_CMD_UNDEFINED)
+    {
+        cmd = CONTROL_CMD_UNDEFINED;
+    }
+    return command_names[cmd];
+}
+
+control_cmd_e controlCommandFromName(const string &name)
+{
+    for(int i = CONTROL_CMD_NONE + 1; i < CONTROL_CMD_UNDEFINED; i++)
+    {
+        if(name == command_names[i])
+        {
+            return (control_cmd_e)i;
+        }
+    }
+    return CONTROL_CMD_UNDEFINED;
+}
+
+// ---------------------------------------------------------------------------
+// ControlServer
+
+bool ControlServer::open(void)
+{
+    close();
+
+    try
+    {
+        shared_memory_object::remove(name.c_str());
+        shared_memory_object shm(create_only, name.c_str(), read_write);
+        shm.truncate(sizeof(control_region_t));
+
+        mapped_region *mapped = new mapped_region(shm, read_write);
+        mapping = mapped;
+        region = new(mapped->get_address()) control_region_t;
+    }
+    catch(interprocess_exception &e)
+    {
+        cerr << "Error: Could not create the control region: " << e.what() << endl;
+        close();
+        return false;
+    }
+
+    region->commandHead.store(0, memory_order_relaxed);
+    region->commandTail.store(0, memory_order_relaxed);
+    region->statusSeq.store(0, memory_order_relaxed);
+    memset(&region->status, 0, sizeof(region->status));
+    region->pid = getpid();
+    region->beat_ns.store(steadyNs(), memory_order_relaxed);
+    for(int i = 0; i < NUM_CONTROL_STAGES; i++)
+    {
+        region->progress[i].store(0, memory_order_relaxed);
+    }
+    region->version = CONTROL_VERSION;
+    atomic_thread_fence(memory_order_release);
+    region->magic = CONTROL_MAGIC;
+    return true;
+}
+
+void ControlServer::close(void)
+{
+    if(!mapping)
+    {
+        return;
+    }
+
+    region->~control_region_t();
+    delete (mapped_region *)mapping;
+    mapping = nullptr;
+    region = nullptr;
+    shared_memory_object::remove(name.c_str());
+}
+
+control_cmd_e ControlServer::poll(void)
+{
+    if(!region)
+    {
+        return CONTROL_CMD_NONE;
+    }
+
+    uint32_t tail = region->commandTail.load(memory_order_relaxed);
+    if(tail == region->commandHead.load(memory_order_acquire))
+    {
+        return CONTROL_CMD_NONE;
+    }
+
+    uint32_t cmd = region->commands[tail % CONTROL_QUEUE_SIZE];
+    region->commandTail.store(tail + 1, memory_order_release);
+
+    return cmd < CONTROL_CMD_UNDEFINED ? (control_cmd_e)cmd : CONTROL_CMD_UNDEFINED;
+}
+
+void ControlServer::publish(const control_status_t &status)
+{
+    if(!region)
+    {
+        return;
+    }
+
+    uint32_t seq = region->statusSeq.load(memory_order_relaxed);
+
+    region->statusSeq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&region->status, &status, sizeof(status));
+    region->statusSeq.store(seq + 2, memory_order_release);
+}
+
+void ControlServer::heartbeat(uint64_t captured, uint64_t tracked, uint64_t decided)
+{
+    if(!region)
+    {
+        return;
+    }
+
+    region->progress[CONTROL_STAGE_CAPTURE].store(captured, memory_order_relaxed);
+    region->progress[CONTROL_STAGE_TRACKING].store(tracked, memory_order_relaxed);
+    region->progress[CONTROL_STAGE_DECISION].store(decided, memory_order_relaxed);
+    region->beat_ns.store(steadyNs(), memory_order_release);
+}
+
+// ---------------------------------------------------------------------------
+// ControlClient
+
+bool ControlClient::open(void)
+{
+    close();
+
+    try
+    {
+        shared_memory_object shm(open_only, name.c_str(), read_write);
+        mapped_region *mapped = new mapped_region(shm, read_write);
+
+        mapping = mapped;
+        if(mapped->get_size() < sizeof(control_region_t))
+        {
+            close();
+            return false;
+        }
+        region = (control_region_t *)mapped->get_address();
+    }
+    catch(interprocess_exception &e)
+    {
+        close();
+        return false;
+    }
+
+    if(region->magic != CONTROL_MAGIC || region->version != CONTROL_VERSION)
+    {
+        close();
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return true;
+}
+
+void ControlClient::close(void)
+{
+    delete (mapped_region *)mapping;
+    mapping = nullptr;
+    region = nullptr;
+}
+
+bool ControlClient::send(control_cmd_e cmd)
+{
+    if(!region)
+    {
+        return false;
+    }
+
+    boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() +
+                                        boost::posix_time::milliseconds(CONTROL_LOCK_TIMEOUT_MS);
+    scoped_lock<interprocess_mutex> guard(region->clientLock, deadline);
+    if(!guard.owns())
+    {
+        return false;
+    }
+
+    uint32_t head = region->commandHead.load(memory_order_relaxed);
+    if(head - region->commandTail.load(memory_order_acquire) >= CONTROL_QUEUE_SIZE)
+    {
+        return false;
+    }
+
+    region->commands[head % CONTROL_QUEUE_SIZE] = cmd;
+    region->commandHead.store(head + 1, memory_order_release);
+    return true;
+}
+
+bool ControlClient::readStatus(control_status_t &status)
+{
+    if(!region)
+    {
+        return false;
+    }
+
+    // A server killed mid-publish leaves the count odd for good
+    for(int attempt = 0; attempt < CONTROL_READ_ATTEMPTS; attempt++)
+    {
+        uint32_t before = region->statusSeq.load(memory_order_acquire);
+        memcpy(&status, &region->status, sizeof(status));
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t after = region->statusSeq.load(memory_order_relaxed);
+
+        if(!(before & 1) && before == after)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ControlClient::readHeartbeat(control_heartbeat_t &heartbeat)
+{
+    if(!region)
+    {
+        return false;
+    }
+
+    heartbeat.pid = region->pid;
+    heartbeat.beat_ns = region->beat_ns.load(memory_order_acquire);
+    for(int i = 0; i < NUM_CONTROL_STAGES; i++)
+    {
+        heartbeat.progress[i] = region->progress[i].load(memory_order_relaxed);
+    }
+    return true;
+}
@@ -0,0 +1,138 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <cstdint>
+#include <string>
+
+#include "latency.h"
+
+using namespace std;
+
+// Shared memory control plane between electricTree and the cancel tool
+//
+// ControlServer creates the region at start-up. Clients queue commands into
+// a small ring that the decision loop drains once per frame without taking
+// any lock, and the loop publishes its status the other way under a
+// sequence count, so readers retry instead of the loop ever waiting.
+
+#define CONTROL_SHM_NAME "etree_control"
+#define CONTROL_MAGIC 0x31435445    // "ETC1"
+#define CONTROL_VERSION 3
+#define CONTROL_QUEUE_SIZE 16
+// A client that cannot get the queue lock in this long gives up
+#define CONTROL_LOCK_TIMEOUT_MS 1000
+#define CONTROL_READ_ATTEMPTS 100000
+
+enum control_cmd_e
+{
+    CONTROL_CMD_NONE=0,
+    CONTROL_CMD_RELOAD_GESTURES,
+    CONTROL_CMD_RELOAD_CONTENT,
+    CONTROL_CMD_FLUSH_ANALYTICS,
+    CONTROL_CMD_PAUSE,
+    CONTROL_CMD_RESUME,
+    CONTROL_CMD_QUIT,
+    CONTROL_CMD_UNDEFINED
+};
+
+// One latency histogram, summarised in microseconds
+struct control_latency_t
+{
+    uint64_t count;
+    uint32_t p50_us;
+    uint32_t p95_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+};
+
+struct control_status_t
+{
+    uint64_t frames;            // frames through the decision stage
+    int64_t updated_ns;         // steady clock at the last publish
+    int32_t state;              // state_e
+    int32_t pidInCenter;
+    int32_t lastGesture;        // gesture that started the last clip
+    int32_t paused;
+    float fps;                  // decision stage, over the last second
+    uint32_t capturedDepth;
+    uint32_t trackedDepth;
+    uint32_t reserved;
+    uint64_t capturedDrops;
+    uint64_t trackedDrops;
+    control_latency_t latency[NUM_LATENCY_SEGMENTS];    // refreshed once a second
+};
+
+// Liveness for the supervisor: the decision loop beats on every pass, and
+// each pipeline stage's frame count shows whether it is still moving
+enum control_stage_e
+{
+    CONTROL_STAGE_CAPTURE=0,
+    CONTROL_STAGE_TRACKING,
+    CONTROL_STAGE_DECISION,
+    NUM_CONTROL_STAGES
+};
+
+struct control_heartbeat_t
+{
+    int32_t pid;                // process that owns the region
+    int64_t beat_ns;            // steady clock at the last beat
+    uint64_t progress[NUM_CONTROL_STAGES];
+};
+
+struct control_region_t;
+
+// The region is CONTROL_SHM_NAME unless named otherwise, as the tests do so
+// they leave a running electricTree alone
+class ControlServer
+{
+private:
+    string name;
+    control_region_t *region;
+    void *mapping;
+
+    ControlServer(const ControlServer &) = delete;
+    ControlServer &operator=(const ControlServer &) = delete;
+
+public:
+    ControlServer(const string &name = CONTROL_SHM_NAME) : name(name), region(nullptr), mapping(nullptr) {}
+    ~ControlServer() { close(); }
+
+    // Replaces any region left behind by an earlier run
+    bool open(void);
+    void close(void);
+
+    // Next queued command, CONTROL_CMD_NONE if there is none. Never blocks.
+    control_cmd_e poll(void);
+    // Never blocks; readers retry while a publish is in progress
+    void publish(const control_status_t &status);
+    // A handful of relaxed stores, cheap enough for every pass of a loop
+    void heartbeat(uint64_t captured, uint64_t tracked, uint64_t decided);
+};
+
+class ControlClient
+{
+private:
+    string name;
+    control_region_t *region;
+    void *mapping;
+
+    ControlClient(const ControlClient &) = delete;
+    ControlClient &operator=(const ControlClient &) = delete;
+
+public:
+    ControlClient(const string &name = CONTROL_SHM_NAME) : name(name), region(nullptr), mapping(nullptr) {}
+    ~ControlClient() { close(); }
+
+    // Fails if electricTree is not running
+    bool open(void);
+    void close(void);
+
+    bool send(control_cmd_e cmd);
+    bool readStatus(control_status_t &status);
+    bool readHeartbeat(control_heartbeat_t &heartbeat);
+};
+
+const char *controlCommandName(control_cmd_e cmd);
+control_cmd_e controlCommandFromName(const string &name);
+
+#endif // CONTROL_H
@@ -1,61 +1,80 @@
 #include "dynamicgesture.h"
 
-#include <iostream>
+#include "trace.h"
 
 void DynamicGesture::addIntermediateGesture(Gesture g)
 {
     intermediate_gestures.push_back(g);
 }
 
-bool DynamicGesture::detect(jointCoords_t jointCoords)
+bool DynamicGesture::detect(const jointCoords_t &jointCoords, int64_t elapsedUs)
 {
-    cout << "Dynamic Gesture " << id << " state " << state << endl;
-
     if(intermediate_gestures.size() == 0)
     {
         return false;
     }
 
-    intermediate_gestures[state].detect(jointCoords);
+    return detect(intermediate_gestures[progress.stage].isWithinThreshold(jointCoords), elapsedUs);
+}
+
+bool DynamicGesture::detect(bool stageWithinThreshold, int64_t elapsedUs)
+{
+    return advanceDynamicGesture(progress, id, intermediate_gestures.size(), stageWithinThreshold, elapsedUs);
+}
+
+void DynamicGesture::resetStates(void)
+{
+    resetDynamicGesture(progress);
+}
+
+void resetDynamicGesture(dynamic_gesture_progress_t &progress)
+{
+    resetStaticGesture(progress.stageState);
+    progress.stage = 0;
+    progress.usInState = 0;
+}
+
+bool advanceDynamicGesture(dynamic_gesture_progress_t &progress, gestures_e id, unsigned int numStages,
+                           bool stageWithinThreshold, int64_t elapsedUs)
+{
+    if(numStages == 0)
+    {
+        return false;
+    }
 
-    static_gesture_states_e int_state = intermediate_gestures[state].getState();
+    advanceStaticGesture(progress.stageState, id, stageWithinThreshold, elapsedUs);
 
-    if(int_state == STATIC_GESTURE_STATE_DETECTING)
+    if(progress.stageState.static_gesture_state == STATIC_GESTURE_STATE_DETECTING)
     {
-        intermediate_gestures[state].resetGestureState();
-        cyclesInState = 0;
+        uint32_t ms = progress.usInState / 1000;
+
+        resetStaticGesture(progress.stageState);
+        progress.usInState = 0;
 
-        if(state == intermediate_gestures.size()-1)
+        if(progress.stage == numStages-1)
         {
-            resetStates();
+            traceEvent(TRACE_GESTURE_DETECTED, id, progress.stage, 0, ms);
+            resetDynamicGesture(progress);
             return true;
         }
         else
         {
-            state++;
+            traceEvent(TRACE_DYNAMIC_STAGE, id, progress.stage, progress.stage + 1, ms);
+            progress.stage++;
         }
     }
-    else if(cyclesInState >= DYNAMIC_POSE_TIMEOUT)
+    else if(progress.usInState >= MS_TO_US(DYNAMIC_POSE_TIMEOUT_MS))
     {
-        resetStates();
+        if(progress.stage != 0)
+        {
+            traceEvent(TRACE_DYNAMIC_STAGE, id, progress.stage, 0, progress.usInState / 1000);
+        }
+        resetDynamicGesture(progress);
     }
     else
     {
-        cyclesInState++;
+        progress.usInState += elapsedUs;
     }
 
     return false;
 }
-
-void DynamicGesture::resetStates(void)
-{
-    int n = intermediate_gestures.size();
-
-    for(int i = 0; i < n; i++)
-    {
-        intermediate_gestures[i].resetGestureState();
-    }
-
-    state = 0;
-    cyclesInState = 0;
-}
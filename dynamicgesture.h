@@ -4,16 +4,31 @@
 #include "gesture.h"
 #include <vector>
 
-#define DYNAMIC_POSE_TIMEOUT 20
+// Longest a stage may take before the gesture starts over (20 frames at 30 fps)
+#define DYNAMIC_POSE_TIMEOUT_MS 660
 
 using namespace std;
 
+// Where one person is in a dynamic gesture. Only the current stage's pose
+// state is needed: earlier stages are reset as they complete.
+struct dynamic_gesture_progress_t
+{
+    unsigned int stage;
+    int64_t usInState;
+    static_gesture_states_t stageState;
+};
+
+// The dynamic gesture state machine, shared by DynamicGesture and the
+// per-person state in GestureEngine. Returns true when the last stage completes.
+void resetDynamicGesture(dynamic_gesture_progress_t &progress);
+bool advanceDynamicGesture(dynamic_gesture_progress_t &progress, gestures_e id, unsigned int numStages,
+                           bool stageWithinThreshold, int64_t elapsedUs);
+
 class DynamicGesture
 {
 private:
     vector<Gesture> intermediate_gestures;
-    unsigned int state;
-    unsigned int cyclesInState;
+    dynamic_gesture_progress_t progress;
 
 public:
     DynamicGesture(gestures_e id) : id(id)
@@ -23,7 +38,14 @@ public:
 
     void addIntermediateGesture(Gesture g);
 
-    bool detect(jointCoords_t jointCoords);
+    bool detect(const jointCoords_t &jointCoords, int64_t elapsedUs);
+    // Advance given whether this frame is inside the current stage's box
+    // and the capture time since the previous frame
+    bool detect(bool stageWithinThreshold, int64_t elapsedUs);
+
+    unsigned int currentStage(void) const { return progress.stage; }
+    unsigned int numStages(void) const { return intermediate_gestures.size(); }
+    const Gesture &getStage(unsigned int i) const { return intermediate_gestures[i]; }
 
     void resetStates(void);
 
@@ -0,0 +1,63 @@
+// Exports the binary analytics store in the analytics.txt format that
+// reporting reads.
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "analytics.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    string storePath = ANALYTICS_STORE_FILE;
+    string textPath;
+
+    if(argc > 3 || (argc > 1 && string(argv[1]) == "--help"))
+    {
+        cerr << "Usage: " << argv[0] << " [store] [text file]" << endl
+             << "  store defaults to " << ANALYTICS_STORE_FILE << ", text goes to stdout" << endl;
+        return -1;
+    }
+    if(argc > 1)
+    {
+        storePath = argv[1];
+    }
+    if(argc > 2)
+    {
+        textPath = argv[2];
+    }
+
+    AnalyticsStore store;
+    if(!store.open(storePath, false))
+    {
+        return -1;
+    }
+
+    if(textPath.empty())
+    {
+        store.exportText(stdout);
+        return 0;
+    }
+
+    // Written beside the target and renamed over it, so reporting never
+    // sees a half written file
+    string temp = textPath + ".tmp";
+    FILE *out = fopen(temp.c_str(), "w");
+    if(!out)
+    {
+        perror("Error opening text file");
+        return -1;
+    }
+
+    store.exportText(out);
+    if(fclose(out) != 0 || rename(temp.c_str(), textPath.c_str()) != 0)
+    {
+        perror("Error writing text file");
+        remove(temp.c_str());
+        return -1;
+    }
+
+    return 0;
+}
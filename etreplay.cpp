@@ -0,0 +1,772 @@
+// Replays a skeleton recording through the gesture engine and program FSM,
+// without a camera or a screen. Used for regression runs and to measure
+// gesture engine throughput.
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iomanip>
+#include <vector>
+#include <memory>
+
+#include "main.h"
+#include "builtinmatcher.h"
+#include "catalog.h"
+#include "gestureengine.h"
+#include "latency.h"
+#include "prefetch.h"
+#include "recording.h"
+#include "statemachine.h"
+#include "timeline.h"
+#include "trace.h"
+#include "videoplayer.h"
+
+using namespace std;
+
+#define BENCH_FUZZ_FRAMES 4096
+// Sensor noise added to the held poses of --bench-index
+#define BENCH_JITTER 2
+
+// Random joints around the table's own bounds, so every comparison is
+// exercised on both sides and exactly on the edge
+static jointCoords_t fuzzJoints(const GestureTable &table)
+{
+    const threshold_box_t &box = table.getBoxes()[rand() % table.size()];
+    int delta[NUM_DELTAS];
+    jointCoords_t jc;
+
+    for(int d = 0; d < NUM_DELTAS; d++)
+    {
+        int edge = (rand() & 1) ? box.min[d] : box.max[d];
+        delta[d] = (rand() % 4 == 0) ? rand() % 501 - 250 : edge + rand() % 3 - 1;
+    }
+
+    jc.Lshoulderx = rand() % 640;
+    jc.Lshouldery = rand() % 480;
+    jc.Lshoulderz = rand() % 4000;
+    jc.Rshoulderx = rand() % 640;
+    jc.Rshouldery = rand() % 480;
+    jc.Rshoulderz = rand() % 4000;
+    jc.Lhandx = jc.Lshoulderx - delta[DELTA_LX];
+    jc.Lhandy = jc.Lshouldery - delta[DELTA_LY];
+    jc.Lhandz = jc.Lshoulderz - delta[DELTA_LZ];
+    jc.Rhandx = jc.Rshoulderx - delta[DELTA_RX];
+    jc.Rhandy = jc.Rshouldery - delta[DELTA_RY];
+    jc.Rhandz = jc.Rshoulderz - delta[DELTA_RZ];
+    jc.Spinex = jc.Spiney = jc.Spinez = 0;
+    jc.headx = jc.heady = jc.headz = 0;
+
+    return jc;
+}
+
+// How currentVideoType() used to find the clip on screen: ask lsof which
+// file VLC has open, once per frame
+static gestures_e lsofVideoType(void)
+{
+    char buf[20] = "";
+
+    do
+    {
+        FILE *pPipe;
+        pPipe = popen("lsof -wc vlc | awk '$4~\"[0-9]r\" && $5==\"REG\"' | grep -o '[^/]*$'", "r");
+
+        if(fgets(buf, 20, pPipe) == NULL)
+        {
+            buf[0] = '\0';
+        }
+
+        pclose(pPipe);
+    }
+    while(strstr(buf, "maps") != NULL);
+
+    if(strstr(buf, "ready") != NULL)
+    {
+        return GESTURE_READY;
+    }
+    else if(strstr(buf, "idle") != NULL)
+    {
+        return GESTURE_IDLE;
+    }
+    else if(strstr(buf, "mov") != NULL || strstr(buf, "mp4") != NULL)
+    {
+        return GESTURE_USAIN;
+    }
+    return GESTURE_UNDEFINED;
+}
+
+// Time the per-frame clip query before and after playback events: the lsof
+// pipeline against the player's atomic, with a clip playing
+static int benchPlayer(int reps)
+{
+    ofstream discard;
+    StubSink stubSink(discard);
+    VideoPlayer videoPlayer(&stubSink);
+    volatile int sink = 0;
+
+    player = &videoPlayer;
+    videoPlayer.play(GESTURE_USAIN, DEFAULT_VIDEO);
+    videoPlayer.waitIdle();
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for(int r = 0; r < reps; r++)
+    {
+        sink += lsofVideoType();
+    }
+    double lsofSec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    // The atomic load is too quick to time over a few calls
+    int64_t loads = (int64_t)reps * 100000;
+    t0 = chrono::steady_clock::now();
+    for(int64_t r = 0; r < loads; r++)
+    {
+        sink += currentVideoType();
+    }
+    double loadSec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    player = nullptr;
+
+    cout << "lsof: " << lsofSec * 1e6 / reps << " us/frame, "
+         << reps / lsofSec << " frames/s at most" << endl;
+    cout << "player->current(): " << loadSec * 1e9 / loads << " ns/frame" << endl;
+    return 0;
+}
+
+// Time the engine stepping one person through the recorded skeletons in
+// order, as the replay does, with the match cache on and then off
+static void benchMatchCache(shared_ptr<const GestureTable> table, const vector<jointCoords_t> &joints, int reps)
+{
+    GestureEngine engine(table);
+    person_skeleton_t person;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    volatile int sink = 0;
+    double ns[2];
+
+    person.pid = 1;
+    fill(person.confidence, person.confidence + NUM_SKELETON_JOINTS, 100);
+
+    for(int pass = 0; pass < 2; pass++)
+    {
+        engine.setMatchCache(pass == 0);
+        engine.reset();
+
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        for(int r = 0; r < reps; r++)
+        {
+            for(size_t f = 0; f < joints.size(); f++)
+            {
+                person.joints = joints[f];
+                sink += engine.detect(&person, 1, start + chrono::milliseconds(33 * (r * joints.size() + f + 1)));
+            }
+        }
+        ns[pass] = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count() / ((double)reps * joints.size());
+
+        // The engine's own sampled estimate, before turning the cache off
+        // starts its stats over
+        if(pass == 0)
+        {
+            engine.printMatchCache(stdout);
+        }
+    }
+
+    cout << "engine, match cache: " << ns[0] << " ns/frame" << endl;
+    cout << "engine, no match cache: " << ns[1] << " ns/frame" << endl;
+    cout << "match cache saves " << ns[1] - ns[0] << " ns/frame" << endl;
+}
+
+// Compare the SIMD matcher, and on the built-in gesture set the compiled
+// one, against the one-box-at-a-time reference on the recorded skeletons
+// plus fuzzed ones, and time them all. Then time the match cache.
+static int benchMatch(shared_ptr<const GestureTable> tablePtr, vector<jointCoords_t> &joints, int reps)
+{
+    const GestureTable &table = *tablePtr;
+    int words = table.maskWords();
+    vector<uint64_t> simd(words);
+    vector<uint64_t> compiled(words);
+    vector<uint64_t> scalar(words);
+    volatile uint64_t sink = 0;     // keeps the timed calls from being optimised away
+    size_t recorded = joints.size();
+    bool builtin = table.isBuiltin();
+
+    srand(1);
+    for(int i = 0; i < BENCH_FUZZ_FRAMES; i++)
+    {
+        joints.push_back(fuzzJoints(table));
+    }
+
+    uint64_t matched = 0;
+    for(size_t i = 0; i < joints.size(); i++)
+    {
+        table.getMatcher().match(joints[i], simd.data());
+        table.matchAllScalar(joints[i], scalar.data());
+        if(builtin)
+        {
+            matchBuiltin(joints[i], compiled.data());
+        }
+        if(simd != scalar || (builtin && compiled != scalar))
+        {
+            cerr << "Error: match mismatch on skeleton " << i << endl;
+            return -1;
+        }
+        for(int w = 0; w < words; w++)
+        {
+            matched += __builtin_popcountll(simd[w]);
+        }
+    }
+
+    cout << table.size() << " boxes, " << recorded << " recorded + " << BENCH_FUZZ_FRAMES
+         << " fuzzed skeletons, " << matched << " box matches, identical" << endl;
+
+    for(int pass = 0; pass < (builtin ? 3 : 2); pass++)
+    {
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        for(int r = 0; r < reps; r++)
+        {
+            for(const jointCoords_t &jc : joints)
+            {
+                if(pass == 0)
+                {
+                    table.matchAllScalar(jc, scalar.data());
+                    sink += scalar[0];
+                }
+                else if(pass == 1)
+                {
+                    table.getMatcher().match(jc, simd.data());
+                    sink += simd[0];
+                }
+                else
+                {
+                    matchBuiltin(jc, compiled.data());
+                    sink += compiled[0];
+                }
+            }
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+        cout << (pass == 0 ? "scalar" : pass == 1 ? BoxMatcher::kernelName() : "compiled") << ": "
+             << sec * 1e9 / ((double)reps * joints.size()) << " ns/skeleton" << endl;
+    }
+
+    if(!builtin)
+    {
+        cout << "not the built-in gesture set, no compiled matcher" << endl;
+    }
+
+    joints.resize(recorded);
+    benchMatchCache(tablePtr, joints, reps);
+
+    return 0;
+}
+
+// Synthetic gesture sets for --bench-index: boxes the size of the real ones
+// spread over the reach of the arms, the first eight around the pose of a
+// recorded skeleton so the replay still triggers gestures
+static vector<gesture_def_t> syntheticGestures(const vector<jointCoords_t> &joints, int n)
+{
+    static const int reach[NUM_DELTAS] = { 200, 250, 400, 200, 250, 400 };
+    vector<gesture_def_t> defs(n);
+    int32_t values[NUM_MATCH_VALUES];
+
+    for(int g = 0; g < n; g++)
+    {
+        gesture_def_t &def = defs[g];
+        threshold_box_t box;
+        bool recorded = g < 8;
+
+        matchValues(joints[rand() % joints.size()], values);
+        for(int d = 0; d < NUM_DELTAS; d++)
+        {
+            bool depth = d == DELTA_LZ || d == DELTA_RZ;
+            int half = depth ? 100 + rand() % 150 : 20 + rand() % 25;
+            int centre = recorded ? values[d] + rand() % (half + 1) - half / 2
+                                  : rand() % (2 * reach[d] + 1) - reach[d] + (depth ? 300 : 0);
+            box.min[d] = max(centre - half, -MAXCOORD);
+            box.max[d] = min(centre + half, MAXCOORD);
+        }
+
+        def.id = (gestures_e)(rand() % GESTURE_RUNNING);
+        def.dynamic = false;
+        def.stages.push_back(box);
+    }
+
+    return defs;
+}
+
+// Check the box tree and the engine's partial state machine walk against
+// testing every box and stepping every gesture, on 16 to 4096 synthetic
+// gestures, and time both. The engine is timed with the match cache on at
+// every size and then off, and what the cache saves is the difference.
+static int benchIndex(vector<jointCoords_t> &joints, int reps)
+{
+    static const int sizes[] = { 16, 24, 32, 64, 256, 4096 };
+    volatile int64_t sink = 0;
+    size_t recorded = joints.size();
+
+    srand(1);
+    for(int n : sizes)
+    {
+        shared_ptr<const GestureTable> table = GestureTable::compile(syntheticGestures(joints, n));
+        vector<uint64_t> mask(table->maskWords());
+        vector<int32_t> hits(n);
+        vector<int32_t> scalarHits(n);
+        vector<jointCoords_t> frames(joints.begin(), joints.begin() + recorded);
+
+        for(int i = 0; i < BENCH_FUZZ_FRAMES; i++)
+        {
+            frames.push_back(fuzzJoints(*table));
+        }
+
+        uint64_t matched = 0;
+        for(size_t i = 0; i < frames.size(); i++)
+        {
+            int numHits = table->matchIndexed(frames[i], hits.data());
+            int numScalar = 0;
+
+            table->matchAllScalar(frames[i], mask.data());
+            for(int b = 0; b < n; b++)
+            {
+                if(maskBit(mask.data(), b))
+                {
+                    scalarHits[numScalar++] = b;
+                }
+            }
+            if(numHits != numScalar || !equal(hits.begin(), hits.begin() + numHits, scalarHits.begin()))
+            {
+                cerr << "Error: index mismatch on skeleton " << i << " with " << n << " gestures" << endl;
+                return -1;
+            }
+            matched += numHits;
+        }
+
+        cout << n << " gestures, " << table->size() << " boxes, " << frames.size() << " skeletons, "
+             << (double)matched / frames.size() << " boxes hit per skeleton, identical" << endl;
+
+        for(int pass = 0; pass < 3; pass++)
+        {
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            for(int r = 0; r < reps; r++)
+            {
+                for(const jointCoords_t &jc : frames)
+                {
+                    if(pass == 0)
+                    {
+                        table->matchAllScalar(jc, mask.data());
+                        sink += mask[0];
+                    }
+                    else if(pass == 1)
+                    {
+                        table->matchAll(jc, mask.data());
+                        sink += mask[0];
+                    }
+                    else
+                    {
+                        sink += table->matchIndexed(jc, hits.data());
+                    }
+                }
+            }
+            double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+            cout << "  match " << (pass == 0 ? "scalar" : pass == 1 ? BoxMatcher::kernelName() : "tree") << ": "
+                 << sec * 1e9 / ((double)reps * frames.size()) << " ns/skeleton" << endl;
+        }
+
+        // Recorded skeletons in order, so poses are held and gestures fire,
+        // with a little sensor noise on every joint
+        vector<jointCoords_t> held(joints.begin(), joints.begin() + recorded);
+        for(jointCoords_t &jc : held)
+        {
+            int *coords = (int *)&jc;
+            for(size_t c = 0; c < sizeof(jointCoords_t) / sizeof(int); c++)
+            {
+                coords[c] += rand() % (2 * BENCH_JITTER + 1) - BENCH_JITTER;
+            }
+        }
+
+        GestureEngine engine(table);
+        vector<static_gesture_states_t> states(n);
+        person_skeleton_t person;
+
+        // The reference below steps on the joints as they are; the engine is
+        // timed as it runs, smoothing them
+        fill(person.confidence, person.confidence + NUM_SKELETON_JOINTS, 100);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        int detections = 0;
+        double cachedNs = 0;
+
+        for(int pass = 0; pass < 4; pass++)
+        {
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            chrono::steady_clock::time_point previous = start;
+            engine.setSmoothing(pass >= 2);
+            engine.setMatchCache(pass == 2);
+            engine.reset();
+            for(int i = 0; i < n; i++)
+            {
+                resetStaticGesture(states[i]);
+            }
+
+            for(int r = 0; r < (pass == 0 ? 1 : reps); r++)
+            {
+                for(size_t f = 0; f < recorded; f++)
+                {
+                    chrono::steady_clock::time_point captured = start + chrono::milliseconds(33 * (r * recorded + f + 1));
+                    int64_t elapsedUs = frameIntervalUs(previous, captured);
+                    gestures_e expected = GESTURE_UNDEFINED;
+                    gestures_e got = GESTURE_UNDEFINED;
+
+                    previous = captured;
+                    person.pid = 1;
+                    person.joints = held[f];
+
+                    if(pass < 2)
+                    {
+                        // Every gesture stepped on a full match, as before the tree
+                        table->matchAll(held[f], mask.data());
+                        for(int i = 0; i < n; i++)
+                        {
+                            if(advanceStaticGesture(states[i], table->getEntries()[i].id, maskBit(mask.data(), i), elapsedUs))
+                            {
+                                expected = table->getEntries()[i].id;
+                            }
+                        }
+                        if(expected != GESTURE_UNDEFINED)
+                        {
+                            for(int i = 0; i < n; i++)
+                            {
+                                resetStaticGesture(states[i]);
+                            }
+                        }
+                    }
+                    if(pass != 1)
+                    {
+                        got = engine.detect(&person, 1, captured);
+                    }
+
+                    if(pass == 0)
+                    {
+                        if(got != expected)
+                        {
+                            cerr << "Error: engine detected " << gestureName(got) << " instead of " << gestureName(expected)
+                                 << " on frame " << f << " with " << n << " gestures" << endl;
+                            return -1;
+                        }
+                        detections += got != GESTURE_UNDEFINED;
+                    }
+                    sink += got + expected;
+                }
+            }
+            double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+            if(pass == 0)
+            {
+                cout << "  engine: " << detections << " detections on " << recorded << " frames, identical" << endl;
+            }
+            else
+            {
+                double ns = sec * 1e9 / ((double)reps * recorded);
+
+                cout << "  step " << (pass == 1 ? "every gesture" : pass == 2 ? "engine, match cache" : "engine, no match cache")
+                     << ": " << ns << " ns/frame" << endl;
+                if(pass == 2)
+                {
+                    cachedNs = ns;
+                    cout << "  ";
+                    engine.printMatchCache(stdout);
+                }
+                else if(pass == 3)
+                {
+                    cout << "  match cache saves " << ns - cachedNs << " ns/frame" << endl;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    string path;
+    bool realtime = false;
+    bool quiet = false;
+    double clipLength = 5.0;
+    string gesturesPath(GESTURES_FILE);
+    int benchReps = 0;
+    int indexReps = 0;
+    int playerReps = 0;
+    string tracePath;
+    double fps = 0;
+    bool timeline = false;
+    bool latency = false;
+    string contentDir;
+    bool matchCache = false;
+    bool smoothing = true;
+    int jitter = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        string arg(argv[i]);
+
+        if(arg == "--realtime")
+        {
+            realtime = true;
+        }
+        else if(arg == "--quiet")
+        {
+            quiet = true;
+        }
+        else if(arg == "--clip-length" && i + 1 < argc)
+        {
+            clipLength = atof(argv[++i]);
+        }
+        else if(arg == "--gestures" && i + 1 < argc)
+        {
+            gesturesPath = argv[++i];
+        }
+        else if(arg == "--fps" && i + 1 < argc)
+        {
+            fps = atof(argv[++i]);
+        }
+        else if(arg == "--trace" && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if(arg == "--timeline")
+        {
+            timeline = true;
+        }
+        else if(arg == "--latency")
+        {
+            // Only --realtime replays have capture and tracking stamps
+            latency = true;
+        }
+        else if(arg == "--content" && i + 1 < argc)
+        {
+            // Pick clips from a real directory instead of the default video
+            contentDir = argv[++i];
+        }
+        else if(arg == "--match-cache")
+        {
+            matchCache = true;
+        }
+        else if(arg == "--no-smoothing")
+        {
+            smoothing = false;
+        }
+        else if(arg == "--jitter" && i + 1 < argc)
+        {
+            // Sensor noise: every joint coordinate moves by up to this much each frame
+            jitter = atoi(argv[++i]);
+        }
+        else if(arg == "--bench-match" && i + 1 < argc)
+        {
+            benchReps = atoi(argv[++i]);
+        }
+        else if(arg == "--bench-index" && i + 1 < argc)
+        {
+            indexReps = atoi(argv[++i]);
+        }
+        else if(arg == "--bench-player" && i + 1 < argc)
+        {
+            // Needs no recording
+            playerReps = atoi(argv[++i]);
+        }
+        else if(path.empty() && arg[0] != '-')
+        {
+            path = arg;
+        }
+        else
+        {
+            path.clear();
+            break;
+        }
+    }
+
+    if(playerReps > 0)
+    {
+        return benchPlayer(playerReps);
+    }
+
+    if(path.empty())
+    {
+        cerr << "Usage: " << argv[0] << " <recording.etsk> [--realtime] [--quiet] [--clip-length <sec>] [--gestures <file>]"
+             << " [--fps <rate>] [--trace <file>] [--timeline] [--latency] [--content <dir>] [--bench-match <reps>]"
+             << " [--bench-index <reps>] [--bench-player <reps>]"
+             << " [--match-cache] [--no-smoothing] [--jitter <units>]" << endl;
+        return -1;
+    }
+
+    SkeletonReplay replay;
+    if(!replay.open(path, realtime))
+    {
+        return -1;
+    }
+
+    if(benchReps > 0 || indexReps > 0)
+    {
+        vector<jointCoords_t> joints;
+        tracked_frame_t frame;
+
+        while(replay.next(frame))
+        {
+            for(int i = 0; i < frame.numSkeletons; i++)
+            {
+                joints.push_back(frame.skeletons[i].joints);
+            }
+        }
+        if(joints.empty())
+        {
+            cerr << "Error: " << path << " has no skeletons" << endl;
+            return -1;
+        }
+
+        if(indexReps > 0)
+        {
+            return benchIndex(joints, indexReps);
+        }
+        return benchMatch(loadGestureTableOrBuiltin(gesturesPath), joints, benchReps);
+    }
+
+    // Clips never really play here; the stub ends each one after clipLength
+    // seconds of recorded time.
+    ofstream discard;
+    StubSink stubSink(quiet ? discard : cout);
+    VideoPlayer videoPlayer(&stubSink);
+    player = &videoPlayer;
+
+    unique_ptr<ContentCatalog> contentCatalog;
+    unique_ptr<ClipPrefetcher> clipPrefetcher;
+    if(!contentDir.empty())
+    {
+        contentCatalog.reset(new ContentCatalog(contentDir));
+        catalog = contentCatalog.get();
+        clipPrefetcher.reset(new ClipPrefetcher(catalog, ""));
+        prefetcher = clipPrefetcher.get();
+        player->setFirstFrameObserver(prefetcher);
+    }
+
+    TraceWriter trace;
+    if(!tracePath.empty() && !trace.open(tracePath))
+    {
+        return -1;
+    }
+
+    GestureEngine gestureEngine(loadGestureTableOrBuiltin(gesturesPath));
+    gestureEngine.setMatchCache(matchCache);
+    gestureEngine.setSmoothing(smoothing);
+    StateMachine stateMachine(&gestureEngine);
+    srand(1);
+
+    ResampledReplay resampled(replay, fps);
+    tracked_frame_t frame;
+    chrono::steady_clock::time_point first;
+    uint64_t frames = 0;
+    uint64_t gestures = 0;
+    chrono::nanoseconds engineTime(0);
+    chrono::steady_clock::time_point clipStart;
+    gestures_e clipType = GESTURE_UNDEFINED;
+    uint64_t clipCount = 0;
+
+    while(fps > 0 ? resampled.next(frame) : replay.next(frame))
+    {
+        state_e before = stateMachine.getState();
+
+        if(frames == 0)
+        {
+            first = frame.captured;
+        }
+
+        for(int p = 0; jitter > 0 && p < frame.numSkeletons; p++)
+        {
+            int *coords = (int *)&frame.skeletons[p].joints;
+            for(size_t c = 0; c < sizeof(jointCoords_t) / sizeof(int); c++)
+            {
+                coords[c] += rand() % (2 * jitter + 1) - jitter;
+            }
+        }
+
+        // Stand in for the end of the clip on screen
+        gestures_e playing = videoPlayer.current();
+        uint64_t started = stubSink.clipsStarted();
+        if(playing != clipType || started != clipCount)
+        {
+            clipType = playing;
+            clipCount = started;
+            clipStart = frame.captured;
+        }
+        else if(playing != GESTURE_UNDEFINED &&
+                frame.captured - clipStart >= chrono::duration<double>(clipLength))
+        {
+            stubSink.finish();
+        }
+
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        stateMachine.step(frame);
+        engineTime += chrono::steady_clock::now() - t0;
+
+        latency_stamps_t stamps = frameLatencyStamps(frame);
+        stamps.ns[LATENCY_DECIDED] = latencyNow();
+        recordFrameLatency(stamps);
+
+        // Let the player catch up, so the replay does not depend on thread timing
+        videoPlayer.waitIdle();
+
+        frames++;
+
+        state_e after = stateMachine.getState();
+        if(after == STATE_PLAYBACK_START)
+        {
+            gestures++;
+        }
+
+        if(!quiet && after != before)
+        {
+            cout << "frame " << frame.frame_id << " (" << fixed << setprecision(3)
+                 << chrono::duration<double>(frame.captured - first).count() << " s): "
+                 << stateName(before) << " -> " << stateName(after);
+            if(after == STATE_PLAYBACK_START)
+            {
+                cout << " (gesture " << stateMachine.getGestureDetected() << ")";
+            }
+            cout << endl;
+        }
+    }
+
+    double engineSec = chrono::duration<double>(engineTime).count();
+
+    cout << frames << " frames, gestures triggered: " << gestures << endl;
+    if(frames > 0 && engineSec > 0)
+    {
+        cout << "FSM + gesture engine: " << engineSec * 1e9 / frames << " ns/frame, "
+             << frames / engineSec << " frames/s" << endl;
+    }
+
+    gestureEngine.printMatchCache(stdout);
+
+    if(timeline)
+    {
+        // Bucketed by wall clock, so the whole replay lands in the last minute or two
+        cout << "Timeline, last hour:" << endl;
+        analytics_timeline.print(cout, TIMELINE_SCALE_MINUTE, 60);
+    }
+
+    if(latency)
+    {
+        videoPlayer.waitIdle();
+        printLatencyReport(stdout, false);
+    }
+
+    if(clipPrefetcher)
+    {
+        videoPlayer.waitIdle();
+        player->setFirstFrameObserver(nullptr);
+        prefetcher = nullptr;
+        clipPrefetcher->print(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,305 @@
+// Keeps electricTree running. The app beats in the control region on every
+// pass of its decision loop and publishes each pipeline stage's frame count;
+// when the beat goes quiet or a stage stops moving past its deadline, the
+// app is killed and started again, backing off while restarts keep failing.
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "control.h"
+
+using namespace std;
+
+#define SUPERVISOR_LOG "/home/capstone38/Desktop/electricTree/supervisor.log"
+#define SUPERVISOR_POLL_MS 250
+#define SUPERVISOR_STARTUP_MS 30000         // camera start-up, before the first beat
+#define SUPERVISOR_BEAT_DEADLINE_MS 5000    // longest the decision loop may go without a beat
+#define SUPERVISOR_STALL_DEADLINE_MS 10000  // longest a stage may go without a new frame
+#define SUPERVISOR_KILL_GRACE_MS 3000       // SIGTERM, then SIGKILL after this long
+#define SUPERVISOR_BACKOFF_MIN_MS 1000
+#define SUPERVISOR_BACKOFF_MAX_MS 60000
+#define SUPERVISOR_HEALTHY_MS 300000        // a run this long resets the backoff
+
+static const char *stage_names[NUM_CONTROL_STAGES] = { "capture", "tracking", "decision" };
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+static int64_t steadyMs(void)
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void logLine(const string &logPath, const string &text)
+{
+    time_t now = time(nullptr);
+    struct tm local;
+    char stamp[32];
+
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+    cerr << stamp << " " << text << endl;
+
+    FILE *file = fopen(logPath.c_str(), "a");
+    if(file)
+    {
+        fprintf(file, "%s %s\n", stamp, text.c_str());
+        fclose(file);
+    }
+}
+
+static pid_t spawn(const vector<string> &command)
+{
+    vector<char *> argv;
+    for(const string &arg : command)
+    {
+        argv.push_back((char *)arg.c_str());
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        execvp(argv[0], argv.data());
+        perror("Error starting the app");
+        _exit(127);
+    }
+    else if(pid < 0)
+    {
+        perror("Error forking");
+    }
+    return pid;
+}
+
+static string exitReason(int status)
+{
+    if(WIFEXITED(status))
+    {
+        return "exited with status " + to_string(WEXITSTATUS(status));
+    }
+    return string("killed by signal ") + to_string(WTERMSIG(status)) + " (" + strsignal(WTERMSIG(status)) + ")";
+}
+
+static void stopApp(pid_t pid)
+{
+    int status;
+
+    kill(pid, SIGTERM);
+    for(int64_t deadline = steadyMs() + SUPERVISOR_KILL_GRACE_MS; steadyMs() < deadline; )
+    {
+        if(waitpid(pid, &status, WNOHANG) == pid)
+        {
+            return;
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+}
+
+// Watch one run of the app. Returns why it ended; clean is set when it quit
+// by itself with status 0, which is how the cancel tool stops it.
+static string supervise(pid_t pid, const string &controlName, int64_t startupMs, int64_t beatMs, int64_t stallMs,
+                        bool &clean)
+{
+    ControlClient client(controlName);
+    bool seen = false;
+    int64_t started = steadyMs();
+    uint64_t lastProgress[NUM_CONTROL_STAGES];
+    int64_t lastMoved[NUM_CONTROL_STAGES];
+
+    clean = false;
+
+    for(;;)
+    {
+        int status;
+
+        this_thread::sleep_for(chrono::milliseconds(SUPERVISOR_POLL_MS));
+
+        if(waitpid(pid, &status, WNOHANG) == pid)
+        {
+            clean = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            return exitReason(status);
+        }
+
+        if(stopRequested)
+        {
+            stopApp(pid);
+            return "supervisor asked to stop";
+        }
+
+        int64_t now = steadyMs();
+        control_heartbeat_t heartbeat;
+
+        // The region may still be the last run's until this one replaces it
+        if(!seen && client.open())
+        {
+            if(client.readHeartbeat(heartbeat) && heartbeat.pid == pid)
+            {
+                seen = true;
+                for(int i = 0; i < NUM_CONTROL_STAGES; i++)
+                {
+                    lastProgress[i] = heartbeat.progress[i];
+                    lastMoved[i] = now;
+                }
+            }
+            else
+            {
+                client.close();
+            }
+        }
+
+        if(!seen)
+        {
+            if(now - started > startupMs)
+            {
+                stopApp(pid);
+                return "no heartbeat within " + to_string(startupMs) + " ms of starting";
+            }
+            continue;
+        }
+
+        client.readHeartbeat(heartbeat);
+
+        int64_t silentMs = now - heartbeat.beat_ns / 1000000;
+        if(silentMs > beatMs)
+        {
+            stopApp(pid);
+            return "main loop silent for " + to_string(silentMs) + " ms";
+        }
+
+        for(int i = 0; i < NUM_CONTROL_STAGES; i++)
+        {
+            if(heartbeat.progress[i] != lastProgress[i])
+            {
+                lastProgress[i] = heartbeat.progress[i];
+                lastMoved[i] = now;
+            }
+            else if(now - lastMoved[i] > stallMs)
+            {
+                stopApp(pid);
+                return string(stage_names[i]) + " stage stalled at frame " + to_string(lastProgress[i]) +
+                       " for " + to_string(now - lastMoved[i]) + " ms";
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    string logPath(SUPERVISOR_LOG);
+    string controlName(CONTROL_SHM_NAME);
+    int64_t startupMs = SUPERVISOR_STARTUP_MS;
+    int64_t beatMs = SUPERVISOR_BEAT_DEADLINE_MS;
+    int64_t stallMs = SUPERVISOR_STALL_DEADLINE_MS;
+    int64_t backoffMinMs = SUPERVISOR_BACKOFF_MIN_MS;
+    vector<string> command;
+
+    for(int i = 1; i < argc; i++)
+    {
+        string arg(argv[i]);
+
+        if(arg == "--log" && i + 1 < argc)
+        {
+            logPath = argv[++i];
+        }
+        else if(arg == "--startup-ms" && i + 1 < argc)
+        {
+            startupMs = atoll(argv[++i]);
+        }
+        else if(arg == "--beat-ms" && i + 1 < argc)
+        {
+            beatMs = atoll(argv[++i]);
+        }
+        else if(arg == "--stall-ms" && i + 1 < argc)
+        {
+            stallMs = atoll(argv[++i]);
+        }
+        else if(arg == "--backoff-ms" && i + 1 < argc)
+        {
+            backoffMinMs = atoll(argv[++i]);
+        }
+        else if(arg == "--control" && i + 1 < argc)
+        {
+            // The region the app beats in, if not electricTree's own
+            controlName = argv[++i];
+        }
+        else if(arg == "--")
+        {
+            command.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        else
+        {
+            command.clear();
+            break;
+        }
+    }
+
+    if(command.empty())
+    {
+        cerr << "Usage: " << argv[0] << " [--log <file>] [--startup-ms <ms>] [--beat-ms <ms>] [--stall-ms <ms>]"
+             << " [--backoff-ms <ms>] [--control <name>] -- <app> [args]" << endl;
+        return -1;
+    }
+
+    signal(SIGTERM, requestStop);
+    signal(SIGINT, requestStop);
+
+    int64_t backoffMs = backoffMinMs;
+
+    while(!stopRequested)
+    {
+        int64_t started = steadyMs();
+        pid_t pid = spawn(command);
+        bool clean = false;
+        string reason;
+
+        if(pid < 0)
+        {
+            reason = string("could not start: ") + strerror(errno);
+        }
+        else
+        {
+            logLine(logPath, "started " + command[0] + " as pid " + to_string(pid));
+            reason = supervise(pid, controlName, startupMs, beatMs, stallMs, clean);
+        }
+
+        if(clean || stopRequested)
+        {
+            logLine(logPath, command[0] + " " + reason + ", not restarting");
+            break;
+        }
+
+        if(steadyMs() - started >= SUPERVISOR_HEALTHY_MS)
+        {
+            backoffMs = backoffMinMs;
+        }
+        logLine(logPath, "restarting in " + to_string(backoffMs) + " ms: " + reason);
+
+        for(int64_t until = steadyMs() + backoffMs; !stopRequested && steadyMs() < until; )
+        {
+            this_thread::sleep_for(chrono::milliseconds(50));
+        }
+        backoffMs = backoffMs * 2 > SUPERVISOR_BACKOFF_MAX_MS ? SUPERVISOR_BACKOFF_MAX_MS : backoffMs * 2;
+    }
+
+    return 0;
+}
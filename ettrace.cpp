@@ -0,0 +1,237 @@
+// Decodes a binary state trace (.ettr) written by electricTree or etreplay
+// into one line of text per transition, or with --triggers sums up how long
+// static gestures took to trigger.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "main.h"
+#include "statemachine.h"
+#include "trace.h"
+
+using namespace std;
+
+static const char *staticStateName(int state)
+{
+    switch(state)
+    {
+    case STATIC_GESTURE_STATE_INIT: return "INIT";
+    case STATIC_GESTURE_STATE_DETECTING: return "DETECTING";
+    case STATIC_GESTURE_STATE_LOST: return "LOST";
+    default: return "UNDEFINED";
+    }
+}
+
+static string gestureLabel(int id)
+{
+    if(id < 0 || id > GESTURE_UNDEFINED)
+    {
+        return "gesture " + to_string(id);
+    }
+    return gestureName((gestures_e)id);
+}
+
+static void printTime(const trace_file_header_t &header, uint64_t time_ns)
+{
+    int64_t wall_ns = header.wallStart_ns + (int64_t)(time_ns - header.steadyStart_ns);
+    time_t sec = wall_ns / 1000000000;
+    struct tm local;
+    char text[32];
+
+    localtime_r(&sec, &local);
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    printf("%s.%03d  ", text, (int)((wall_ns / 1000000) % 1000));
+}
+
+// One static gesture from leaving INIT until it triggers or falls back.
+// The trace does not say whose gesture it is, so two people in the same
+// pose at once share one attempt.
+struct trigger_attempt_t
+{
+    bool open;
+    uint32_t lostMs;
+    int bounces;
+};
+
+struct trigger_stats_t
+{
+    vector<uint32_t> ms;        // time to trigger of every trigger
+    uint64_t bounces;           // DETECTING -> LOST on the way to a trigger
+    uint64_t abandoned;         // attempts that timed out in LOST
+};
+
+// Times come from the state machines' own timers, so a replay run faster
+// than real time reports recorded time
+static void countTrigger(const trace_record_t &record, trigger_attempt_t *attempts, trigger_stats_t *stats)
+{
+    if(record.kind != TRACE_STATIC_STATE || record.id >= GESTURE_UNDEFINED)
+    {
+        return;
+    }
+
+    trigger_attempt_t &attempt = attempts[record.id];
+    trigger_stats_t &s = stats[record.id];
+
+    if(record.from == STATIC_GESTURE_STATE_INIT && record.to == STATIC_GESTURE_STATE_DETECTING)
+    {
+        attempt.open = true;
+        attempt.lostMs = 0;
+        attempt.bounces = 0;
+    }
+    else if(!attempt.open)
+    {
+        return;
+    }
+    else if(record.from == STATIC_GESTURE_STATE_DETECTING && record.to == STATIC_GESTURE_STATE_LOST)
+    {
+        attempt.bounces++;
+    }
+    else if(record.from == STATIC_GESTURE_STATE_LOST && record.to == STATIC_GESTURE_STATE_DETECTING)
+    {
+        attempt.lostMs += record.value;
+    }
+    else if(record.from == STATIC_GESTURE_STATE_LOST && record.to == STATIC_GESTURE_STATE_INIT)
+    {
+        s.abandoned++;
+        attempt.open = false;
+    }
+    else if(record.from == STATIC_GESTURE_STATE_DETECTING && record.to == STATIC_GESTURE_STATE_INIT)
+    {
+        // Only a trigger leaves DETECTING for INIT; value is the time held
+        s.ms.push_back(record.value + attempt.lostMs);
+        s.bounces += attempt.bounces;
+        attempt.open = false;
+    }
+}
+
+static uint32_t percentile(const vector<uint32_t> &sorted, double p)
+{
+    size_t rank = max<size_t>(1, (size_t)ceil(p * sorted.size()));
+    return sorted[rank - 1];
+}
+
+static void printTriggerRow(const string &label, vector<uint32_t> &ms, uint64_t bounces, uint64_t abandoned)
+{
+    sort(ms.begin(), ms.end());
+    printf("%-14s %8zu", label.c_str(), ms.size());
+    if(ms.empty())
+    {
+        printf(" %8s %8s %8s %8s", "-", "-", "-", "-");
+    }
+    else
+    {
+        printf(" %8u %8u %8u %8.2f", percentile(ms, 0.50), percentile(ms, 0.95), ms.back(), (double)bounces / ms.size());
+    }
+    printf(" %10llu\n", (unsigned long long)abandoned);
+}
+
+static void printTriggers(trigger_stats_t *stats)
+{
+    vector<uint32_t> all;
+    uint64_t bounces = 0;
+    uint64_t abandoned = 0;
+
+    printf("%-14s %8s %8s %8s %8s %8s %10s\n", "time to trigger", "count", "p50 ms", "p95 ms", "max ms", "LOST", "abandoned");
+    for(int id = 0; id < GESTURE_UNDEFINED; id++)
+    {
+        trigger_stats_t &s = stats[id];
+        if(s.ms.empty() && s.abandoned == 0)
+        {
+            continue;
+        }
+        all.insert(all.end(), s.ms.begin(), s.ms.end());
+        bounces += s.bounces;
+        abandoned += s.abandoned;
+        printTriggerRow(gestureLabel(id), s.ms, s.bounces, s.abandoned);
+    }
+    printTriggerRow("all", all, bounces, abandoned);
+}
+
+int main(int argc, char** argv)
+{
+    trace_file_header_t header;
+    trace_record_t record;
+    bool triggers = argc == 3 && string(argv[1]) == "--triggers";
+    const char *path = argv[argc - 1];
+    trigger_attempt_t attempts[GESTURE_UNDEFINED] = {};
+    trigger_stats_t stats[GESTURE_UNDEFINED] = {};
+
+    if(argc != 2 && !triggers)
+    {
+        cerr << "Usage: " << argv[0] << " [--triggers] <trace.ettr>" << endl;
+        return -1;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if(!file)
+    {
+        perror("Error opening trace file");
+        return -1;
+    }
+
+    if(fread(&header, sizeof(header), 1, file) != 1 ||
+       memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != TRACE_VERSION ||
+       header.recordSize != sizeof(trace_record_t))
+    {
+        cerr << "Error: " << path << " is not a trace this version can read" << endl;
+        fclose(file);
+        return -1;
+    }
+
+    while(fread(&record, sizeof(record), 1, file) == 1)
+    {
+        if(triggers)
+        {
+            countTrigger(record, attempts, stats);
+            continue;
+        }
+
+        printTime(header, record.time_ns);
+
+        switch(record.kind)
+        {
+        case TRACE_STATIC_STATE:
+            printf("%-10s %-14s %s -> %s after %u ms\n", traceKindName(TRACE_STATIC_STATE),
+                   gestureLabel(record.id).c_str(), staticStateName(record.from), staticStateName(record.to),
+                   record.value);
+            break;
+
+        case TRACE_DYNAMIC_STAGE:
+            printf("%-10s %-14s stage %d -> %d after %u ms\n", traceKindName(TRACE_DYNAMIC_STAGE),
+                   gestureLabel(record.id).c_str(), record.from, record.to, record.value);
+            break;
+
+        case TRACE_GESTURE_DETECTED:
+            printf("%-10s %s\n", traceKindName(TRACE_GESTURE_DETECTED), gestureLabel(record.id).c_str());
+            break;
+
+        case TRACE_PROGRAM_STATE:
+            printf("%-10s %s -> %s after %u ms\n", traceKindName(TRACE_PROGRAM_STATE),
+                   stateName((state_e)record.from), stateName((state_e)record.to), record.value);
+            break;
+
+        case TRACE_DROPPED:
+            printf("%-10s %u records lost, trace ring was full\n", traceKindName(TRACE_DROPPED), record.value);
+            break;
+
+        default:
+            printf("unknown record kind %d\n", record.kind);
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if(triggers)
+    {
+        printTriggers(stats);
+    }
+    return 0;
+}
@@ -1,138 +1,237 @@
 #include "gesture.h"
+#include "trace.h"
 #include <iostream>
 
 
 using namespace std;
 
 void Gesture::resetGestureState(void)
+{
+    resetStaticGesture(state);
+}
+
+void Gesture::setBox(int ls_lh_x_min,
+                     int ls_lh_x_max,
+                     int ls_lh_y_min,
+                     int ls_lh_y_max,
+                     int ls_lh_z_min,
+                     int ls_lh_z_max,
+                     int rs_rh_x_min,
+                     int rs_rh_x_max,
+                     int rs_rh_y_min,
+                     int rs_rh_y_max,
+                     int rs_rh_z_min,
+                     int rs_rh_z_max)
+{
+    box.min[DELTA_LX] = ls_lh_x_min;
+    box.max[DELTA_LX] = ls_lh_x_max;
+    box.min[DELTA_LY] = ls_lh_y_min;
+    box.max[DELTA_LY] = ls_lh_y_max;
+    box.min[DELTA_LZ] = ls_lh_z_min;
+    box.max[DELTA_LZ] = ls_lh_z_max;
+    box.min[DELTA_RX] = rs_rh_x_min;
+    box.max[DELTA_RX] = rs_rh_x_max;
+    box.min[DELTA_RY] = rs_rh_y_min;
+    box.max[DELTA_RY] = rs_rh_y_max;
+    box.min[DELTA_RZ] = rs_rh_z_min;
+    box.max[DELTA_RZ] = rs_rh_z_max;
+    box.form = thresholdFormFor(id);
+    box.id = id;
+    box.gesture = 0;
+    box.stage = 0;
+}
+
+bool Gesture::detect(const jointCoords_t &jointCoords, int64_t elapsedUs)
+{
+    return detect(isWithinThreshold(jointCoords), elapsedUs);
+}
+
+bool Gesture::detect(bool withinThreshold, int64_t elapsedUs)
+{
+    return advanceStaticGesture(state, id, withinThreshold, elapsedUs);
+}
+
+bool Gesture::detectDynamic(const jointCoords_t &jointCoords) {
+    return false;
+}
+
+bool Gesture::isWithinThreshold(const jointCoords_t &jointCoords)
+{
+    return boxContains(box, jointCoords);
+}
+
+// Scalar reference matcher. Every other matcher must agree with this one.
+bool boxContains(const threshold_box_t &box, const jointCoords_t &jointCoords)
+{
+    int LeftX = jointCoords.Lshoulderx - jointCoords.Lhandx;
+    int LeftY = jointCoords.Lshouldery - jointCoords.Lhandy;
+    int LeftZ = jointCoords.Lshoulderz - jointCoords.Lhandz;
+    int RightX = jointCoords.Rshoulderx - jointCoords.Rhandx;
+    int RightY = jointCoords.Rshouldery - jointCoords.Rhandy;
+    int RightZ = jointCoords.Rshoulderz - jointCoords.Rhandz;
+
+    switch(box.form)
+    {
+    case THRESHOLD_FORM_LEFT_ARM:
+        return ( (LeftX <= box.max[DELTA_LX]) &&
+                 (LeftX >= box.min[DELTA_LX]) &&
+                 (LeftY <= box.max[DELTA_LY]) &&
+                 (LeftY >= box.min[DELTA_LY]) &&
+                 (LeftZ <= box.max[DELTA_LZ]) &&
+                 (LeftZ >= box.min[DELTA_LZ]) &&
+                 ((RightY < box.max[DELTA_RY]) || (RightY > box.min[DELTA_RY])));
+
+    case THRESHOLD_FORM_RIGHT_ARM:
+        return ( (RightX <= box.max[DELTA_RX]) &&
+                 (RightX >= box.min[DELTA_RX]) &&
+                 (RightY <= box.max[DELTA_RY]) &&
+                 (RightY >= box.min[DELTA_RY]) &&
+                 (RightZ <= box.max[DELTA_RZ]) &&
+                 (RightZ >= box.min[DELTA_RZ]) &&
+                 ((LeftY < box.max[DELTA_LY]) || (LeftY > box.min[DELTA_LY])));
+
+    case THRESHOLD_FORM_STOP:
+        return ((LeftX >= box.min[DELTA_LX]) &&
+                (LeftX <= box.max[DELTA_LX]) &&
+                (LeftY >= box.min[DELTA_LY]) &&
+                (LeftY <= box.max[DELTA_LY]) &&
+                (jointCoords.Lhandz <= box.max[DELTA_LZ]));
+
+    default:
+        return (     (LeftX <= box.max[DELTA_LX]) &&
+                     (LeftX >= box.min[DELTA_LX]) &&
+                     (LeftY <= box.max[DELTA_LY]) &&
+                     (LeftY >= box.min[DELTA_LY]) &&
+                     (LeftZ <= box.max[DELTA_LZ]) &&
+                     (LeftZ >= box.min[DELTA_LZ]) &&
+                     (RightX <= box.max[DELTA_RX]) &&
+                     (RightX >= box.min[DELTA_RX]) &&
+                     (RightY <= box.max[DELTA_RY]) &&
+                     (RightY >= box.min[DELTA_RY]) &&
+                     (RightZ <= box.max[DELTA_RZ]) &&
+                     (RightZ >= box.min[DELTA_RZ])
+                     );
+    }
+}
+
+// Names used in gestures.json and in reports
+static const char *gesture_names[GESTURE_UNDEFINED + 1] =
+{
+    "USAIN",
+    "TPOSE",
+    "VICTORY",
+    "FLEXING",
+    "STOP",
+    "FLYING",
+    "WAVING_R",
+    "WAVING_L",
+    "JUMPING",
+    "POINTING_TRF",
+    "POINTING_RF",
+    "POINTING_TLF",
+    "POINTING_LF",
+    "POINTING_TR",
+    "POINTING_R",
+    "POINTING_TL",
+    "POINTING_L",
+    "RUNNING",
+    "IDLE",
+    "READY",
+    "UNDEFINED"
+};
+
+const char *gestureName(gestures_e id)
+{
+    if(id < 0 || id > GESTURE_UNDEFINED)
+    {
+        id = GESTURE_UNDEFINED;
+    }
+    return gesture_names[id];
+}
+
+gestures_e gestureFromName(const string &name)
+{
+    for(int i = 0; i < GESTURE_UNDEFINED; i++)
+    {
+        if(name == gesture_names[i])
+        {
+            return (gestures_e)i;
+        }
+    }
+    return GESTURE_UNDEFINED;
+}
+
+
+static_gesture_states_e Gesture::getState(void)
+{
+    return state.static_gesture_state;
+}
+
+void resetStaticGesture(static_gesture_states_t &state)
 {
     state.static_gesture_state = STATIC_GESTURE_STATE_INIT;
-    state.cyclesInState_static_gesture_detecting = 0;
-    state.cyclesInState_static_gesture_lost = 0;
+    state.usInState_static_gesture_detecting = 0;
+    state.usInState_static_gesture_lost = 0;
 }
 
-bool Gesture::detect(jointCoords_t jointCoords)
+bool advanceStaticGesture(static_gesture_states_t &state, gestures_e id, bool withinThreshold, int64_t elapsedUs)
 {
-    cout << "Gesture " << id << " state " << state.static_gesture_state << endl;
+    static_gesture_states_e before = state.static_gesture_state;
+    int64_t usInState = (before == STATIC_GESTURE_STATE_LOST) ? state.usInState_static_gesture_lost
+                                                              : state.usInState_static_gesture_detecting;
+    uint32_t ms = usInState / 1000;
 
     switch(state.static_gesture_state)
     {
     case STATIC_GESTURE_STATE_INIT:
-        if( isWithinThreshold(jointCoords) )
+        if( withinThreshold )
             {
                 state.static_gesture_state = STATIC_GESTURE_STATE_DETECTING;
-                state.cyclesInState_static_gesture_detecting = 0;
+                state.usInState_static_gesture_detecting = 0;
             }
         break;
     case STATIC_GESTURE_STATE_DETECTING:
-        if( isWithinThreshold(jointCoords) )
+        if( withinThreshold )
         {
-            state.cyclesInState_static_gesture_detecting++;
+            state.usInState_static_gesture_detecting += elapsedUs;
 
-            if(state.cyclesInState_static_gesture_detecting >= STATIC_POSE_DETECTING_TIMEOUT)
+            if(state.usInState_static_gesture_detecting >= MS_TO_US(STATIC_POSE_DETECTING_TIMEOUT_MS))
             {
-                resetGestureState();
+                ms = state.usInState_static_gesture_detecting / 1000;
+                resetStaticGesture(state);
+                traceEvent(TRACE_STATIC_STATE, id, before, STATIC_GESTURE_STATE_INIT, ms);
+                traceEvent(TRACE_GESTURE_DETECTED, id, 0, 0, ms);
                 return true;
             }
         }
         else
         {
             state.static_gesture_state = STATIC_GESTURE_STATE_LOST;
-            state.cyclesInState_static_gesture_lost = 0;
+            state.usInState_static_gesture_lost = 0;
         }
         break;
 
     case STATIC_GESTURE_STATE_LOST:
-        if( isWithinThreshold(jointCoords) )
+        if( withinThreshold )
         {
             state.static_gesture_state = STATIC_GESTURE_STATE_DETECTING;
-            state.cyclesInState_static_gesture_lost = 0;
+            state.usInState_static_gesture_lost = 0;
         }
-        else if(state.cyclesInState_static_gesture_lost >= STATIC_POSE_LOST_TIMEOUT)
+        else if(state.usInState_static_gesture_lost >= MS_TO_US(STATIC_POSE_LOST_TIMEOUT_MS))
         {
-            resetGestureState();
+            resetStaticGesture(state);
         }
         else
         {
-            state.cyclesInState_static_gesture_lost++;
+            state.usInState_static_gesture_lost += elapsedUs;
         }
         break;
     }
 
-    return false;
-}
-
-bool Gesture::detectDynamic(jointCoords_t jointCoords) {
-    return false;
-}
-
-bool Gesture::isWithinThreshold(jointCoords_t jointCoords)
-{
-    int LeftX = jointCoords.Lshoulderx - jointCoords.Lhandx;
-    int LeftY = jointCoords.Lshouldery - jointCoords.Lhandy;
-    int LeftZ = jointCoords.Lshoulderz - jointCoords.Lhandz;
-    int RightX = jointCoords.Rshoulderx - jointCoords.Rhandx;
-    int RightY = jointCoords.Rshouldery - jointCoords.Rhandy;
-    int RightZ = jointCoords.Rshoulderz - jointCoords.Rhandz;
-
-    if(id == GESTURE_POINTING_TRF ||
-       id == GESTURE_POINTING_RF  ||
-       id == GESTURE_POINTING_TR   ||
-       id == GESTURE_POINTING_R    ||
-       id == GESTURE_WAVING_R
-            )
-    {
-        return ( (LeftX <= ls_lh_x_max) &&
-                 (LeftX >= ls_lh_x_min ) &&
-                 (LeftY <= ls_lh_y_max) &&
-                 (LeftY >= ls_lh_y_min) &&
-                 (LeftZ <= ls_lh_z_max) &&
-                 (LeftZ >= ls_lh_z_min) &&
-                 ((RightY < rs_rh_y_max) || (RightY > rs_rh_y_min)));
-    }
-    else if(id == GESTURE_POINTING_TL ||
-            id == GESTURE_POINTING_L ||
-            id == GESTURE_POINTING_TLF ||
-            id == GESTURE_POINTING_LF  ||
-            id == GESTURE_WAVING_L
-            )
-    {
-        return ( (RightX <= rs_rh_x_max) &&
-                (RightX >= rs_rh_x_min ) &&
-                (RightY <= rs_rh_y_max) &&
-                (RightY >= rs_rh_y_min) &&
-                (RightZ <= rs_rh_z_max) &&
-                (RightZ >= rs_rh_z_min) &&
-                ((LeftY < ls_lh_y_max) || (LeftY > ls_lh_y_min)));
-    }
-    else if(id == GESTURE_STOP)
+    if(state.static_gesture_state != before)
     {
-        return ((LeftX >= ls_lh_x_min) &&
-                (LeftX <= ls_lh_x_max) &&
-                (LeftY >= ls_lh_y_min) &&
-                (LeftY <= ls_lh_y_max) &&
-                (jointCoords.Lhandz <= ls_lh_z_max));
+        traceEvent(TRACE_STATIC_STATE, id, before, state.static_gesture_state, ms);
     }
-    else
-    {
-        return (     (LeftX <= ls_lh_x_max) &&
-                     (LeftX >= ls_lh_x_min ) &&
-                     (LeftY <= ls_lh_y_max) &&
-                     (LeftY >= ls_lh_y_min) &&
-                     (LeftZ <= ls_lh_z_max) &&
-                     (LeftZ >= ls_lh_z_min) &&
-                     (RightX <= rs_rh_x_max) &&
-                     (RightX >= rs_rh_x_min ) &&
-                     (RightY <= rs_rh_y_max) &&
-                     (RightY >= rs_rh_y_min) &&
-                     (RightZ <= rs_rh_z_max) &&
-                     (RightZ >= rs_rh_z_min)
-                     );
-    }
-}
 
-
-static_gesture_states_e Gesture::getState(void)
-{
-    return state.static_gesture_state;
+    return false;
 }
@@ -1,14 +1,24 @@
 #ifndef GESTURE_H
 #define GESTURE_H
 
+#include <cstdint>
+#include <string>
 
-// gesture detection timeouts (units are frames)
-#define STATIC_POSE_DETECTING_TIMEOUT 7
-#define STATIC_POSE_LOST_TIMEOUT 10
-#define FLYING_TIMEOUT 20
-#define WAVING_TIMEOUT 20
-#define JUMPING_TIMEOUT 20
-#define RUNNING_TIMEOUT 25
+
+// gesture detection timeouts (units are milliseconds of capture time; each
+// sits just under the frame count it replaced at 30 fps)
+#define STATIC_POSE_DETECTING_TIMEOUT_MS 230    // 7 frames
+#define STATIC_POSE_LOST_TIMEOUT_MS 330         // 10 frames
+#define FLYING_TIMEOUT_MS 660
+#define WAVING_TIMEOUT_MS 660
+#define JUMPING_TIMEOUT_MS 660
+#define RUNNING_TIMEOUT_MS 830
+
+// A longer gap between two frames counts as this long, so a stall in the
+// pipeline cannot complete or time out a pose on its own
+#define MAX_FRAME_INTERVAL_MS 100
+
+#define MS_TO_US(a) ((int64_t)(a) * 1000)
 
 #define MAXCOORD 10000
 
@@ -64,6 +74,64 @@ enum gestures_e
     GESTURE_UNDEFINED
 };
 
+// Shoulder minus hand deltas that the threshold boxes are tested against
+enum joint_delta_e
+{
+    DELTA_LX=0,
+    DELTA_LY,
+    DELTA_LZ,
+    DELTA_RX,
+    DELTA_RY,
+    DELTA_RZ,
+    NUM_DELTAS
+};
+
+// How a box is compared against the deltas, fixed per gesture id
+enum threshold_form_e
+{
+    THRESHOLD_FORM_BOTH_ARMS=0,     // both boxes must hold
+    THRESHOLD_FORM_LEFT_ARM,        // left box, right hand outside its y band
+    THRESHOLD_FORM_RIGHT_ARM,       // right box, left hand outside its y band
+    THRESHOLD_FORM_STOP,            // left x/y box, absolute left hand depth below z max
+    NUM_THRESHOLD_FORMS
+};
+
+// Threshold box of one static gesture or one stage of a dynamic gesture.
+// Exactly one cache line in size; GestureTable lays them out on line boundaries.
+struct threshold_box_t
+{
+    int32_t min[NUM_DELTAS];
+    int32_t max[NUM_DELTAS];
+    int32_t form;       // threshold_form_e
+    int32_t id;         // gestures_e
+    int32_t gesture;    // index of the owning entry in a GestureTable
+    int32_t stage;      // stage within a dynamic gesture, 0 for static ones
+};
+
+static_assert(sizeof(threshold_box_t) == 64, "threshold_box_t must fill exactly one cache line");
+
+// Known when the gesture id is, so the compiled matcher can pick its form
+// at compile time
+constexpr threshold_form_e thresholdFormFor(gestures_e id)
+{
+    return (id == GESTURE_POINTING_TRF ||
+            id == GESTURE_POINTING_RF ||
+            id == GESTURE_POINTING_TR ||
+            id == GESTURE_POINTING_R ||
+            id == GESTURE_WAVING_R) ? THRESHOLD_FORM_LEFT_ARM :
+           (id == GESTURE_POINTING_TL ||
+            id == GESTURE_POINTING_L ||
+            id == GESTURE_POINTING_TLF ||
+            id == GESTURE_POINTING_LF ||
+            id == GESTURE_WAVING_L) ? THRESHOLD_FORM_RIGHT_ARM :
+           id == GESTURE_STOP ? THRESHOLD_FORM_STOP :
+           THRESHOLD_FORM_BOTH_ARMS;
+}
+bool boxContains(const threshold_box_t &box, const jointCoords_t &jointCoords);
+
+const char *gestureName(gestures_e id);
+gestures_e gestureFromName(const std::string &name);
+
 enum static_gesture_states_e
 {
     STATIC_GESTURE_STATE_INIT,
@@ -74,10 +142,15 @@ enum static_gesture_states_e
 struct static_gesture_states_t
 {
     static_gesture_states_e static_gesture_state;
-    int cyclesInState_static_gesture_detecting;
-    int cyclesInState_static_gesture_lost;
+    int64_t usInState_static_gesture_detecting;
+    int64_t usInState_static_gesture_lost;
 };
 
+// The static gesture state machine, shared by Gesture and the per-person
+// state in GestureEngine. Returns true when the pose has been held long enough.
+void resetStaticGesture(static_gesture_states_t &state);
+bool advanceStaticGesture(static_gesture_states_t &state, gestures_e id, bool withinThreshold, int64_t elapsedUs);
+
 struct dynamic_gesture_states_t
 {
     enum dynamic_gesture_states_e
@@ -95,20 +168,21 @@ class Gesture
 {
 private:
     struct static_gesture_states_t state;
-    int ls_lh_x_min;
-    int ls_lh_x_max;
-    int ls_lh_y_min;
-    int ls_lh_y_max;
-    int ls_lh_z_min;
-    int ls_lh_z_max;
-    int rs_rh_x_min;
-    int rs_rh_x_max;
-    int rs_rh_y_min;
-    int rs_rh_y_max;
-    int rs_rh_z_min;
-    int rs_rh_z_max;
+    threshold_box_t box;
     struct dynamic_gesture_states_t state_d;
 
+    void setBox(int ls_lh_x_min,
+                int ls_lh_x_max,
+                int ls_lh_y_min,
+                int ls_lh_y_max,
+                int ls_lh_z_min,
+                int ls_lh_z_max,
+                int rs_rh_x_min,
+                int rs_rh_x_max,
+                int rs_rh_y_min,
+                int rs_rh_y_max,
+                int rs_rh_z_min,
+                int rs_rh_z_max);
 
 public:
     Gesture(gestures_e id,
@@ -120,20 +194,10 @@ public:
             int rs_rh_x_max,
             int rs_rh_y_min,
             int rs_rh_y_max) :
-                id(id),
-                ls_lh_x_min(ls_lh_x_min),
-                ls_lh_x_max(ls_lh_x_max),
-                ls_lh_y_min(ls_lh_y_min),
-                ls_lh_y_max(ls_lh_y_max),
-                rs_rh_x_min(rs_rh_x_min),
-                rs_rh_x_max(rs_rh_x_max),
-                rs_rh_y_min(rs_rh_y_min),
-                rs_rh_y_max(rs_rh_y_max)
+                id(id)
     {
-        rs_rh_z_min = -MAXCOORD;
-        rs_rh_z_max = MAXCOORD;
-        ls_lh_z_min = -MAXCOORD;
-        ls_lh_z_max = MAXCOORD;
+        setBox(ls_lh_x_min, ls_lh_x_max, ls_lh_y_min, ls_lh_y_max, -MAXCOORD, MAXCOORD,
+               rs_rh_x_min, rs_rh_x_max, rs_rh_y_min, rs_rh_y_max, -MAXCOORD, MAXCOORD);
         resetGestureState();
     }
 
@@ -150,29 +214,28 @@ public:
             int rs_rh_y_max,
             int rs_rh_z_min,
             int rs_rh_z_max) :
-                id(id),
-                ls_lh_x_min(ls_lh_x_min),
-                ls_lh_x_max(ls_lh_x_max),
-                ls_lh_y_min(ls_lh_y_min),
-                ls_lh_y_max(ls_lh_y_max),
-                ls_lh_z_min(ls_lh_z_min),
-                ls_lh_z_max(ls_lh_z_max),
-                rs_rh_x_min(rs_rh_x_min),
-                rs_rh_x_max(rs_rh_x_max),
-                rs_rh_y_min(rs_rh_y_min),
-                rs_rh_y_max(rs_rh_y_max),
-                rs_rh_z_min(rs_rh_z_min),
-                rs_rh_z_max(rs_rh_z_max)
+                id(id)
+    {
+        setBox(ls_lh_x_min, ls_lh_x_max, ls_lh_y_min, ls_lh_y_max, ls_lh_z_min, ls_lh_z_max,
+               rs_rh_x_min, rs_rh_x_max, rs_rh_y_min, rs_rh_y_max, rs_rh_z_min, rs_rh_z_max);
+        resetGestureState();
+    }
+
+    Gesture(const threshold_box_t &box) : box(box), id((gestures_e)box.id)
     {
         resetGestureState();
     }
 
     void resetGestureState(void);
-    bool detect(jointCoords_t jointCoords);
-    bool detectDynamic(jointCoords_t jointCoords);
-    bool isWithinThreshold(jointCoords_t jointCoords);
+    bool detect(const jointCoords_t &jointCoords, int64_t elapsedUs);
+    // Advance the state machine given whether this frame is inside the box
+    // and the capture time since the previous frame
+    bool detect(bool withinThreshold, int64_t elapsedUs);
+    bool detectDynamic(const jointCoords_t &jointCoords);
+    bool isWithinThreshold(const jointCoords_t &jointCoords);
 
     static_gesture_states_e getState(void);
+    const threshold_box_t &getBox(void) const { return box; }
 
     gestures_e id;
 
@@ -0,0 +1,92 @@
+#ifndef GESTUREDEFINITIONS_H
+#define GESTUREDEFINITIONS_H
+
+#include "gesture.h"
+
+// The thresholds for detection of each built-in gesture, as constant data:
+// defineStaticGestures() and defineDynamicGestures() build the runtime
+// gestures from it, and the compiled matcher is generated from it.
+//
+// Boxes are laid out as GestureTable::compile() lays out the built-in set,
+// static gestures first, then the stages of each dynamic gesture.
+
+#define OPEN -MAXCOORD, MAXCOORD
+
+// Shoulder minus hand ranges: left x, y, z, then right x, y, z
+constexpr threshold_box_t armBox(gestures_e id,
+                                 int lxMin, int lxMax, int lyMin, int lyMax, int lzMin, int lzMax,
+                                 int rxMin, int rxMax, int ryMin, int ryMax, int rzMin, int rzMax)
+{
+    return threshold_box_t{ { lxMin, lyMin, lzMin, rxMin, ryMin, rzMin },
+                            { lxMax, lyMax, lzMax, rxMax, ryMax, rzMax },
+                            thresholdFormFor(id), id, 0, 0 };
+}
+
+static constexpr threshold_box_t builtin_boxes[] =
+{
+    //                                left x            left y        left z        right x            right y       right z
+    armBox(GESTURE_USAIN,             0, 80,            -60, 30,      OPEN,         -100, -50,         20, 70,       OPEN),
+    armBox(GESTURE_T,                 45, MAXCOORD,     -20, 20,      OPEN,         -MAXCOORD, -45,    -20, 20,      OPEN),
+    armBox(GESTURE_STOP,              -20, 40,          0, 60,        0, 1550,      OPEN,              OPEN,         0, MAXCOORD),
+    armBox(GESTURE_POINTING_TRF,      50, 90,           50, 90,       300, 500,     OPEN,              110, -40,     OPEN),
+    armBox(GESTURE_POINTING_RF,       60, 120,          -30, 30,      230, 670,     OPEN,              110, -40,     OPEN),
+    armBox(GESTURE_POINTING_TLF,      OPEN,             90, -50,      OPEN,         -100, -50,         40, 80,       180, 420),
+    armBox(GESTURE_POINTING_LF,       OPEN,             90, -50,      OPEN,         -120, -60,         -20, 30,      70, 550),
+    armBox(GESTURE_POINTING_TR,       50, 100,          30, 80,       -140, 20,     OPEN,              110, -40,     OPEN),
+    armBox(GESTURE_POINTING_R,        80, 110,          -20, 20,      -200, 20,     OPEN,              110, -40,     OPEN),
+    armBox(GESTURE_POINTING_TL,       OPEN,             90, -50,      OPEN,         -80, -50,          40, 80,       -120, 110),
+    armBox(GESTURE_POINTING_L,        OPEN,             90, -50,      OPEN,         -100, -70,         -10, 20,      -90, 110),
+    armBox(GESTURE_VICTORY,           45, 100,          45, 90,       OPEN,         -80, -30,          50, 100,      OPEN),
+    armBox(GESTURE_FLEXING,           0, 70,            0, 50,        OPEN,         -50, 0,            20, 50,       OPEN),
+
+    armBox(GESTURE_WAVING_R,          40, 90,           -20, 40,      OPEN,         0, -50,            50, 20,       OPEN),
+    armBox(GESTURE_WAVING_R,          -20, 40,          -20, 40,      OPEN,         0, -50,            50, 20,       OPEN),
+    armBox(GESTURE_WAVING_R,          40, 90,           -20, 40,      OPEN,         0, -50,            50, 20,       OPEN),
+    armBox(GESTURE_WAVING_R,          -20, 40,          -20, 40,      OPEN,         0, -50,            50, 20,       OPEN),
+
+    armBox(GESTURE_FLYING,            60, MAXCOORD,     -20, 30,      OPEN,         -100, MAXCOORD,    -10, 40,      OPEN),
+    armBox(GESTURE_FLYING,            OPEN,             -100, 0,      OPEN,         OPEN,              -90, -50,     OPEN),
+    armBox(GESTURE_FLYING,            OPEN,             -20, 30,      OPEN,         OPEN,              -10, 40,      OPEN),
+    armBox(GESTURE_FLYING,            OPEN,             -100, 0,      OPEN,         OPEN,              -90, -50,     OPEN),
+
+    armBox(GESTURE_WAVING_L,          80, 0,            50, 0,        OPEN,         -110, -50,         -50, 40,      OPEN),
+    armBox(GESTURE_WAVING_L,          70, 0,            50, 0,        OPEN,         -60, 0,            -20, 50,      OPEN),
+    armBox(GESTURE_WAVING_L,          70, 0,            50, 0,        OPEN,         -100, -50,         -20, 40,      OPEN),
+    armBox(GESTURE_WAVING_L,          70, 0,            50, 0,        OPEN,         -40, 0,            -20, 40,      OPEN)
+};
+
+#undef OPEN
+
+#define NUM_BUILTIN_BOXES ((int)(sizeof(builtin_boxes) / sizeof(builtin_boxes[0])))
+
+struct builtin_gesture_t
+{
+    gestures_e id;
+    bool dynamic;
+    int firstBox;
+    int numBoxes;
+};
+
+static constexpr builtin_gesture_t builtin_gestures[] =
+{
+    { GESTURE_USAIN,        false, 0,  1 },
+    { GESTURE_T,            false, 1,  1 },
+    { GESTURE_STOP,         false, 2,  1 },
+    { GESTURE_POINTING_TRF, false, 3,  1 },
+    { GESTURE_POINTING_RF,  false, 4,  1 },
+    { GESTURE_POINTING_TLF, false, 5,  1 },
+    { GESTURE_POINTING_LF,  false, 6,  1 },
+    { GESTURE_POINTING_TR,  false, 7,  1 },
+    { GESTURE_POINTING_R,   false, 8,  1 },
+    { GESTURE_POINTING_TL,  false, 9,  1 },
+    { GESTURE_POINTING_L,   false, 10, 1 },
+    { GESTURE_VICTORY,      false, 11, 1 },
+    { GESTURE_FLEXING,      false, 12, 1 },
+    { GESTURE_WAVING_R,     true,  13, 4 },
+    { GESTURE_FLYING,       true,  17, 4 },
+    { GESTURE_WAVING_L,     true,  21, 4 }
+};
+
+#define NUM_BUILTIN_GESTURES ((int)(sizeof(builtin_gestures) / sizeof(builtin_gestures[0])))
+
+#endif // GESTUREDEFINITIONS_H
@@ -0,0 +1,423 @@
+#include "gestureengine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+// ---------------------------------------------------------------------------
+// GestureEngine
+
+GestureEngine::GestureEngine(shared_ptr<const GestureTable> table) :
+    numStatic(0),
+    numDynamic(0),
+    smoothing(true),
+    cacheEnabled(false),
+    hasPending(false)
+{
+    cacheStats = match_cache_stats_t();
+    install(table);
+}
+
+void GestureEngine::install(shared_ptr<const GestureTable> newTable)
+{
+    table = newTable;
+    numStatic = 0;
+    numDynamic = 0;
+
+    for(const gesture_entry_t &entry : table->getEntries())
+    {
+        if(!entry.dynamic)
+        {
+            numStatic++;
+        }
+        else
+        {
+            numDynamic++;
+        }
+    }
+
+    staticStates.resize(GESTURE_SLOTS * numStatic);
+    dynamicStates.resize(GESTURE_SLOTS * numDynamic);
+    activeStatics.resize(GESTURE_SLOTS * numStatic);
+    stillActive.resize(numStatic);
+    matches.assign(table->maskWords(), 0);
+    hits.resize(GESTURE_SLOTS * table->size());
+    sampleHits.resize(table->size());
+
+    for(static_gesture_states_t &state : staticStates)
+    {
+        resetStaticGesture(state);
+    }
+
+    for(int slot = 0; slot < GESTURE_SLOTS; slot++)
+    {
+        slots[slot].pid = GESTURE_SLOT_FREE;
+        slots[slot].seenFrame = false;
+        numActiveStatics[slot] = 0;
+        caches[slot].valid = false;
+        resetJointFilter(filters[slot]);
+        resetSlot(slot);
+    }
+}
+
+void GestureEngine::replaceTable(shared_ptr<const GestureTable> newTable)
+{
+    lock_guard<mutex> guard(pendingLock);
+    pending = newTable;
+    hasPending.store(true, memory_order_release);
+}
+
+// Static gestures off the active list are in their initial state already
+void GestureEngine::resetSlot(int slot)
+{
+    for(int i = 0; i < numActiveStatics[slot]; i++)
+    {
+        resetStaticGesture(staticStates[slot * numStatic + activeStatics[slot * numStatic + i]]);
+    }
+    numActiveStatics[slot] = 0;
+
+    for(int i = 0; i < numDynamic; i++)
+    {
+        resetDynamicGesture(dynamicStates[slot * numDynamic + i]);
+    }
+}
+
+// Slot already holding pid, else a free one, else the one seen longest ago.
+// A slot whose person has been gone past the expiry starts over.
+int GestureEngine::findSlot(int pid, chrono::steady_clock::time_point captured)
+{
+    int victim = 0;
+
+    for(int slot = 0; slot < GESTURE_SLOTS; slot++)
+    {
+        if(slots[slot].pid == pid)
+        {
+            if(slots[slot].seenFrame &&
+               captured - slots[slot].lastFrame > chrono::milliseconds(GESTURE_SLOT_EXPIRY_MS))
+            {
+                resetSlot(slot);
+                resetJointFilter(filters[slot]);
+                slots[slot].seenFrame = false;
+            }
+            return slot;
+        }
+
+        if(slots[victim].pid == GESTURE_SLOT_FREE)
+        {
+            continue;
+        }
+        if(slots[slot].pid == GESTURE_SLOT_FREE || slots[slot].lastFrame < slots[victim].lastFrame)
+        {
+            victim = slot;
+        }
+    }
+
+    slots[victim].pid = pid;
+    slots[victim].seenFrame = false;
+    resetSlot(victim);
+    resetJointFilter(filters[victim]);
+    return victim;
+}
+
+// The boxes that hold this person, into their slot's part of hits
+int GestureEngine::matchPerson(int slot, const jointCoords_t &jointCoords)
+{
+    if(!cacheEnabled)
+    {
+        return table->matchList(jointCoords, matches.data(), hits.data() + slot * table->size());
+    }
+
+    if(++cacheStats.lookups % MATCH_CACHE_SAMPLE != 0)
+    {
+        return lookupMatch(slot, jointCoords);
+    }
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    int numHits = lookupMatch(slot, jointCoords);
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    table->matchList(jointCoords, matches.data(), sampleHits.data());
+    chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+
+    cacheStats.samples++;
+    cacheStats.lookupNs += chrono::duration<double, nano>(t1 - t0).count();
+    cacheStats.freshNs += chrono::duration<double, nano>(t2 - t1).count();
+    return numHits;
+}
+
+// The boxes hit last time if the pose has stayed clear of every bound,
+// otherwise a fresh match and how far it may move before it needs another
+int GestureEngine::lookupMatch(int slot, const jointCoords_t &jointCoords)
+{
+    match_cache_t &cache = caches[slot];
+    int32_t *slotHits = hits.data() + slot * table->size();
+    int32_t values[NUM_MATCH_VALUES];
+
+    matchValues(jointCoords, values);
+    if(cache.valid)
+    {
+        bool holds = true;
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            holds &= llabs((int64_t)values[d] - cache.values[d]) < cache.radius[d];
+        }
+        if(holds)
+        {
+            cacheStats.reused++;
+            return cache.numHits;
+        }
+    }
+
+    cache.numHits = table->matchList(jointCoords, matches.data(), slotHits);
+    copy(values, values + NUM_MATCH_VALUES, cache.values);
+    table->matchRadius(values, cache.radius);
+    cache.valid = true;
+    return cache.numHits;
+}
+
+gestures_e GestureEngine::detectPerson(int slot, const jointCoords_t &jointCoords, bool trusted, int64_t elapsedUs)
+{
+    gestures_e detectedGesture = GESTURE_UNDEFINED;
+    const vector<gesture_entry_t> &entries = table->getEntries();
+    static_gesture_states_t *statics = staticStates.data() + slot * numStatic;
+    dynamic_gesture_progress_t *dynamics = dynamicStates.data() + slot * numDynamic;
+
+    int32_t *active = activeStatics.data() + slot * numStatic;
+    int numActive = numActiveStatics[slot];
+    const int32_t *slotHits = hits.data() + slot * table->size();
+    int numHits = trusted ? matchPerson(slot, jointCoords) : 0;
+    int numStillActive = 0;
+    int h = 0;
+    int a = 0;
+
+    // Static boxes come first and share their entry's index. Walk the hits
+    // and the active gestures together, in gesture order.
+    while(true)
+    {
+        int hit = (h < numHits && slotHits[h] < numStatic) ? slotHits[h] : numStatic;
+        int next = (a < numActive) ? active[a] : numStatic;
+        int i = min(hit, next);
+
+        if(i == numStatic)
+        {
+            break;
+        }
+        if(hit == i)
+        {
+            h++;
+        }
+        if(next == i)
+        {
+            a++;
+        }
+
+        if(advanceStaticGesture(statics[i], entries[i].id, hit == i, elapsedUs))
+        {
+            detectedGesture = entries[i].id;
+        }
+        if(statics[i].static_gesture_state != STATIC_GESTURE_STATE_INIT)
+        {
+            stillActive[numStillActive++] = i;
+        }
+    }
+    copy(stillActive.begin(), stillActive.begin() + numStillActive, active);
+    numActiveStatics[slot] = numStillActive;
+
+    for(int i = 0; i < numDynamic; i++)
+    {
+        const gesture_entry_t &entry = entries[numStatic + i];
+        int box = entry.firstBox + dynamics[i].stage;
+        bool within = binary_search(slotHits + h, slotHits + numHits, box);
+
+        if(advanceDynamicGesture(dynamics[i], entry.id, entry.numBoxes, within, elapsedUs))
+        {
+            detectedGesture = entry.id;
+        }
+    }
+
+    return detectedGesture;
+}
+
+gestures_e GestureEngine::detect(const person_skeleton_t *skeletons, int numSkeletons,
+                                 chrono::steady_clock::time_point captured, gestures_e *perPerson)
+{
+    gestures_e detectedGesture = GESTURE_UNDEFINED;
+
+    if(hasPending.load(memory_order_acquire))
+    {
+        lock_guard<mutex> guard(pendingLock);
+        install(pending);
+        pending.reset();
+        hasPending.store(false, memory_order_relaxed);
+    }
+
+    for(int p = 0; p < numSkeletons; p++)
+    {
+        int slot = findSlot(skeletons[p].pid, captured);
+        gesture_slot_t &owner = slots[slot];
+        int64_t elapsedUs = 0;
+
+        if(owner.seenFrame)
+        {
+            elapsedUs = frameIntervalUs(owner.lastFrame, captured);
+        }
+        owner.lastFrame = captured;
+        owner.seenFrame = true;
+
+        // A joint out of sight for too long leaves the person in no box
+        const jointCoords_t *joints = &skeletons[p].joints;
+        jointCoords_t smoothed;
+        bool trusted = true;
+        if(smoothing)
+        {
+            trusted = advanceJointFilter(filters[slot], skeletons[p].joints, skeletons[p].confidence, elapsedUs, smoothed);
+            joints = &smoothed;
+        }
+
+        gestures_e g = detectPerson(slot, *joints, trusted, elapsedUs);
+        if(perPerson)
+        {
+            perPerson[p] = g;
+        }
+        if(detectedGesture == GESTURE_UNDEFINED)
+        {
+            detectedGesture = g;
+        }
+    }
+
+    // One gesture starts one clip; everybody starts over afterwards
+    if(detectedGesture != GESTURE_UNDEFINED)
+    {
+        reset();
+    }
+
+    return detectedGesture;
+}
+
+void GestureEngine::reset(void)
+{
+    for(int slot = 0; slot < GESTURE_SLOTS; slot++)
+    {
+        resetSlot(slot);
+    }
+}
+
+void GestureEngine::setSmoothing(bool enabled)
+{
+    smoothing = enabled;
+    for(int slot = 0; slot < GESTURE_SLOTS; slot++)
+    {
+        resetJointFilter(filters[slot]);
+    }
+}
+
+void GestureEngine::setMatchCache(bool enabled)
+{
+    cacheEnabled = enabled;
+    cacheStats = match_cache_stats_t();
+    for(int slot = 0; slot < GESTURE_SLOTS; slot++)
+    {
+        caches[slot].valid = false;
+    }
+}
+
+void GestureEngine::printMatchCache(FILE *out) const
+{
+    const match_cache_stats_t &s = cacheStats;
+
+    if(!cacheEnabled)
+    {
+        fprintf(out, "Match cache: off\n");
+        return;
+    }
+
+    fprintf(out, "Match cache: %llu of %llu matches reused (%.1f%%)",
+            (unsigned long long)s.reused, (unsigned long long)s.lookups,
+            s.lookups ? 100.0 * s.reused / s.lookups : 0.0);
+    if(s.samples > 0)
+    {
+        // Negative when the lookups cost more than the matches they spare
+        double savedNs = (s.freshNs - s.lookupNs) / s.samples;
+        fprintf(out, ", %s %.0f ns per match, %.1f ms in all",
+                savedNs >= 0 ? "saving" : "costing", fabs(savedNs), fabs(savedNs) * s.lookups / 1e6);
+    }
+    fprintf(out, "\n");
+}
+
+// ---------------------------------------------------------------------------
+// GestureFileWatcher
+
+static bool modifiedTime(const string &path, struct timespec &mtime)
+{
+    struct stat st;
+
+    if(stat(path.c_str(), &st) != 0)
+    {
+        return false;
+    }
+
+    mtime = st.st_mtim;
+    return true;
+}
+
+GestureFileWatcher::GestureFileWatcher(const string &path, GestureEngine *engine) :
+    path(path),
+    engine(engine),
+    running(true),
+    reloadRequested(false)
+{
+    lastModified.tv_sec = 0;
+    lastModified.tv_nsec = 0;
+    modifiedTime(path, lastModified);
+
+    worker = thread(&GestureFileWatcher::run, this);
+}
+
+GestureFileWatcher::~GestureFileWatcher()
+{
+    running = false;
+    worker.join();
+}
+
+void GestureFileWatcher::run(void)
+{
+    while(running)
+    {
+        struct timespec mtime;
+
+        this_thread::sleep_for(chrono::milliseconds(GESTURE_RELOAD_POLL_MS));
+
+        bool forced = reloadRequested.exchange(false);
+        if(!modifiedTime(path, mtime) ||
+           (!forced && mtime.tv_sec == lastModified.tv_sec && mtime.tv_nsec == lastModified.tv_nsec))
+        {
+            continue;
+        }
+        lastModified = mtime;
+
+        shared_ptr<const GestureTable> table = loadGestureTable(path);
+        if(table)
+        {
+            engine->replaceTable(table);
+            cout << "Reloaded " << table->getEntries().size() << " gestures from " << path << endl;
+        }
+        else
+        {
+            cerr << "Error: keeping the current gestures, " << path << " is invalid" << endl;
+        }
+    }
+}
+
+shared_ptr<const GestureTable> loadGestureTableOrBuiltin(const string &path)
+{
+    shared_ptr<const GestureTable> table = loadGestureTable(path);
+
+    if(!table)
+    {
+        cerr << "Warning: using built-in gestures, could not load " << path << endl;
+        table = GestureTable::compile(builtinGestureDefinitions());
+    }
+
+    return table;
+}
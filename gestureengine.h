@@ -0,0 +1,164 @@
+#ifndef GESTUREENGINE_H
+#define GESTUREENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#include "gesture.h"
+#include "dynamicgesture.h"
+#include "gesturetable.h"
+#include "jointfilter.h"
+#include "pipeline.h"
+
+using namespace std;
+
+#define GESTURE_RELOAD_POLL_MS 1000
+
+// Per-person state slots; a few more than MAX_GESTURE_PEOPLE so someone who
+// steps out of the zone for a moment keeps their progress
+#define GESTURE_SLOTS (2 * MAX_GESTURE_PEOPLE)
+// A slot not seen for this long starts over when its person comes back
+#define GESTURE_SLOT_EXPIRY_MS 1000
+
+#define GESTURE_SLOT_FREE -1
+
+// One match cache lookup in this many is timed against a fresh match of the
+// same joints, to estimate what the cache saves or costs
+#define MATCH_CACHE_SAMPLE 64
+
+// A slot's last evaluated match values, how far each may move before any
+// box could match differently, and how many of its hits are theirs
+struct match_cache_t
+{
+    bool valid;
+    int32_t values[NUM_MATCH_VALUES];
+    int32_t radius[NUM_MATCH_VALUES];
+    int numHits;
+};
+
+// The sampled times cover the whole lookup: the match values, the radius
+// check and, on a miss, the match and its radius. Each sample times a lookup
+// and a fresh match alike, so the timer overhead cancels in the difference.
+struct match_cache_stats_t
+{
+    uint64_t lookups;
+    uint64_t reused;
+    uint64_t samples;
+    double lookupNs;    // sampled lookups
+    double freshNs;     // fresh matches of the same joints
+};
+
+// Which person a state slot belongs to
+struct gesture_slot_t
+{
+    int pid;
+    bool seenFrame;
+    chrono::steady_clock::time_point lastFrame;
+};
+
+// Runs the gesture state machines against a compiled GestureTable for every
+// person in the centre zone. The table is shared read-only; each person only
+// owns their state, kept in a small pool of slots found by tracking id.
+// Each frame every person's joints are matched against the threshold boxes
+// into a list of the boxes that hold them, after smoothing in the person's
+// own joint filter. Only the static gestures in that
+// list or already part way through detection have their state machines run;
+// one still in its initial state and outside its box has nothing to do.
+// With the match cache on, a person holding a pose moves by sensor noise from
+// frame to frame; as long as no value moves far enough to cross a box bound,
+// the boxes hit last time are reused without matching again. The result is
+// always the same as a fresh match; the state machines still step on every
+// frame.
+class GestureEngine
+{
+private:
+    shared_ptr<const GestureTable> table;
+    int numStatic;
+    int numDynamic;
+
+    gesture_slot_t slots[GESTURE_SLOTS];
+    vector<static_gesture_states_t> staticStates;       // slot * numStatic + gesture
+    vector<dynamic_gesture_progress_t> dynamicStates;   // slot * numDynamic + gesture
+    // Static gestures of each slot not in their initial state, ascending
+    vector<int32_t> activeStatics;                      // slot * numStatic + n
+    int numActiveStatics[GESTURE_SLOTS];
+    vector<int32_t> stillActive;
+    vector<uint64_t> matches;
+    vector<int32_t> hits;                               // slot * boxes + n
+
+    joint_filter_t filters[GESTURE_SLOTS];
+    bool smoothing;
+
+    match_cache_t caches[GESTURE_SLOTS];
+    bool cacheEnabled;
+    match_cache_stats_t cacheStats;
+    vector<int32_t> sampleHits;
+
+    mutex pendingLock;
+    shared_ptr<const GestureTable> pending;
+    atomic<bool> hasPending;
+
+    void install(shared_ptr<const GestureTable> newTable);
+    int findSlot(int pid, chrono::steady_clock::time_point captured);
+    void resetSlot(int slot);
+    int matchPerson(int slot, const jointCoords_t &jointCoords);
+    int lookupMatch(int slot, const jointCoords_t &jointCoords);
+    gestures_e detectPerson(int slot, const jointCoords_t &jointCoords, bool trusted, int64_t elapsedUs);
+
+public:
+    GestureEngine(shared_ptr<const GestureTable> table);
+
+    // Safe from any thread. The new table is swapped in before the next
+    // frame is evaluated, and all gesture state starts over.
+    void replaceTable(shared_ptr<const GestureTable> newTable);
+
+    // Evaluate everyone in the frame. Returns the first gesture detected, in
+    // skeleton order, and optionally each person's result in perPerson.
+    // Gesture timing follows the capture timestamps, not the frame count.
+    gestures_e detect(const person_skeleton_t *skeletons, int numSkeletons,
+                      chrono::steady_clock::time_point captured, gestures_e *perPerson = nullptr);
+    void reset(void);
+
+    // Joints are smoothed before matching unless switched off here
+    void setSmoothing(bool enabled);
+
+    // The match cache is off unless switched on here; it only pays while
+    // people hold still inside wide boxes. Its stats start over.
+    void setMatchCache(bool enabled);
+    const match_cache_stats_t &getMatchCacheStats(void) const { return cacheStats; }
+    void printMatchCache(FILE *out) const;
+};
+
+// Watches the gesture file and hands every valid new version to the engine.
+// An invalid edit is reported and the running table is kept.
+class GestureFileWatcher
+{
+private:
+    string path;
+    GestureEngine *engine;
+    atomic<bool> running;
+    atomic<bool> reloadRequested;
+    thread worker;
+    struct timespec lastModified;
+
+    void run(void);
+
+public:
+    GestureFileWatcher(const string &path, GestureEngine *engine);
+    ~GestureFileWatcher();
+
+    // Reload at the next poll even if the file looks unchanged
+    void requestReload(void) { reloadRequested = true; }
+};
+
+// The table from path, or the built-in gestures if it cannot be loaded
+shared_ptr<const GestureTable> loadGestureTableOrBuiltin(const string &path);
+
+#endif // GESTUREENGINE_H
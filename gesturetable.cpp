@@ -0,0 +1,466 @@
+#include "gesturetable.h"
+#include "builtinmatcher.h"
+#include "main.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+using boost::property_tree::ptree;
+
+// ---------------------------------------------------------------------------
+// GestureTable
+
+GestureTable::~GestureTable()
+{
+    free(boxes);
+}
+
+shared_ptr<const GestureTable> GestureTable::compile(const vector<gesture_def_t> &defs)
+{
+    shared_ptr<GestureTable> table(new GestureTable());
+    int total = 0;
+    void *mem = nullptr;
+
+    for(const gesture_def_t &def : defs)
+    {
+        total += def.stages.size();
+    }
+
+    if(total > 0 && posix_memalign(&mem, GESTURE_TABLE_ALIGN, total * sizeof(threshold_box_t)) != 0)
+    {
+        return nullptr;
+    }
+
+    table->boxes = (threshold_box_t *)mem;
+    table->numBoxes = total;
+
+    // Static gestures first so their box index equals their entry index
+    int next = 0;
+    for(int pass = 0; pass < 2; pass++)
+    {
+        for(const gesture_def_t &def : defs)
+        {
+            if(def.dynamic != (pass == 1))
+            {
+                continue;
+            }
+
+            gesture_entry_t entry;
+            entry.id = def.id;
+            entry.dynamic = def.dynamic;
+            entry.firstBox = next;
+            entry.numBoxes = def.stages.size();
+
+            for(size_t stage = 0; stage < def.stages.size(); stage++)
+            {
+                threshold_box_t &box = table->boxes[next++];
+                box = def.stages[stage];
+                box.form = thresholdFormFor(def.id);
+                box.id = def.id;
+                box.gesture = table->entries.size();
+                box.stage = stage;
+            }
+
+            table->entries.push_back(entry);
+        }
+    }
+
+    if(!table->matcher.build(table->boxes, table->numBoxes))
+    {
+        return nullptr;
+    }
+    table->index.build(table->boxes, table->numBoxes);
+    table->builtin = isBuiltinGestureSet(table->boxes, table->numBoxes);
+
+    for(int i = 0; i < table->numBoxes; i++)
+    {
+        int32_t lo[NUM_MATCH_VALUES];
+        int32_t hi[NUM_MATCH_VALUES];
+        match_band_t band;
+
+        matchEnvelope(table->boxes[i], lo, hi, &band);
+        for(int d = 0; d < NUM_MATCH_VALUES; d++)
+        {
+            // An open side is a comparison that never changes
+            if(lo[d] != INT_MIN)
+            {
+                table->edges[d].push_back(lo[d]);
+            }
+            if(hi[d] != INT_MAX)
+            {
+                table->edges[d].push_back(hi[d]);
+            }
+        }
+        if(!band.off)
+        {
+            vector<int32_t> &bandEdges = table->edges[band.right ? DELTA_RY : DELTA_LY];
+            bandEdges.push_back(band.below);
+            bandEdges.push_back(band.above);
+        }
+    }
+    for(int d = 0; d < NUM_MATCH_VALUES; d++)
+    {
+        vector<int32_t> &e = table->edges[d];
+        sort(e.begin(), e.end());
+        e.erase(unique(e.begin(), e.end()), e.end());
+    }
+
+    return table;
+}
+
+void GestureTable::matchAll(const jointCoords_t &jointCoords, uint64_t *mask) const
+{
+#ifdef CONSTEXPR_GESTURES
+    if(builtin)
+    {
+        matchBuiltin(jointCoords, mask);
+        return;
+    }
+#endif
+    matcher.match(jointCoords, mask);
+}
+
+void GestureTable::matchAllScalar(const jointCoords_t &jointCoords, uint64_t *mask) const
+{
+    memset(mask, 0, maskWords() * sizeof(uint64_t));
+
+    for(int i = 0; i < numBoxes; i++)
+    {
+        if(boxContains(boxes[i], jointCoords))
+        {
+            mask[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+    }
+}
+
+int GestureTable::matchIndexed(const jointCoords_t &jointCoords, int32_t *hits) const
+{
+    return index.query(jointCoords, hits);
+}
+
+int GestureTable::matchList(const jointCoords_t &jointCoords, uint64_t *mask, int32_t *hits) const
+{
+    if(numBoxes >= GESTURE_INDEX_MIN_BOXES)
+    {
+        return index.query(jointCoords, hits);
+    }
+
+    int numHits = 0;
+    matchAll(jointCoords, mask);
+    for(int w = 0; w < maskWords(); w++)
+    {
+        for(uint64_t bits = mask[w]; bits; bits &= bits - 1)
+        {
+            hits[numHits++] = w * 64 + __builtin_ctzll(bits);
+        }
+    }
+    return numHits;
+}
+
+void GestureTable::matchRadius(const int32_t *values, int32_t *radius) const
+{
+    for(int d = 0; d < NUM_MATCH_VALUES; d++)
+    {
+        const vector<int32_t> &e = edges[d];
+        vector<int32_t>::const_iterator above = lower_bound(e.begin(), e.end(), values[d]);
+        int64_t r = INT_MAX;
+
+        if(above != e.end())
+        {
+            r = min(r, (int64_t)*above - values[d]);
+        }
+        if(above != e.begin())
+        {
+            r = min(r, (int64_t)values[d] - *(above - 1));
+        }
+        radius[d] = r;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Loading
+
+static void openBox(threshold_box_t &box)
+{
+    for(int d = 0; d < NUM_DELTAS; d++)
+    {
+        box.min[d] = -MAXCOORD;
+        box.max[d] = MAXCOORD;
+    }
+    box.form = THRESHOLD_FORM_BOTH_ARMS;
+    box.id = GESTURE_UNDEFINED;
+    box.gesture = 0;
+    box.stage = 0;
+}
+
+static bool parseRange(const ptree &node, int32_t &min, int32_t &max, string &error)
+{
+    int values[2];
+    int n = 0;
+
+    for(const ptree::value_type &item : node)
+    {
+        if(!item.first.empty() || n == 2)
+        {
+            error = "range must be [min, max]";
+            return false;
+        }
+
+        boost::optional<int> value = item.second.get_value_optional<int>();
+        if(!value)
+        {
+            error = "range bound '" + item.second.data() + "' is not an integer";
+            return false;
+        }
+        if(*value < -MAXCOORD || *value > MAXCOORD)
+        {
+            error = "range bound out of [-MAXCOORD, MAXCOORD]";
+            return false;
+        }
+        values[n++] = *value;
+    }
+
+    if(n != 2)
+    {
+        error = "range must be [min, max]";
+        return false;
+    }
+
+    // min > max is allowed: the one-arm forms use an inverted y band on
+    // the other hand to mean "outside this band".
+    min = values[0];
+    max = values[1];
+    return true;
+}
+
+static bool parseArm(const ptree &node, threshold_box_t &box, int base, string &error)
+{
+    for(const ptree::value_type &axis : node)
+    {
+        int d;
+
+        if(axis.first == "x")
+        {
+            d = base;
+        }
+        else if(axis.first == "y")
+        {
+            d = base + 1;
+        }
+        else if(axis.first == "z")
+        {
+            d = base + 2;
+        }
+        else
+        {
+            error = "unknown axis '" + axis.first + "'";
+            return false;
+        }
+
+        if(!parseRange(axis.second, box.min[d], box.max[d], error))
+        {
+            error = axis.first + ": " + error;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool parseBox(const ptree &node, threshold_box_t &box, string &error)
+{
+    openBox(box);
+
+    for(const ptree::value_type &item : node)
+    {
+        if(item.first == "left")
+        {
+            if(!parseArm(item.second, box, DELTA_LX, error))
+            {
+                error = "left " + error;
+                return false;
+            }
+        }
+        else if(item.first == "right")
+        {
+            if(!parseArm(item.second, box, DELTA_RX, error))
+            {
+                error = "right " + error;
+                return false;
+            }
+        }
+        else if(item.first != "gesture" && item.first != "stages")
+        {
+            error = "unknown key '" + item.first + "'";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool parseGesture(const ptree &node, bool dynamic, gesture_def_t &def, string &error)
+{
+    string name = node.get<string>("gesture", "");
+
+    def.id = gestureFromName(name);
+    def.dynamic = dynamic;
+    def.stages.clear();
+
+    if(def.id == GESTURE_UNDEFINED)
+    {
+        error = "unknown gesture '" + name + "'";
+        return false;
+    }
+
+    if(!dynamic)
+    {
+        threshold_box_t box;
+        if(node.count("stages") != 0)
+        {
+            error = name + ": static gestures have no stages";
+            return false;
+        }
+        if(!parseBox(node, box, error))
+        {
+            error = name + ": " + error;
+            return false;
+        }
+        def.stages.push_back(box);
+        return true;
+    }
+
+    boost::optional<const ptree &> stages = node.get_child_optional("stages");
+    if(!stages || stages->empty())
+    {
+        error = name + ": dynamic gestures need at least one stage";
+        return false;
+    }
+
+    for(const ptree::value_type &stage : *stages)
+    {
+        threshold_box_t box;
+        if(!parseBox(stage.second, box, error))
+        {
+            ostringstream where;
+            where << name << " stage " << def.stages.size() << ": " << error;
+            error = where.str();
+            return false;
+        }
+        def.stages.push_back(box);
+    }
+
+    return true;
+}
+
+bool loadGestureDefinitions(const string &path, vector<gesture_def_t> &defs)
+{
+    ptree root;
+    bool seen[GESTURE_UNDEFINED] = { false };
+
+    try
+    {
+        read_json(path, root);
+    }
+    catch(const boost::property_tree::json_parser_error &e)
+    {
+        cerr << "Error: " << e.what() << endl;
+        return false;
+    }
+
+    defs.clear();
+
+    for(const ptree::value_type &section : root)
+    {
+        bool dynamic;
+
+        if(section.first == "static")
+        {
+            dynamic = false;
+        }
+        else if(section.first == "dynamic")
+        {
+            dynamic = true;
+        }
+        else
+        {
+            cerr << "Error: " << path << ": unknown section '" << section.first << "'" << endl;
+            return false;
+        }
+
+        for(const ptree::value_type &item : section.second)
+        {
+            gesture_def_t def;
+            string error;
+
+            if(!parseGesture(item.second, dynamic, def, error))
+            {
+                cerr << "Error: " << path << ": " << error << endl;
+                return false;
+            }
+
+            if(seen[def.id])
+            {
+                cerr << "Error: " << path << ": " << gestureName(def.id) << " is defined twice" << endl;
+                return false;
+            }
+            seen[def.id] = true;
+
+            defs.push_back(def);
+        }
+    }
+
+    if(defs.empty())
+    {
+        cerr << "Error: " << path << ": no gestures defined" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+vector<gesture_def_t> builtinGestureDefinitions(void)
+{
+    vector<gesture_def_t> defs;
+
+    for(const Gesture &g : defineStaticGestures())
+    {
+        gesture_def_t def;
+        def.id = g.id;
+        def.dynamic = false;
+        def.stages.push_back(g.getBox());
+        defs.push_back(def);
+    }
+
+    for(const DynamicGesture &g : defineDynamicGestures())
+    {
+        gesture_def_t def;
+        def.id = g.id;
+        def.dynamic = true;
+        for(unsigned int i = 0; i < g.numStages(); i++)
+        {
+            def.stages.push_back(g.getStage(i).getBox());
+        }
+        defs.push_back(def);
+    }
+
+    return defs;
+}
+
+shared_ptr<const GestureTable> loadGestureTable(const string &path)
+{
+    vector<gesture_def_t> defs;
+
+    if(!loadGestureDefinitions(path, defs))
+    {
+        return nullptr;
+    }
+
+    return GestureTable::compile(defs);
+}
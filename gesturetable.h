@@ -0,0 +1,104 @@
+#ifndef GESTURETABLE_H
+#define GESTURETABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gesture.h"
+#include "dynamicgesture.h"
+#include "boxmatcher.h"
+#include "boxindex.h"
+
+using namespace std;
+
+#define GESTURE_TABLE_ALIGN 64
+// From this many boxes on, matchList() walks the box tree instead of
+// testing every box; below it one SIMD pass over all of them is faster
+#define GESTURE_INDEX_MIN_BOXES 1024
+
+// One gesture as read from gestures.json or gesturedefinitions.cpp.
+// A static gesture has exactly one stage.
+struct gesture_def_t
+{
+    gestures_e id;
+    bool dynamic;
+    vector<threshold_box_t> stages;
+};
+
+struct gesture_entry_t
+{
+    gestures_e id;
+    bool dynamic;
+    int firstBox;
+    int numBoxes;
+};
+
+// A gesture set compiled into one contiguous, cache-aligned array of
+// threshold boxes: static gestures first, then the stages of each dynamic
+// gesture in order. Never changed after compile(), so it can be shared
+// read-only and replaced as a whole on reload.
+class GestureTable
+{
+private:
+    threshold_box_t *boxes;
+    int numBoxes;
+    vector<gesture_entry_t> entries;
+    BoxMatcher matcher;
+    BoxIndex index;
+    bool builtin;
+    vector<int32_t> edges[NUM_MATCH_VALUES];    // every bound each value is compared with, sorted
+
+    GestureTable() : boxes(nullptr), numBoxes(0), builtin(false) {}
+    GestureTable(const GestureTable &) = delete;
+    GestureTable &operator=(const GestureTable &) = delete;
+
+public:
+    ~GestureTable();
+
+    static shared_ptr<const GestureTable> compile(const vector<gesture_def_t> &defs);
+
+    const threshold_box_t *getBoxes(void) const { return boxes; }
+    int size(void) const { return numBoxes; }
+    const vector<gesture_entry_t> &getEntries(void) const { return entries; }
+
+    int maskWords(void) const { return matcher.maskWords(); }
+
+    // Exactly the built-in gesture set, which a CONSTEXPR_GESTURES build
+    // matches with the compiled matcher
+    bool isBuiltin(void) const { return builtin; }
+    const BoxMatcher &getMatcher(void) const { return matcher; }
+
+    // Test every box against one frame; bit i of mask is set for box i.
+    // mask must hold maskWords() words.
+    void matchAll(const jointCoords_t &jointCoords, uint64_t *mask) const;
+
+    // Same result one box at a time through boxContains(), for checking
+    // and benchmarking matchAll()
+    void matchAllScalar(const jointCoords_t &jointCoords, uint64_t *mask) const;
+
+    // The boxes that contain the frame as a list, ascending, through the box
+    // tree; hits must have room for size() boxes
+    int matchIndexed(const jointCoords_t &jointCoords, int32_t *hits) const;
+
+    // Whichever of matchAll() and matchIndexed() suits the table size. mask
+    // is scratch space of maskWords() words.
+    int matchList(const jointCoords_t &jointCoords, uint64_t *mask, int32_t *hits) const;
+
+    // How far each match value may move before any comparison with it can
+    // change: the distance to the nearest bound a box compares it with.
+    // 0 for a value sitting on a bound.
+    void matchRadius(const int32_t *values, int32_t *radius) const;
+};
+
+// Parse and validate a gesture file. Problems are reported on cerr.
+bool loadGestureDefinitions(const string &path, vector<gesture_def_t> &defs);
+
+// The gesture set compiled into the program, used when no file can be loaded
+vector<gesture_def_t> builtinGestureDefinitions(void);
+
+// nullptr if the file is missing or invalid
+shared_ptr<const GestureTable> loadGestureTable(const string &path);
+
+#endif // GESTURETABLE_H
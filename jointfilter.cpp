@@ -0,0 +1,167 @@
+#include "jointfilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static_assert(sizeof(jointCoords_t) == JOINT_FILTER_VALUES * sizeof(int), "jointCoords_t is filtered as a plain array");
+static_assert(2 * JOINT_FILTER_HOLD_MS < STATIC_POSE_DETECTING_TIMEOUT_MS, "a held joint must not be able to trigger a pose");
+
+#define GAIN_ONE (1 << JOINT_FILTER_GAIN_BITS)
+#define GAIN_ROUND (1 << (JOINT_FILTER_GAIN_BITS - 1))
+#define RATE_BITS 4
+#define BETA_BITS 8
+
+// Shorter intervals are taken as this long when turning a change into a
+// speed, which keeps the product in 32 bits
+#define MIN_RATE_INTERVAL_US 5000
+
+// Time constants of the two low-pass filters
+static const int64_t min_cutoff_tau_us = (int64_t)(1e6 / (2 * M_PI * JOINT_FILTER_MIN_CUTOFF_HZ));
+static const int64_t speed_cutoff_tau_us = (int64_t)(1e6 / (2 * M_PI * JOINT_FILTER_SPEED_CUTOFF_HZ));
+
+// Gain of a low-pass with time constant tau over elapsedUs
+static int32_t lowPassGain(int64_t elapsedUs, int64_t tauUs)
+{
+    return (int32_t)((elapsedUs << JOINT_FILTER_GAIN_BITS) / (elapsedUs + tauUs));
+}
+
+void resetJointFilter(joint_filter_t &filter)
+{
+    filter.started = false;
+}
+
+// One step of every coordinate's filter. The same operations on each, with
+// no branches, so the loop vectorizes; it is built once more for AVX2.
+// Nothing past the coordinate range is a real joint, and clamping there
+// keeps every product in 32 bits.
+static inline __attribute__((always_inline))
+void smoothValues(const int32_t *in, const joint_filter_t &gains, int32_t *x, int32_t *dx, int32_t *out)
+{
+    const int32_t minGain = gains.minGain;
+    const int32_t speedGain = gains.speedGain;
+    const int32_t rate = gains.rate;
+    const int32_t betaGain = gains.betaGain;
+    const int32_t speedLimit = gains.speedLimit;
+
+    for(int v = 0; v < JOINT_FILTER_VALUES; v++)
+    {
+        int32_t raw = min(max(in[v], -MAXCOORD), MAXCOORD) << JOINT_FILTER_FRAC_BITS;
+        int32_t change = raw - x[v];
+        int32_t velocity = (change * rate) >> (JOINT_FILTER_FRAC_BITS + RATE_BITS);
+        velocity = min(max(velocity, -JOINT_FILTER_MAX_SPEED), JOINT_FILTER_MAX_SPEED);
+        int32_t newDx = dx[v] + ((speedGain * (velocity - dx[v]) + GAIN_ROUND) >> JOINT_FILTER_GAIN_BITS);
+        int32_t speed = min(abs(newDx), speedLimit);
+        int32_t gain = min(minGain + ((betaGain * speed) >> BETA_BITS), GAIN_ONE);
+
+        x[v] += (gain * change + GAIN_ROUND) >> JOINT_FILTER_GAIN_BITS;
+        dx[v] = newDx;
+        out[v] = (x[v] + (1 << (JOINT_FILTER_FRAC_BITS - 1))) >> JOINT_FILTER_FRAC_BITS;
+    }
+}
+
+typedef void (*smooth_kernel_t)(const int32_t *, const joint_filter_t &, int32_t *, int32_t *, int32_t *);
+
+static void smoothDefault(const int32_t *in, const joint_filter_t &gains, int32_t *x, int32_t *dx, int32_t *out)
+{
+    smoothValues(in, gains, x, dx, out);
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+__attribute__((target("avx2")))
+static void smoothAvx2(const int32_t *in, const joint_filter_t &gains, int32_t *x, int32_t *dx, int32_t *out)
+{
+    smoothValues(in, gains, x, dx, out);
+}
+#endif
+
+static smooth_kernel_t selectKernel(void)
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return smoothAvx2;
+    }
+#endif
+    return smoothDefault;
+}
+
+bool advanceJointFilter(joint_filter_t &filter, const jointCoords_t &joints, const uint8_t *confidence,
+                        int64_t elapsedUs, jointCoords_t &smoothed)
+{
+    static smooth_kernel_t kernel = selectKernel();
+    const int32_t *in = (const int32_t *)&joints;
+    int32_t *out = (int32_t *)&smoothed;
+    int32_t heldX[JOINT_FILTER_VALUES];
+    int32_t heldDx[JOINT_FILTER_VALUES];
+    int untrusted = 0;
+    bool lapsed = false;
+
+    if(!filter.started)
+    {
+        for(int v = 0; v < JOINT_FILTER_VALUES; v++)
+        {
+            filter.x[v] = min(max(in[v], -MAXCOORD), MAXCOORD) << JOINT_FILTER_FRAC_BITS;
+            filter.dx[v] = 0;
+        }
+        // A joint not yet seen with confidence has no position to keep
+        for(int j = 0; j < NUM_SKELETON_JOINTS; j++)
+        {
+            filter.heldUs[j] = confidence[j] < JOINT_MIN_CONFIDENCE ? MS_TO_US(JOINT_FILTER_HOLD_MS) + 1 : 0;
+        }
+        filter.gainUs = -1;
+        filter.started = true;
+    }
+
+    // Frames mostly come at the same interval
+    if(elapsedUs != filter.gainUs)
+    {
+        double sec = elapsedUs / 1e6;
+
+        filter.gainUs = elapsedUs;
+        filter.minGain = lowPassGain(elapsedUs, min_cutoff_tau_us);
+        filter.speedGain = lowPassGain(elapsedUs, speed_cutoff_tau_us);
+        filter.rate = (int32_t)((1000000 << RATE_BITS) / max(elapsedUs, (int64_t)MIN_RATE_INTERVAL_US));
+        filter.betaGain = (int32_t)(2 * M_PI * JOINT_FILTER_BETA * sec * (GAIN_ONE << BETA_BITS) + 0.5);
+        filter.speedLimit = filter.betaGain > 0 ? min((GAIN_ONE << BETA_BITS) / filter.betaGain, JOINT_FILTER_MAX_SPEED)
+                                                : JOINT_FILTER_MAX_SPEED;
+    }
+
+    // Every coordinate is stepped; the few of a joint the SDK is unsure of
+    // are put back afterwards
+    for(int j = 0; j < NUM_SKELETON_JOINTS; j++)
+    {
+        if(confidence[j] < JOINT_MIN_CONFIDENCE)
+        {
+            untrusted++;
+            filter.heldUs[j] += elapsedUs;
+            lapsed |= filter.heldUs[j] > MS_TO_US(JOINT_FILTER_HOLD_MS);
+        }
+        else
+        {
+            filter.heldUs[j] = 0;
+        }
+    }
+    if(untrusted)
+    {
+        copy(filter.x, filter.x + JOINT_FILTER_VALUES, heldX);
+        copy(filter.dx, filter.dx + JOINT_FILTER_VALUES, heldDx);
+    }
+
+    kernel(in, filter, filter.x, filter.dx, out);
+
+    for(int j = 0; untrusted && j < NUM_SKELETON_JOINTS; j++)
+    {
+        if(confidence[j] < JOINT_MIN_CONFIDENCE)
+        {
+            for(int v = j * 3; v < j * 3 + 3; v++)
+            {
+                filter.x[v] = heldX[v];
+                filter.dx[v] = heldDx[v];
+                out[v] = (heldX[v] + (1 << (JOINT_FILTER_FRAC_BITS - 1))) >> JOINT_FILTER_FRAC_BITS;
+            }
+        }
+    }
+
+    return !lapsed;
+}
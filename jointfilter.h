@@ -0,0 +1,69 @@
+#ifndef JOINTFILTER_H
+#define JOINTFILTER_H
+
+#include <cstdint>
+
+#include "gesture.h"
+#include "pipeline.h"
+
+using namespace std;
+
+// Streaming smoothing of a person's joints before they are matched
+//
+// A One-Euro filter per coordinate: a low-pass whose cutoff rises with how
+// fast the coordinate moves, so a held pose is smoothed hard while a wave
+// still comes through with little lag. Held poses near a box edge otherwise
+// flicker in and out of their box on sensor noise alone, and every flicker
+// costs the static gesture time in LOST.
+//
+// All fixed point, the same few operations on every coordinate, so the loop
+// over them vectorizes. The speed is kept per second, so a movement raises
+// the cutoff by as much at any frame rate; only the gains, worked out once
+// per frame interval, depend on it. The speed term is added to the smoothing
+// gain directly instead of through the cutoff, which spares a division per
+// coordinate.
+//
+// A joint the SDK is unsure of keeps its smoothed position, but only for
+// JOINT_FILTER_HOLD_MS. A hand out of sight for longer is not trusted to
+// still be where it was: the skeleton matches no box until it is seen again.
+
+#define JOINT_FILTER_VALUES (NUM_SKELETON_JOINTS * 3)
+
+#define JOINT_FILTER_FRAC_BITS 4            // coordinates are kept in 1/16 units
+#define JOINT_FILTER_GAIN_BITS 10           // gains, 1 << JOINT_FILTER_GAIN_BITS takes the new value as is
+
+#define JOINT_FILTER_MIN_CUTOFF_HZ 1.0      // cutoff for a joint at rest
+#define JOINT_FILTER_SPEED_CUTOFF_HZ 1.0    // cutoff for the speed estimate
+#define JOINT_FILTER_BETA 0.02              // how fast the cutoff rises with speed, Hz per coordinate unit per second
+#define JOINT_FILTER_MAX_SPEED (1 << 19)    // coordinate units per second, far past any arm
+
+// Bridges a dropout of a frame or two, and is well short of
+// STATIC_POSE_DETECTING_TIMEOUT_MS, so a joint out of sight cannot carry a
+// pose to its trigger
+#define JOINT_FILTER_HOLD_MS 100
+
+// State of one person's filter, O(1) per coordinate
+struct joint_filter_t
+{
+    bool started;
+    int32_t x[JOINT_FILTER_VALUES];         // smoothed coordinates
+    int32_t dx[JOINT_FILTER_VALUES];        // smoothed speed, units per second
+    int64_t heldUs[NUM_SKELETON_JOINTS];    // how long each joint has kept its position
+    int64_t gainUs;                         // frame interval the gains are for
+    int32_t minGain;
+    int32_t speedGain;
+    int32_t rate;                           // frames per second, in 1/16
+    int32_t betaGain;                       // gain per unit per second, in 1/256
+    int32_t speedLimit;                     // speed that takes the gain to one
+};
+
+// The next frame starts the filter over at the joints it brings
+void resetJointFilter(joint_filter_t &filter);
+
+// Smooth one frame of joints, elapsedUs after the previous one. A joint less
+// confident than JOINT_MIN_CONFIDENCE keeps its smoothed position. Returns
+// false while one has kept it for longer than JOINT_FILTER_HOLD_MS.
+bool advanceJointFilter(joint_filter_t &filter, const jointCoords_t &joints, const uint8_t *confidence,
+                        int64_t elapsedUs, jointCoords_t &smoothed);
+
+#endif // JOINTFILTER_H
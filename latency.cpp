@@ -0,0 +1,157 @@
+#include "latency.h"
+
+#include <cmath>
+
+LatencyHistogram latency_histograms[NUM_LATENCY_SEGMENTS];
+
+static const char *segment_names[NUM_LATENCY_SEGMENTS] =
+{
+    "tracking",
+    "decision",
+    "command",
+    "player",
+    "end-to-end"
+};
+
+const char *latencySegmentName(latency_segment_e segment)
+{
+    return segment < NUM_LATENCY_SEGMENTS ? segment_names[segment] : "undefined";
+}
+
+static int bucketOf(int64_t us)
+{
+    if(us < (1 << LATENCY_SUB_BITS))
+    {
+        return us < 0 ? 0 : us;
+    }
+
+    int msb = 63 - __builtin_clzll(us);
+    if(msb >= LATENCY_MAX_BITS)
+    {
+        return LATENCY_BUCKETS - 1;
+    }
+
+    int octave = msb - LATENCY_SUB_BITS + 1;
+    int sub = (us >> (msb - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1);
+    return (octave << LATENCY_SUB_BITS) + sub;
+}
+
+static int64_t bucketUpper(int bucket)
+{
+    if(bucket < (1 << LATENCY_SUB_BITS))
+    {
+        return bucket;
+    }
+
+    int octave = bucket >> LATENCY_SUB_BITS;
+    int64_t sub = bucket & ((1 << LATENCY_SUB_BITS) - 1);
+    int64_t lower = ((1 << LATENCY_SUB_BITS) + sub) << (octave - 1);
+    return lower + ((int64_t)1 << (octave - 1)) - 1;
+}
+
+void LatencyHistogram::record(int64_t us)
+{
+    buckets[bucketOf(us)].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+
+    int64_t seen = maxUs.load(memory_order_relaxed);
+    while(us > seen && !maxUs.compare_exchange_weak(seen, us, memory_order_relaxed))
+    {
+    }
+}
+
+int64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t n = count();
+    if(n == 0)
+    {
+        return 0;
+    }
+
+    // As HdrHistogram counts it: the smallest value at least ceil(p * n) values reach
+    uint64_t rank = (uint64_t)ceil(p * n);
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for(int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += buckets[i].load(memory_order_relaxed);
+        if(seen >= rank)
+        {
+            // Never report past the largest value actually seen
+            int64_t upper = bucketUpper(i);
+            return upper < max() ? upper : max();
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::printBuckets(FILE *out) const
+{
+    for(int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        uint64_t n = buckets[i].load(memory_order_relaxed);
+        if(n > 0)
+        {
+            fprintf(out, "%lld %llu\n", (long long)bucketUpper(i), (unsigned long long)n);
+        }
+    }
+}
+
+latency_stamps_t frameLatencyStamps(const tracked_frame_t &frame)
+{
+    latency_stamps_t stamps = {};
+
+    if(frame.tracked.time_since_epoch().count() != 0)
+    {
+        stamps.ns[LATENCY_CAPTURED] = chrono::duration_cast<chrono::nanoseconds>(frame.captured.time_since_epoch()).count();
+        stamps.ns[LATENCY_TRACKED] = chrono::duration_cast<chrono::nanoseconds>(frame.tracked.time_since_epoch()).count();
+    }
+    return stamps;
+}
+
+static void recordSegment(const latency_stamps_t &stamps, latency_segment_e segment, latency_point_e from, latency_point_e to)
+{
+    if(stamps.ns[from] != 0 && stamps.ns[to] != 0)
+    {
+        latency_histograms[segment].record((stamps.ns[to] - stamps.ns[from]) / 1000);
+    }
+}
+
+void recordFrameLatency(const latency_stamps_t &stamps)
+{
+    recordSegment(stamps, LATENCY_TRACKING, LATENCY_CAPTURED, LATENCY_TRACKED);
+    recordSegment(stamps, LATENCY_DECISION, LATENCY_TRACKED, LATENCY_DECIDED);
+}
+
+void recordClipLatency(const latency_stamps_t &stamps)
+{
+    recordSegment(stamps, LATENCY_COMMAND, LATENCY_DECIDED, LATENCY_COMMANDED);
+    recordSegment(stamps, LATENCY_PLAYER, LATENCY_COMMANDED, LATENCY_CONFIRMED);
+    recordSegment(stamps, LATENCY_END_TO_END, LATENCY_CAPTURED, LATENCY_CONFIRMED);
+}
+
+void printLatencyReport(FILE *out, bool buckets)
+{
+    fprintf(out, "%-12s %10s %10s %10s %10s %10s\n", "latency", "count", "p50 ms", "p95 ms", "p99 ms", "max ms");
+    for(int s = 0; s < NUM_LATENCY_SEGMENTS; s++)
+    {
+        const LatencyHistogram &h = latency_histograms[s];
+        fprintf(out, "%-12s %10llu %10.2f %10.2f %10.2f %10.2f\n", segment_names[s], (unsigned long long)h.count(),
+                h.percentile(0.50) / 1000.0, h.percentile(0.95) / 1000.0, h.percentile(0.99) / 1000.0, h.max() / 1000.0);
+    }
+
+    if(!buckets)
+    {
+        return;
+    }
+
+    for(int s = 0; s < NUM_LATENCY_SEGMENTS; s++)
+    {
+        fprintf(out, "\n%s buckets, upper bound us and count:\n", segment_names[s]);
+        latency_histograms[s].printBuckets(out);
+    }
+}
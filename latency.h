@@ -0,0 +1,95 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "pipeline.h"
+
+using namespace std;
+
+#define LATENCY_FILE "/home/capstone38/Desktop/electricTree/latency.txt"
+
+// Gesture-to-photon latency
+//
+// Each frame carries steady clock stamps as it moves through the program:
+// capture, tracking done, decision made. A frame that starts a clip keeps
+// its stamps through playContent and the playback engine, which adds the
+// play command and the player confirming the clip is on screen. Every gap
+// between two stamps goes into a histogram of its own.
+
+enum latency_point_e
+{
+    LATENCY_CAPTURED=0,
+    LATENCY_TRACKED,
+    LATENCY_DECIDED,
+    LATENCY_COMMANDED,          // playContent handed the clip to the player
+    LATENCY_CONFIRMED,          // the player reported the clip started
+    NUM_LATENCY_POINTS
+};
+
+// Nanoseconds on the steady clock, 0 for a point not reached or not known
+struct latency_stamps_t
+{
+    int64_t ns[NUM_LATENCY_POINTS];
+};
+
+enum latency_segment_e
+{
+    LATENCY_TRACKING=0,         // captured to tracked, every frame
+    LATENCY_DECISION,           // tracked to decided, every frame
+    LATENCY_COMMAND,            // gesture decided to play command
+    LATENCY_PLAYER,             // play command to clip on screen
+    LATENCY_END_TO_END,         // capture of the deciding frame to clip on screen
+    NUM_LATENCY_SEGMENTS
+};
+
+// Log-linear buckets in microseconds, as in HdrHistogram: values below
+// 2^LATENCY_SUB_BITS get a bucket each, every octave above is split into
+// 2^LATENCY_SUB_BITS buckets, so any value is within ~3% of its bucket.
+#define LATENCY_SUB_BITS 5
+#define LATENCY_MAX_BITS 36     // about 19 hours; longer lands in the last bucket
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+// Lock-free: any thread may record while another reads
+class LatencyHistogram
+{
+private:
+    atomic<uint64_t> buckets[LATENCY_BUCKETS];
+    atomic<uint64_t> total;
+    atomic<int64_t> maxUs;
+
+public:
+    void record(int64_t us);
+
+    uint64_t count(void) const { return total.load(memory_order_relaxed); }
+    int64_t max(void) const { return maxUs.load(memory_order_relaxed); }
+    // Highest value in the bucket holding the p-th fraction of the values
+    int64_t percentile(double p) const;
+    // One "upper_us count" line per bucket in use
+    void printBuckets(FILE *out) const;
+};
+
+extern LatencyHistogram latency_histograms[NUM_LATENCY_SEGMENTS];
+
+// A replay run faster than real time has no tracking stamp, and then its
+// capture stamp is not on the steady clock either
+latency_stamps_t frameLatencyStamps(const tracked_frame_t &frame);
+
+inline int64_t latencyNow(void)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The per-frame segments, and those of a clip once it is on screen
+void recordFrameLatency(const latency_stamps_t &stamps);
+void recordClipLatency(const latency_stamps_t &stamps);
+
+const char *latencySegmentName(latency_segment_e segment);
+
+// Summary table, then the buckets of each histogram
+void printLatencyReport(FILE *out, bool buckets);
+
+#endif // LATENCY_H
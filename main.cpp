@@ -2,15 +2,14 @@
 // Copyright(c) 2017 Intel Corporation. All Rights Reserved.
 
 // C++ std libraries
+#include <algorithm>
 #include <iostream>
 #include <signal.h>
 #include <thread>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 
-// Boost Libraries-
-#include <boost/interprocess/ipc/message_queue.hpp>
-
 // Realsense libraries
 #include <librealsense/rs.hpp>
 #include "rs_sdk.h"
@@ -19,16 +18,58 @@
 #include "pt_console_display.hpp"
 
 #include "main.h"
+#include "latency.h"
+#include "catalog.h"
+#include "control.h"
+#include "pipeline.h"
+#include "prefetch.h"
+#include "presence.h"
+#include "recording.h"
+#include "statemachine.h"
+#include "timeline.h"
+#include "trace.h"
+#include "videoplayer.h"
 
 using namespace std;
-using namespace boost::interprocess;
 
 // Version number of the samples
 extern constexpr auto rs_sample_version = concat("VERSION: ",RS_SAMPLE_VERSION_STR);
 
-int numVideos[GESTURE_UNDEFINED];
 
-struct analytics_t analytics_counts = analytics_init();
+// Camera frame on its way from the capture stage to the tracking stage
+struct captured_frame_t
+{
+    uint64_t frame_id;
+    chrono::steady_clock::time_point captured;
+    rs::core::correlated_sample_set sampleSet;
+};
+
+static TripleBuffer<captured_frame_t> capturedFrames;
+static TripleBuffer<tracked_frame_t> trackedFrames;
+static stage_stats_t captureStats;
+static stage_stats_t trackingStats;
+static stage_stats_t decisionStats;
+static atomic<bool> pipelineRunning(true);
+static atomic<bool> timelineRequested(false);
+// Set by the decision stage: the idle video plays, so the tracking stage may
+// stop tracking once nobody is near
+static atomic<bool> idleVideoPlaying(false);
+static PresenceDetector presence;
+
+bool personIsInCenter(Intel::RealSense::PersonTracking::PersonTrackingData::PointCombined centerMass);
+bool extractJointCoords(Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints *personJoints,
+                        Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint *jointBuffer,
+                        jointCoords_t &jointCoords, uint8_t *confidence);
+void printPipelineStats(void);
+
+// kill -USR1 prints the analytics timeline without stopping anything
+static void requestTimeline(int)
+{
+    timelineRequested = true;
+}
+
+static void captureStage(pt_utils *utils);
+static void trackingStage(rs::person_tracking::person_tracking_video_module_interface *ptModule, console_display::pt_console_display *console_view);
 
 int main(int argc, char** argv)
 {
@@ -37,7 +78,6 @@ int main(int argc, char** argv)
 
     rs::core::video_module_interface::actual_module_config actualModuleConfig;
     rs::person_tracking::person_tracking_video_module_interface* ptModule = nullptr;
-    Intel::RealSense::PersonTracking::PersonTrackingData::Person *personData = nullptr;
 
     // Auto-Exposure Setup
     rs_context *ctx = rs_create_context(RS_API_VERSION, 0);
@@ -65,13 +105,39 @@ int main(int argc, char** argv)
     rs_reset_device_options_to_default(camera, options, 11, 0);
 
 
-    vector<Gesture> staticgesturelist = defineStaticGestures();
-    vector<DynamicGesture> dynamicgesturelist = defineDynamicGestures();
-
-    updateNumVideos(numVideos);
-
+    // Command line options
+    bool useStub = false;
+    string recordPath;
+    string tracePath(TRACE_FILE);
+    for(int i = 1; i < argc; i++)
+    {
+        string arg(argv[i]);
 
+        if(arg == "--stub-player")
+        {
+            // Log player commands instead of showing video
+            useStub = true;
+        }
+        else if(arg == "--record" && i + 1 < argc)
+        {
+            // Record the tracked skeleton stream for etreplay
+            recordPath = argv[++i];
+        }
+        else if(arg == "--trace" && i + 1 < argc)
+        {
+            // Gesture and program state transitions, decoded with ettrace
+            tracePath = argv[++i];
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--stub-player] [--record <file>] [--trace <file>]" << endl;
+            return -1;
+        }
+    }
 
+    // Indexed once here, then kept current as the download scripts add clips
+    ContentCatalog contentCatalog(CONTENT_DIR);
+    catalog = &contentCatalog;
 
     // Initializing Camera and Person Tracking modules
     if(pt_utils.init_camera(actualModuleConfig) != rs::core::status_no_error)
@@ -98,263 +164,201 @@ int main(int argc, char** argv)
     // Start the camera
     pt_utils.start_camera();
 
-    Intel::RealSense::PersonTracking::PersonTrackingData *trackingData = ptModule->QueryOutput();
-    Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints *personJoints = nullptr;
+    // Commands from the cancel tool come in, live status goes out
+    ControlServer control;
+    control.open();
 
-    // Init interprocess message queue
-    message_queue::remove("etree_message_queue");
-    message_queue mq
-            (create_only,
-             "etree_message_queue",
-             1,
-             sizeof(bool));
-    unsigned int priority;
-    message_queue::size_type recvd_size;
+    // Counts are flushed into the analytics store as clips play
+    AnalyticsFlusher analytics;
+    if(ENABLE_ANALYTICS)
+    {
+        analytics.open(ANALYTICS_LOG_FILE, ANALYTICS_STORE_FILE, ANALYTICS_FILE);
+    }
 
-    // Init RNG
-    srand(time(nullptr));
+    // Warms the page cache for the clips the FSM is likely to ask for next.
+    // It reads the analytics store, which the flusher creates on a fresh install.
+    ClipPrefetcher clipPrefetcher(&contentCatalog, ENABLE_ANALYTICS ? ANALYTICS_STORE_FILE : "");
+    prefetcher = &clipPrefetcher;
 
-    state_e state = STATE_IDLE;
-    int cyclesSpentIdle = 0;
-    int numTracked;
-    gestures_e gestureDetected = GESTURE_UNDEFINED;
-    int cyclesSpentDetected = 0;
+    // Start the playback engine
+    VlcSink vlcSink;
+    StubSink stubSink(cout);
+    VideoPlayer videoPlayer(useStub ? (PlayerSink *)&stubSink : (PlayerSink *)&vlcSink);
+    player = &videoPlayer;
+    player->setFirstFrameObserver(&clipPrefetcher);
 
-    int pid_in_center = INVALID_PERSONID;
-    int pid_in_center_prev;
+    SkeletonRecorder recorder;
+    if(!recordPath.empty() && !recorder.open(recordPath))
+    {
+        cerr << "Error: Could not open " << recordPath << " for recording" << endl;
+    }
+
+    TraceWriter trace;
+    trace.open(tracePath);
+
+    signal(SIGUSR1, requestTimeline);
+
+    // Gesture thresholds come from GESTURES_FILE and are reloaded when it changes
+    GestureEngine gestureEngine(loadGestureTableOrBuiltin(GESTURES_FILE));
+    GestureFileWatcher gestureWatcher(GESTURES_FILE, &gestureEngine);
+    StateMachine stateMachine(&gestureEngine);
 
-    bool shouldCancel = false;
+    chrono::steady_clock::time_point lastStats = chrono::steady_clock::now();
 
+    control_status_t status;
+    memset(&status, 0, sizeof(status));
+    status.lastGesture = GESTURE_UNDEFINED;
+    bool paused = false;
+    bool shouldQuit = false;
+    uint64_t fpsFrames = 0;
+    chrono::steady_clock::time_point fpsSince = chrono::steady_clock::now();
 
+    // Capture and tracking run on their own threads; this one makes the decisions
+    thread captureThread(captureStage, &pt_utils);
+    thread trackingThread(trackingStage, ptModule, console_view.get());
 
     // Start main loop
     while(!pt_utils.user_request_exit())
     {
-        // Check for cancel request from system
-        bool shouldQuit = false;
-        mq.try_receive(&shouldQuit, sizeof(shouldQuit), recvd_size, priority);
+        // Tells the supervisor this loop, and each stage feeding it, still moves
+        control.heartbeat(captureStats.processed, trackingStats.processed, decisionStats.processed);
+
+        // Commands from the cancel tool
+        for(control_cmd_e cmd = control.poll(); cmd != CONTROL_CMD_NONE; cmd = control.poll())
+        {
+            switch(cmd)
+            {
+            case CONTROL_CMD_RELOAD_GESTURES:
+                gestureWatcher.requestReload();
+                break;
+            case CONTROL_CMD_RELOAD_CONTENT:
+                contentCatalog.requestRescan();
+                break;
+            case CONTROL_CMD_FLUSH_ANALYTICS:
+                analytics.requestFlush();
+                break;
+            case CONTROL_CMD_PAUSE:
+                // Frames keep flowing but nothing reacts to them
+                if(!paused)
+                {
+                    player->stop();
+                    paused = true;
+                }
+                break;
+            case CONTROL_CMD_RESUME:
+                paused = false;
+                break;
+            case CONTROL_CMD_QUIT:
+                shouldQuit = true;
+                break;
+            default:
+                break;
+            }
+        }
         if(shouldQuit) {
-            updateAnalytics(analytics_counts);
             break;
         }
 
-        rs::core::correlated_sample_set sampleSet = {};
-
-        // Get next frame
-        if (pt_utils.GetNextFrame(sampleSet) != 0)
+        if(chrono::steady_clock::now() - lastStats >= chrono::seconds(PIPELINE_STATS_PERIOD_SEC))
         {
-            cerr << "Error: Invalid frame" << endl;
-            continue;
+            printPipelineStats();
+            lastStats = chrono::steady_clock::now();
         }
 
-        // Process frame
-        if (ptModule->process_sample_set(sampleSet) != rs::core::status_no_error)
+        if(timelineRequested.exchange(false, memory_order_relaxed))
         {
-            cerr << "Error : Failed to process sample" << endl;
-            continue;
+            cout << "Timeline, last hour by minute:" << endl;
+            analytics_timeline.print(cout, TIMELINE_SCALE_MINUTE, 60);
+            cout << "Timeline, last day by hour:" << endl;
+            analytics_timeline.print(cout, TIMELINE_SCALE_HOUR, 24);
+            clipPrefetcher.print(stdout);
+            printLatencyReport(stdout, false);
+            gestureEngine.printMatchCache(stdout);
         }
 
-        // USE FOR DEBUG:
-        // Display color image
-        //        auto colorImage = sampleSet[rs::core::stream_type::color];
-        //        console_view->render_color_frames(colorImage);
-
-        //        // Release color and depth image
-        //        sampleSet.images[static_cast<uint8_t>(rs::core::stream_type::color)]->release();
-        //        sampleSet.images[static_cast<uint8_t>(rs::core::stream_type::depth)]->release();
-
-
-        trackingData = ptModule->QueryOutput();
-
-        auto ids_in_frame = console_view->get_person_ids(ptModule->QueryOutput());
-
-        pid_in_center_prev = pid_in_center;
-
-        for(auto iter = ids_in_frame->begin(); iter != ids_in_frame->end(); ++iter){
-            int id = *iter;
-
-            personData = trackingData->QueryPersonDataById(id);
-
-            if(personData){
-                Intel::RealSense::PersonTracking::PersonTrackingData::PersonTracking* personTrackData = personData->QueryTracking();
-                Intel::RealSense::PersonTracking::PersonTrackingData::PointCombined centerMass = personTrackData->QueryCenterMass();
-
-
-                if(personIsInCenter(centerMass))
-                {
-                    // If person in center, say which id
-                    pid_in_center = id;
-                    break;
-                }
-                else
-                {
-                    // If no one in center, indicate so.
-                    pid_in_center = INVALID_PERSONID;
-                }
-            }
-            else
-            {
-                // If we no longer see a person, back to idle state
-                pid_in_center = INVALID_PERSONID;
-            }
+        // Wait for the newest tracked frame; older ones are stale by now.
+        // It is read where the tracking stage wrote it, which leaves it
+        // alone until the next one is taken.
+        const tracked_frame_t *frame = trackedFrames.peekLatest();
+        if(!frame)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
         }
+        decisionStats.processed++;
 
-        if(pid_in_center != pid_in_center_prev)
+        if(recorder.isOpen())
         {
-            trackingData->StopTracking(pid_in_center_prev);
-
-            if(pid_in_center != INVALID_PERSONID)
-            {
-                trackingData->StartTracking(pid_in_center);
-            }
+            recorder.write(*frame);
         }
 
-
-        //Main program FSM implementation
-        switch (state)
+        // Main program FSM implementation
+        if(!paused)
         {
-        case STATE_IDLE:
-            numTracked = trackingData->QueryNumberOfPeople();
-
-            if(pid_in_center != INVALID_PERSONID)
-            {
-                // If we are tracking exactly one person, detect their gesture
-                {
-                    thread video(playContent, GESTURE_READY, shouldQuit);
-                    video.detach();
-                }
-
-                state = STATE_READY;
-            }
-            else if(cyclesSpentIdle >= SEC_TO_CYCLES(0))
+            stateMachine.step(*frame);
+            if(stateMachine.getState() == STATE_PLAYBACK_START)
             {
-                // We have idled for 10 seconds. Begin playback of idle video
-                state = STATE_IDLEVIDEO_START;
-
-                cyclesSpentDetected = 0;
+                status.lastGesture = stateMachine.getGestureDetected();
             }
-
-            cyclesSpentIdle++;
-            break;
-
-        case STATE_READY:
-            // Track skeleton joints of person in centre,
-            // or go back to idle if person has left centre
-
-            if(currentVideoType() == GESTURE_UNDEFINED)
-            {
-                {
-                    thread video(playContent, GESTURE_READY, shouldQuit);
-                    video.detach();
-                }
-            }
-
-
-
-            if(pid_in_center != INVALID_PERSONID)
-            {
-                personJoints = personData->QuerySkeletonJoints();
-                std::vector<Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint> skeletonPoints(personJoints->QueryNumJoints());
-                personJoints->QueryJoints(skeletonPoints.data());
-
-                gestureDetected = detectGestures(personJoints, staticgesturelist, dynamicgesturelist);
-
-                if(gestureDetected != GESTURE_UNDEFINED && gestureDetected != GESTURE_CANCEL)
-                {
-
-                    state = STATE_PLAYBACK_START;
-                }
-            }
-            else
-            {
-                state = STATE_IDLE;
-                cyclesSpentIdle = 0;
-            }
-            break;
-
-        case STATE_PLAYBACK_START:
-            // Issue system call to playback video content in a detached thread
-
-        {
-            thread video(playContent, gestureDetected, shouldQuit);
-            video.detach();
         }
-            shouldCancel = false;
-
-            state = STATE_PLAYBACK_UNDERWAY;
-            break;
-
-        case STATE_PLAYBACK_UNDERWAY:
-            // If we are still detecting a person, listen for cancel gesture
-
-            if(pid_in_center != INVALID_PERSONID)
-            {
-                personJoints = personData->QuerySkeletonJoints();
-                std::vector<Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint> skeletonPoints(personJoints->QueryNumJoints());
-                personJoints->QueryJoints(skeletonPoints.data());
-
-                gestureDetected = detectGestures(personJoints, staticgesturelist, dynamicgesturelist);
+        idleVideoPlaying.store(!paused && stateMachine.getState() == STATE_IDLEVIDEO_UNDERWAY, memory_order_relaxed);
 
-                // Implement cancel gesture.
-                if(gestureDetected == GESTURE_CANCEL)
-                {
-                    shouldCancel = true;
-                }
-            }
-
-
-            if(currentVideoType() == GESTURE_UNDEFINED || shouldCancel)
-            {
-                state = STATE_READY;
-
-                {
-                    thread video(playContent, GESTURE_READY, shouldQuit);
-                    video.detach();
-                }
-            }
-            break;
+        latency_stamps_t stamps = frameLatencyStamps(*frame);
+        stamps.ns[LATENCY_DECIDED] = latencyNow();
+        recordFrameLatency(stamps);
 
+        status.pidInCenter = frame->pidInCenter;
 
-        case STATE_IDLEVIDEO_START:
-            // Issue system call to playback idle video content in a detached thread
+        // Live status for the cancel tool; readers never hold this loop up
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        fpsFrames++;
+        if(now - fpsSince >= chrono::seconds(1))
         {
-            thread idlevideo(playContent, GESTURE_IDLE, shouldQuit);
-            idlevideo.detach();
-        }
-
-            cyclesSpentDetected = 0;
+            status.fps = fpsFrames / chrono::duration<float>(now - fpsSince).count();
+            fpsFrames = 0;
+            fpsSince = now;
 
-            state = STATE_IDLEVIDEO_UNDERWAY;
-            break;
-
-        case STATE_IDLEVIDEO_UNDERWAY:
-            if(pid_in_center != INVALID_PERSONID)
+            for(int s = 0; s < NUM_LATENCY_SEGMENTS; s++)
             {
-                if(cyclesSpentDetected >= SEC_TO_CYCLES(0.5)) {
-
-                    state = STATE_IDLE;
-                    cyclesSpentIdle = 0;
-                    break;
-                } else {
-                    cyclesSpentDetected++;
-                }
+                const LatencyHistogram &h = latency_histograms[s];
+                status.latency[s].count = h.count();
+                status.latency[s].p50_us = h.percentile(0.50);
+                status.latency[s].p95_us = h.percentile(0.95);
+                status.latency[s].p99_us = h.percentile(0.99);
+                status.latency[s].max_us = h.max();
             }
-            else
-            {
-                cyclesSpentDetected = 0;
-            }
-
-            if(currentVideoType() == GESTURE_UNDEFINED)
-            {
-                state = STATE_IDLEVIDEO_START;
-            }
-
-            break;
         }
+        status.frames = decisionStats.processed;
+        status.updated_ns = chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
+        status.state = stateMachine.getState();
+        status.paused = paused;
+        status.capturedDepth = capturedFrames.depth();
+        status.trackedDepth = trackedFrames.depth();
+        status.capturedDrops = capturedFrames.drops();
+        status.trackedDrops = trackedFrames.drops();
+        control.publish(status);
+    }
 
+    player->stop();
+    analytics.close();
+    prefetcher = nullptr;
+    clipPrefetcher.print(stdout);
+    gestureEngine.printMatchCache(stdout);
+
+    if(FILE *latencyFile = fopen(LATENCY_FILE, "w"))
+    {
+        printLatencyReport(latencyFile, true);
+        fclose(latencyFile);
+    }
+    else
+    {
+        perror("Error writing the latency report");
     }
 
-    system("killall vlc");
+    pipelineRunning = false;
+    trackingThread.join();
+    captureThread.join();
+    printPipelineStats();
 
     pt_utils.stop_camera();
     actualModuleConfig.projection->release();
@@ -375,363 +379,295 @@ bool personIsInCenter(Intel::RealSense::PersonTracking::PersonTrackingData::Poin
     return false;
 }
 
-gestures_e detectGestures(Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints *personJoints, vector<Gesture>& staticgesturelist, vector<DynamicGesture>& dynamicgesturelist)
+// The raw z16 depth image of a sample set, nullptr if it has none
+static const uint16_t *depthImage(rs::core::correlated_sample_set &sampleSet, int *width, int *height, int *pitch)
 {
-    int numDetectedJoints = personJoints->QueryNumJoints();
-    std::vector<Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint> skeletonPoints(personJoints->QueryNumJoints());
-
-    personJoints->QueryJoints(skeletonPoints.data());
-
-    jointCoords_t jointCoords;
-
-    // Populate joint coordinates values
-    jointCoords.Lhandx = skeletonPoints.at(0).image.x;
-    jointCoords.Lhandy = skeletonPoints.at(0).image.y;
-    jointCoords.Lhandz = skeletonPoints.at(0).world.z;
-    jointCoords.Rhandx = skeletonPoints.at(1).image.x;
-    jointCoords.Rhandy = skeletonPoints.at(1).image.y;
-    jointCoords.Rhandz = skeletonPoints.at(1).world.z;
-
-    jointCoords.Lshoulderx = skeletonPoints.at(4).image.x;
-    jointCoords.Lshouldery = skeletonPoints.at(4).image.y;
-    jointCoords.Lshoulderz = skeletonPoints.at(4).world.z;
-    jointCoords.Rshoulderx = skeletonPoints.at(5).image.x;
-    jointCoords.Rshouldery = skeletonPoints.at(5).image.y;
-    jointCoords.Rshoulderz = skeletonPoints.at(5).world.z;
-
-    jointCoords.headx = skeletonPoints.at(2).image.x;
-    jointCoords.heady = skeletonPoints.at(2).image.y;
-    jointCoords.headz = skeletonPoints.at(2).world.z;
-    jointCoords.Spinex = skeletonPoints.at(3).image.x;
-    jointCoords.Spiney = skeletonPoints.at(3).image.y;
-    jointCoords.Spinez = skeletonPoints.at(3).world.z;
-
-    gestures_e detectedGesture = GESTURE_UNDEFINED;
-
-    for(Gesture &g : staticgesturelist)
+    rs::core::image_interface *image = sampleSet[rs::core::stream_type::depth];
+    if(!image)
     {
-        if(g.detect(jointCoords))
-        {
-            detectedGesture = g.id;
-        }
+        return nullptr;
     }
 
-    for(DynamicGesture &g : dynamicgesturelist)
+    rs::core::image_info info = image->query_info();
+    if(info.format != rs::core::pixel_format::z16)
     {
-        if(g.detect(jointCoords))
-        {
-            detectedGesture = g.id;
-        }
+        return nullptr;
     }
 
-    if(detectedGesture != GESTURE_UNDEFINED)
-    {
-        for(Gesture &g : staticgesturelist)
-        {
-            g.resetGestureState();
-        }
-
-        for(DynamicGesture &g : dynamicgesturelist)
-        {
-            g.resetStates();
-        }
-    }
-
-    // use for debug:
-    //printJointCoords(jointCoords);
-
-    return detectedGesture;
+    *width = info.width;
+    *height = info.height;
+    *pitch = info.pitch;
+    return (const uint16_t *)image->query_data();
 }
 
-void printJointCoords(jointCoords_t& jc)
+static void captureStage(pt_utils *utils)
 {
-    // 6: LH, 7: RH, 10: H, 19: S, 16: LS, 17: RS
-    cout << "LH: " << jc.Lhandx << ", " << jc.Lhandy
-         << ", " << jc.Lhandz
-         << "|RH: " << jc.Rhandx << ", " << jc.Rhandy
-         << ", " << jc.Rhandz
-         << "|LS: " << jc.Lshoulderx << ", " << jc.Lshouldery
-         << ", " << jc.Lshoulderz
-         << "|RS: " << jc.Rshoulderx << ", " << jc.Rshouldery
-         << ", " << jc.Rshoulderz
-         << endl;
-}
-
-void playContent(gestures_e gesture, bool quit)
-{
-    int rand_idx;
-
-    // uncomment this one to get fullscreen:
-    string vlc_cmd ("cvlc -f --one-instance --no-video-title-show file:///");
+    uint64_t frame_id = 0;
 
-    string base_path ("/home/capstone38/Desktop/electricTree/videos/");
-
-    string default_video(DEFAULT_VIDEO);
+    while(pipelineRunning)
+    {
+        captured_frame_t captured;
+        captured.sampleSet = {};
 
-    string title;
-    string idx (to_string(rand_idx));
-    string ext (".mp4");
-    string ext2 (".mov");
+        // Get next frame
+        if (utils->GetNextFrame(captured.sampleSet) != 0)
+        {
+            cerr << "Error: Invalid frame" << endl;
+            captureStats.errors++;
+            continue;
+        }
 
-    string full_cmd;
-    string full_cmd2;
+        captured.frame_id = frame_id++;
+        captured.captured = chrono::steady_clock::now();
+        captureStats.processed++;
 
-    if(numVideos[gesture] != 0)
-    {
-        rand_idx = rand() % (numVideos[gesture]);
-    }
-    else
-    {
-        rand_idx = 0;
+        capturedFrames.push(captured);
     }
+}
 
+static void trackingStage(rs::person_tracking::person_tracking_video_module_interface *ptModule, console_display::pt_console_display *console_view)
+{
+    Intel::RealSense::PersonTracking::PersonTrackingData *trackingData = nullptr;
+    Intel::RealSense::PersonTracking::PersonTrackingData::Person *personData = nullptr;
 
-    switch (gesture)
-    {
-    case GESTURE_VICTORY:
-        title.assign("victory");
-        analytics_counts.victory_count++;
-        break;
-    case GESTURE_USAIN:
-        title.assign("bolt");
-        analytics_counts.usain_count++;
-        break;
-    case GESTURE_T:
-        title.assign("tpose");
-        analytics_counts.t_count++;
-        break;
-    case GESTURE_FLEXING:
-        title.assign("flexing");
-        analytics_counts.powerpose_count++;
-        break;
-    case GESTURE_STOP:
-        title.assign("stop");
-        analytics_counts.stop_count++;
-        break;
-    case GESTURE_POINTING_TRF:
-        title.assign("toprightforward");
-        analytics_counts.pointing_trf_count++;
-        break;
-    case GESTURE_POINTING_RF:
-        title.assign("rightforward");
-        analytics_counts.pointing_rf_count++;
-        break;
-    case GESTURE_POINTING_TLF:
-        title.assign("topleftforward");
-        analytics_counts.pointing_tlf_count++;
-        break;
-    case GESTURE_POINTING_LF:
-        title.assign("leftforward");
-        analytics_counts.pointing_lf_count++;
-        break;
-    case GESTURE_POINTING_TR:
-        title.assign("topright");
-        analytics_counts.pointing_tr_count++;
-        break;
-    case GESTURE_POINTING_R:
-        title.assign("right");
-        analytics_counts.pointing_r_count++;
-        break;
-    case GESTURE_POINTING_TL:
-        title.assign("topleft");
-        analytics_counts.pointing_tl_count++;
-        break;
-    case GESTURE_POINTING_L:
-        title.assign("left");
-        analytics_counts.pointing_l_count++;
-        break;
-    case GESTURE_FLYING:
-        title.assign("fly");
-        analytics_counts.flying_count++;
-        break;
-    case GESTURE_WAVING_L:
-        title.assign("leftwave");
-        analytics_counts.waving_l_count++;
-        break;
-
-    case GESTURE_IDLE:
-        title.assign("idle");
-        break;
-    case GESTURE_READY:
-        title.assign("ready");
-        break;
-    default:
-        title.assign("test");
-        full_cmd.assign(base_path + title + ext2);
-        break;
+    // Reused every frame, so reading the skeleton never allocates
+    Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint jointBuffer[MAX_SKELETON_POINTS];
 
-    }
+    int pid_in_center = INVALID_PERSONID;
+    // Everyone in the centre zone has skeleton tracking on, pid_in_center first
+    int tracked_pids[MAX_GESTURE_PEOPLE];
+    int num_tracked = 0;
+    int people_seen = 0;
 
-    // process strings to escape brackets properly
-    idx.assign(to_string(rand_idx));
-    if(rand_idx > 0)
+    while(pipelineRunning)
     {
-        ext.assign("\).mp4");
-        full_cmd.assign(base_path + title + "\(" + idx + ext);
-        full_cmd2.assign(base_path + title + "\\(" + idx + "\\" + ext);
-    }
-    else
-    {
-        ext.assign(".mp4");
-        full_cmd.assign(base_path + title + ext);
-        full_cmd2.assign(full_cmd);
-    }
+        captured_frame_t captured;
 
+        if(!capturedFrames.popLatest(captured))
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
 
-    bool good = false;
-    if(FILE *file = fopen(full_cmd.c_str(), "r"))
-    {
-        fclose(file);
-        good = true;
-    }
-
-    string valid_video_cmd(vlc_cmd+full_cmd2);
-    string default_video_cmd(vlc_cmd+default_video);
+        // Nobody near the idle video: the frame goes on empty, and person
+        // tracking, skeletons and gestures all rest
+        int depthWidth = 0;
+        int depthHeight = 0;
+        int depthPitch = 0;
+        const uint16_t *depth = depthImage(captured.sampleSet, &depthWidth, &depthHeight, &depthPitch);
+        bool wasAsleep = presence.isAsleep();
 
-    if(!quit) {
-        if(good)
+        if(!presence.step(depth, depthWidth, depthHeight, depthPitch,
+                          idleVideoPlaying.load(memory_order_relaxed) && people_seen == 0))
         {
-            system(valid_video_cmd.c_str());
+            if(!wasAsleep)
+            {
+                for(int i = 0; trackingData && i < num_tracked; i++)
+                {
+                    trackingData->StopTracking(tracked_pids[i]);
+                }
+                num_tracked = 0;
+                pid_in_center = INVALID_PERSONID;
+            }
+
+            tracked_frame_t *slot = trackedFrames.claim();
+            slot->frame_id = captured.frame_id;
+            slot->captured = captured.captured;
+            slot->numPeople = 0;
+            slot->numSampled = 0;
+            slot->pidInCenter = INVALID_PERSONID;
+            slot->numSkeletons = 0;
+            slot->tracked = chrono::steady_clock::now();
+            trackedFrames.publish();
+            trackingStats.processed++;
+            continue;
         }
-        else
+
+        // Process frame
+        if (ptModule->process_sample_set(captured.sampleSet) != rs::core::status_no_error)
         {
-            system(default_video_cmd.c_str());
+            cerr << "Error : Failed to process sample" << endl;
+            trackingStats.errors++;
+            continue;
         }
-    }
 
-}
+        // USE FOR DEBUG:
+        // Display color image
+        //        auto colorImage = captured.sampleSet[rs::core::stream_type::color];
+        //        console_view->render_color_frames(colorImage);
 
-gestures_e currentVideoType()
-{
-    char buf[20];
+        //        // Release color and depth image
+        //        captured.sampleSet.images[static_cast<uint8_t>(rs::core::stream_type::color)]->release();
+        //        captured.sampleSet.images[static_cast<uint8_t>(rs::core::stream_type::depth)]->release();
 
-    do
-    {
-        FILE *pPipe;
-        pPipe = popen("lsof -wc vlc | awk '$4~\"[0-9]r\" && $5==\"REG\"' | grep -o '[^/]*$'", "r");
 
+        trackingData = ptModule->QueryOutput();
 
-        if(fgets(buf, 20, pPipe) != NULL)
-        {
-            puts(buf);
-        }
+        // Build the frame straight in its slot of the tracked frame buffer
+        tracked_frame_t &frame = *trackedFrames.claim();
 
-        pclose(pPipe);
-    }
-    while(strstr(buf, "maps") != NULL);
+        auto ids_in_frame = console_view->get_person_ids(trackingData);
 
-    if(strstr(buf, "ready") != NULL)
-    {
-        return GESTURE_READY;
-    }
-    else if(strstr(buf, "idle") != NULL)
-    {
-        return GESTURE_IDLE;
-    }
-    else if(strstr(buf, "mov") != NULL || strstr(buf, "mp4") != NULL)
-    {
-        return GESTURE_USAIN;
-    }
-    else
-    {
-        return GESTURE_UNDEFINED;
-    }
-}
+        int in_center[MAX_GESTURE_PEOPLE];
+        int num_in_center = 0;
+        frame.numSampled = 0;
 
+        for(auto iter = ids_in_frame->begin(); iter != ids_in_frame->end(); ++iter){
+            int id = *iter;
 
+            personData = trackingData->QueryPersonDataById(id);
 
-int detectNumVideo(string name)
-{
-    string base_path("/home/capstone38/Desktop/electricTree/videos/");
-    string title;
-    string ext;
-    string full_cmd;
-
-    int idx = 0;
-    bool good = false;
-    do
-    {
-        string id(to_string(idx));
+            if(personData){
+                Intel::RealSense::PersonTracking::PersonTrackingData::PersonTracking* personTrackData = personData->QueryTracking();
+                Intel::RealSense::PersonTracking::PersonTrackingData::PointCombined centerMass = personTrackData->QueryCenterMass();
 
-        if(idx > 0)
-        {
-            title.assign(name + "\(");
-            ext.assign("\).mp4");
-            full_cmd.assign(base_path + title + id + ext);
-        }
-        else
-        {
-            title.assign(name);
-            ext.assign(".mp4");
-            full_cmd.assign(base_path + title + ext);
+                // Keep everyone's centre of mass, not just the person we pick
+                if(frame.numSampled < MAX_TRACKED_PEOPLE)
+                {
+                    person_sample_t &sample = frame.people[frame.numSampled++];
+                    sample.pid = id;
+                    sample.comX = centerMass.world.point.x;
+                    sample.comY = centerMass.world.point.y;
+                    sample.comZ = centerMass.world.point.z;
+                }
+
+                if(num_in_center < MAX_GESTURE_PEOPLE && personIsInCenter(centerMass))
+                {
+                    // If person in center, say which id
+                    in_center[num_in_center++] = id;
+                }
+            }
         }
 
+        if(!ids_in_frame->empty())
+        {
+            // If no one in center, or we no longer see them, indicate so.
+            for(int i = 0; i < num_tracked; i++)
+            {
+                if(find(in_center, in_center + num_in_center, tracked_pids[i]) == in_center + num_in_center)
+                {
+                    trackingData->StopTracking(tracked_pids[i]);
+                }
+            }
 
+            for(int i = 0; i < num_in_center; i++)
+            {
+                if(find(tracked_pids, tracked_pids + num_tracked, in_center[i]) == tracked_pids + num_tracked)
+                {
+                    trackingData->StartTracking(in_center[i]);
+                }
+            }
 
-        if(FILE *file = fopen(full_cmd.c_str(), "r"))
-        {
-            fclose(file);
-            good = true;
+            copy(in_center, in_center + num_in_center, tracked_pids);
+            num_tracked = num_in_center;
+            pid_in_center = num_tracked > 0 ? tracked_pids[0] : INVALID_PERSONID;
         }
-        else
+
+        frame.frame_id = captured.frame_id;
+        frame.captured = captured.captured;
+        frame.numPeople = trackingData->QueryNumberOfPeople();
+        frame.pidInCenter = pid_in_center;
+        people_seen = frame.numPeople;
+        frame.numSkeletons = 0;
+
+        // Read the skeletons here, while the tracking output still belongs to this frame
+        for(int i = 0; i < num_tracked; i++)
         {
-            good = false;
+            personData = trackingData->QueryPersonDataById(tracked_pids[i]);
+            if(personData)
+            {
+                person_skeleton_t &skeleton = frame.skeletons[frame.numSkeletons];
+                skeleton.pid = tracked_pids[i];
+                if(extractJointCoords(personData->QuerySkeletonJoints(), jointBuffer, skeleton.joints, skeleton.confidence))
+                {
+                    frame.numSkeletons++;
+                }
+            }
         }
 
+        trackingStats.processed++;
 
-        idx++;
-    } while(good == true);
-    idx--;
+        frame.tracked = chrono::steady_clock::now();
+        trackedFrames.publish();
+    }
+}
 
-    return idx;
+void printPipelineStats(void)
+{
+    cout << "Pipeline: capture " << captureStats.processed << " frames, "
+         << captureStats.errors << " errors"
+         << " | tracking " << trackingStats.processed << " frames, queue "
+         << capturedFrames.depth() << "/" << capturedFrames.capacity() << ", "
+         << capturedFrames.drops() << " dropped"
+         << " | decision " << decisionStats.processed << " frames, queue "
+         << trackedFrames.depth() << "/" << trackedFrames.capacity() << ", "
+         << trackedFrames.drops() << " dropped"
+         << " | tracking asleep " << presence.getFramesAsleep() << " frames, woken "
+         << presence.getWakes() << " times"
+         << endl;
 }
 
-void updateNumVideos(int *numVideos)
+// x and y come from the image, z from the world coordinates; a joint is only
+// as good as the weaker of the two
+static uint8_t jointConfidence(const Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint &point)
 {
-    vector<string> names;
-
-    names.push_back("bolt");
-    names.push_back("tpose");
-    names.push_back("victory");
-    names.push_back("flexing");
-    names.push_back("stop");
-    names.push_back("fly");
-    names.push_back("rightwave");
-    names.push_back("leftwave");
-    names.push_back("jump");
-    names.push_back("toprightforward");
-    names.push_back("rightforward");
-    names.push_back("topleftforward");
-    names.push_back("leftforward");
-    names.push_back("topright");
-    names.push_back("right");
-    names.push_back("topleft");
-    names.push_back("left");
-    names.push_back("running");
-    names.push_back("idle");
-    names.push_back("ready");
-    names.push_back("undefined");
-
-
-    for(int gesture = 0; gesture < GESTURE_UNDEFINED; gesture++)
-    {
-        numVideos[gesture] = detectNumVideo(names[gesture]);
-    }
+    int confidence = min(point.confidenceImage, point.confidenceWorld);
+    return (uint8_t)max(0, min(confidence, 100));
 }
 
-int waitUntilContentStart(gestures_e gesture)
+bool extractJointCoords(Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints *personJoints,
+                        Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint *jointBuffer,
+                        jointCoords_t &jointCoords, uint8_t *confidence)
 {
-    int retval = 1;
-    int timeout = 100;
-    int i=0;
-    while((currentVideoType() != gesture) && i < timeout)
+    if(!personJoints)
     {
-        i++; // wait
-        if(i==timeout)
-        {
-            retval = 0;
-        }
+        return false;
+    }
+
+    int numJoints = personJoints->QueryNumJoints();
+    if(numJoints < 6 || numJoints > MAX_SKELETON_POINTS)
+    {
+        return false;
     }
 
-    return retval;
+    personJoints->QueryJoints(jointBuffer);
+
+    // Populate joint coordinates values
+    const Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint &lhand = jointBuffer[0];
+    const Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint &rhand = jointBuffer[1];
+    const Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint &head = jointBuffer[2];
+    const Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint &spine = jointBuffer[3];
+    const Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint &lshoulder = jointBuffer[4];
+    const Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints::SkeletonPoint &rshoulder = jointBuffer[5];
+
+    jointCoords.Lhandx = lhand.image.x;
+    jointCoords.Lhandy = lhand.image.y;
+    jointCoords.Lhandz = lhand.world.z;
+    jointCoords.Rhandx = rhand.image.x;
+    jointCoords.Rhandy = rhand.image.y;
+    jointCoords.Rhandz = rhand.world.z;
+
+    jointCoords.Lshoulderx = lshoulder.image.x;
+    jointCoords.Lshouldery = lshoulder.image.y;
+    jointCoords.Lshoulderz = lshoulder.world.z;
+    jointCoords.Rshoulderx = rshoulder.image.x;
+    jointCoords.Rshouldery = rshoulder.image.y;
+    jointCoords.Rshoulderz = rshoulder.world.z;
+
+    jointCoords.headx = head.image.x;
+    jointCoords.heady = head.image.y;
+    jointCoords.headz = head.world.z;
+    jointCoords.Spinex = spine.image.x;
+    jointCoords.Spiney = spine.image.y;
+    jointCoords.Spinez = spine.world.z;
+
+    confidence[JOINT_LHAND] = jointConfidence(lhand);
+    confidence[JOINT_RHAND] = jointConfidence(rhand);
+    confidence[JOINT_HEAD] = jointConfidence(head);
+    confidence[JOINT_SPINE] = jointConfidence(spine);
+    confidence[JOINT_LSHOULDER] = jointConfidence(lshoulder);
+    confidence[JOINT_RSHOULDER] = jointConfidence(rshoulder);
+
+    return true;
 }
+
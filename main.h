@@ -7,9 +7,6 @@
 #include "dynamicgesture.h"
 #include "analytics.h"
 
-#define CYCLES_PER_SECOND 30
-#define SEC_TO_CYCLES(a) a*CYCLES_PER_SECOND
-
 #define DEBUG 0
 using namespace std;
 
@@ -32,22 +29,31 @@ enum state_e
 
 
 
-gestures_e detectGestures(Intel::RealSense::PersonTracking::PersonTrackingData::PersonJoints *personJoints, vector<Gesture> &staticgesturelist, vector<DynamicGesture>& dynamicgesturelist);
+class VideoPlayer;
+class ContentCatalog;
+class ClipPrefetcher;
+struct latency_stamps_t;
+
+extern VideoPlayer *player;
+extern ContentCatalog *catalog;
+extern ClipPrefetcher *prefetcher;
+
 void printJointCoords(jointCoords_t &jc);
-void playContent(gestures_e gesture, bool quit);
-bool personIsInCenter(Intel::RealSense::PersonTracking::PersonTrackingData::PointCombined centerMass);
+// stamps, if given, follow the clip to the screen for the latency histograms
+void playContent(gestures_e gesture, const latency_stamps_t *stamps = nullptr);
+void prefetchContent(state_e state);
 gestures_e currentVideoType();
-void updateNumVideos(int *numVideos);
+uint64_t contentLoopClips(void);
 int waitUntilContentStart(gestures_e gesture);
-int detectNumVideo(string name);
 
 
 
 vector<Gesture> defineStaticGestures(void);
 vector<DynamicGesture> defineDynamicGestures(void);
 
-#define VLC_CMD std::string("cvlc -f --play-and-exit --no-video-title-show")
 #define VIDEOS_PATH std::string("file:///home/zac/electricTree/videos/")
 #define DEFAULT_VIDEO "/home/capstone38/Desktop/electricTree/default.mp4"
+#define GESTURES_FILE "/home/capstone38/Desktop/electricTree/gestures.json"
+#define TRACE_FILE "/home/capstone38/Desktop/electricTree/trace.ettr"
 
 #endif // MAIN_H
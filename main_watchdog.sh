@@ -1,11 +1,7 @@
 #!/bin/bash
 
-while true; do
-	if pgrep electricTree
-	then
-		echo "OK";
-	else
-		/home/zac/build-electricTree-Desktop_Qt_5_7_0_GCC_64bit-Default/electricTree &
-	fi
-	sleep 1
-done
+# etsupervise restarts electricTree when it exits, or when its heartbeat or
+# pipeline progress stalls; reasons go to supervisor.log. It stops when the
+# app quits cleanly through the cancel tool.
+BUILD=/home/zac/build-electricTree-Desktop_Qt_5_7_0_GCC_64bit-Default
+exec $BUILD/etsupervise -- $BUILD/electricTree
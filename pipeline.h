@@ -0,0 +1,99 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "gesture.h"
+#include "triplebuffer.h"
+
+using namespace std;
+
+// The main loop is split into three stages, each on its own thread:
+//   capture  - pulls frames from the camera
+//   tracking - person tracking, picks the person in the centre, reads joints
+//   decision - gesture detection and the program FSM
+// Stages hand over through triple buffers that only ever hold the newest
+// frame: one a slow stage has not taken yet is overwritten by the next, so
+// it loses stale frames instead of falling further behind.
+
+#define PIPELINE_STATS_PERIOD_SEC 10
+
+#define MAX_TRACKED_PEOPLE 8
+
+// People in the centre zone whose skeletons are read and checked for gestures
+#define MAX_GESTURE_PEOPLE 4
+
+// Size of the tracking stage's reusable skeleton buffer; the SDK reports fewer
+#define MAX_SKELETON_POINTS 32
+
+// Centre of mass of one person in the frame, world coordinates in metres
+struct person_sample_t
+{
+    int pid;
+    float comX;
+    float comY;
+    float comZ;
+};
+
+// Joints of a skeleton in the order jointCoords_t holds them, each as x, y, z
+enum skeleton_joint_e
+{
+    JOINT_LHAND=0,
+    JOINT_LSHOULDER,
+    JOINT_RHAND,
+    JOINT_RSHOULDER,
+    JOINT_SPINE,
+    JOINT_HEAD,
+    NUM_SKELETON_JOINTS
+};
+
+// A joint the SDK is less sure of than this is not trusted to have moved
+#define JOINT_MIN_CONFIDENCE 50
+
+// Skeleton of one person in the centre zone
+struct person_skeleton_t
+{
+    int pid;
+    jointCoords_t joints;
+    uint8_t confidence[NUM_SKELETON_JOINTS];    // 0-100, the lower of the SDK's image and world confidence
+};
+
+// Output of the tracking stage. Plain data, written in place into the tracked
+// frame buffer and read there by the decision stage.
+struct tracked_frame_t
+{
+    uint64_t frame_id;
+    chrono::steady_clock::time_point captured;
+    chrono::steady_clock::time_point tracked;   // zero when not known
+    int numPeople;
+    int numSampled;
+    person_sample_t people[MAX_TRACKED_PEOPLE];
+    int pidInCenter;
+    int numSkeletons;       // pidInCenter's skeleton comes first when it has one
+    person_skeleton_t skeletons[MAX_GESTURE_PEOPLE];
+};
+
+// Capture time from the previous frame to this one, as used by the gesture
+// and program timers; a stall counts as at most MAX_FRAME_INTERVAL_MS
+inline int64_t frameIntervalUs(chrono::steady_clock::time_point previous, chrono::steady_clock::time_point current)
+{
+    int64_t us = chrono::duration_cast<chrono::microseconds>(current - previous).count();
+
+    if(us < 0)
+    {
+        return 0;
+    }
+    return us > MS_TO_US(MAX_FRAME_INTERVAL_MS) ? MS_TO_US(MAX_FRAME_INTERVAL_MS) : us;
+}
+
+struct stage_stats_t
+{
+    atomic<uint64_t> processed;
+    atomic<uint64_t> errors;
+
+    stage_stats_t() : processed(0), errors(0) {}
+};
+
+#endif // PIPELINE_H
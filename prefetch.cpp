@@ -0,0 +1,241 @@
+#include "prefetch.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void adviseClip(const string &path, int64_t bytes, int advice)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return;
+    }
+
+    posix_fadvise(fd, 0, bytes, advice);
+    close(fd);
+}
+
+ClipPrefetcher::ClipPrefetcher(ContentCatalog *catalog, const string &storeFile, int64_t budgetBytes) :
+    catalog(catalog),
+    budget(budgetBytes),
+    requested(STATE_UNDEFINED),
+    hasRequest(false),
+    running(true),
+    warmBytes(0),
+    evictions(0)
+{
+    cold = first_frame_stats_t();
+    warmed = first_frame_stats_t();
+
+    if(!storeFile.empty())
+    {
+        store.open(storeFile, false);
+    }
+
+    worker = thread(&ClipPrefetcher::run, this);
+}
+
+ClipPrefetcher::~ClipPrefetcher()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        running = false;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void ClipPrefetcher::hint(state_e state)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        requested = state;
+        hasRequest = true;
+    }
+    wake.notify_one();
+}
+
+// Clips to have warm in state, most wanted first
+void ClipPrefetcher::plan(state_e state, const content_index_t &index, vector<const content_clip_t *> &clips)
+{
+    vector<gestures_e> titles;
+
+    switch(state)
+    {
+    case STATE_IDLE:
+    case STATE_IDLEVIDEO_START:
+    case STATE_IDLEVIDEO_UNDERWAY:
+        titles.push_back(GESTURE_IDLE);
+        titles.push_back(GESTURE_READY);
+        break;
+
+    case STATE_READY:
+    {
+        uint64_t weight[GESTURE_IDLE];
+        vector<gestures_e> ranked;
+
+        // Flushed counts plus the ones still waiting for the flusher
+        for(int g = 0; g < GESTURE_IDLE; g++)
+        {
+            weight[g] = analytics_counts[g].count.load(memory_order_relaxed);
+            if(store.isOpen())
+            {
+                weight[g] += store.overall((gestures_e)g);
+            }
+            if(g != GESTURE_CANCEL && index.alias[g].positive > 0)
+            {
+                ranked.push_back((gestures_e)g);
+            }
+        }
+        stable_sort(ranked.begin(), ranked.end(),
+                    [&weight](gestures_e a, gestures_e b) { return weight[a] > weight[b]; });
+
+        titles.push_back(GESTURE_READY);
+        for(size_t i = 0; i < ranked.size() && i < PREFETCH_GESTURES; i++)
+        {
+            titles.push_back(ranked[i]);
+        }
+        break;
+    }
+
+    default:
+        return;
+    }
+
+    for(size_t t = 0; t < titles.size(); t++)
+    {
+        for(size_t i = 0; i < index.clips[titles[t]].size(); i++)
+        {
+            // Retired clips are never picked
+            if(index.clips[titles[t]][i].weight > 0)
+            {
+                clips.push_back(&index.clips[titles[t]][i]);
+            }
+        }
+    }
+}
+
+void ClipPrefetcher::warmClips(const vector<const content_clip_t *> &clips)
+{
+    vector<const content_clip_t *> chosen;
+    vector<prefetch_entry_t> victims;
+    int64_t total = 0;
+
+    // As many of the most wanted clips as the budget holds
+    for(size_t i = 0; i < clips.size(); i++)
+    {
+        int64_t bytes = min(clips[i]->size, (int64_t)PREFETCH_CLIP_MB << 20);
+        if(total + bytes <= budget)
+        {
+            chosen.push_back(clips[i]);
+            total += bytes;
+        }
+    }
+
+    // Least wanted first, so the most wanted end up at the front of the LRU
+    for(size_t i = chosen.size(); i-- > 0; )
+    {
+        prefetch_entry_t entry;
+        entry.path = chosen[i]->path;
+        entry.bytes = min(chosen[i]->size, (int64_t)PREFETCH_CLIP_MB << 20);
+
+        adviseClip(entry.path, entry.bytes, POSIX_FADV_WILLNEED);
+
+        lock_guard<mutex> guard(lock);
+        for(list<prefetch_entry_t>::iterator it = warm.begin(); it != warm.end(); ++it)
+        {
+            if(it->path == entry.path)
+            {
+                warmBytes -= it->bytes;
+                warm.erase(it);
+                break;
+            }
+        }
+        warm.push_front(entry);
+        warmBytes += entry.bytes;
+    }
+
+    // Evicted only now, so nothing in this plan is dropped and read again
+    {
+        lock_guard<mutex> guard(lock);
+        while(warmBytes > budget)
+        {
+            victims.push_back(warm.back());
+            warmBytes -= warm.back().bytes;
+            warm.pop_back();
+            evictions++;
+        }
+    }
+
+    for(size_t i = 0; i < victims.size(); i++)
+    {
+        adviseClip(victims[i].path, victims[i].bytes, POSIX_FADV_DONTNEED);
+    }
+}
+
+void ClipPrefetcher::run(void)
+{
+    while(true)
+    {
+        state_e state;
+
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [this] { return hasRequest || !running; });
+            if(!running)
+            {
+                return;
+            }
+            state = requested;
+            hasRequest = false;
+        }
+
+        shared_ptr<const content_index_t> index = catalog->snapshot();
+        vector<const content_clip_t *> clips;
+
+        plan(state, *index, clips);
+        if(!clips.empty())
+        {
+            warmClips(clips);
+        }
+    }
+}
+
+void ClipPrefetcher::onFirstFrame(const string &path, int64_t us)
+{
+    lock_guard<mutex> guard(lock);
+    first_frame_stats_t *stats = &cold;
+
+    // A clip that plays counts as used
+    for(list<prefetch_entry_t>::iterator it = warm.begin(); it != warm.end(); ++it)
+    {
+        if(it->path == path)
+        {
+            warm.splice(warm.begin(), warm, it);
+            stats = &warmed;
+            break;
+        }
+    }
+
+    stats->clips++;
+    stats->totalUs += us;
+    stats->maxUs = max(stats->maxUs, us);
+}
+
+void ClipPrefetcher::print(FILE *out)
+{
+    lock_guard<mutex> guard(lock);
+    const first_frame_stats_t *all[2] = { &warmed, &cold };
+    const char *names[2] = { "warm", "cold" };
+
+    fprintf(out, "Prefetch: %zu clips warm, %.1f of %.1f MB, %llu evicted\n",
+            warm.size(), warmBytes / 1048576.0, budget / 1048576.0, (unsigned long long)evictions);
+    for(int i = 0; i < 2; i++)
+    {
+        fprintf(out, "  time to first frame, %s: %llu clips, mean %.1f ms, max %.1f ms\n",
+                names[i], (unsigned long long)all[i]->clips,
+                all[i]->clips ? all[i]->totalUs / 1000.0 / all[i]->clips : 0.0,
+                all[i]->maxUs / 1000.0);
+    }
+}
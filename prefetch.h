@@ -0,0 +1,86 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "analytics.h"
+#include "catalog.h"
+#include "main.h"
+#include "videoplayer.h"
+
+using namespace std;
+
+// Page cache kept warm for clips that are likely to play next
+#define PREFETCH_BUDGET_MB 256
+// Only the start of each clip is warmed; the player reads ahead from there
+#define PREFETCH_CLIP_MB 32
+// Gesture titles warmed while someone stands in front of the tree
+#define PREFETCH_GESTURES 3
+
+struct prefetch_entry_t
+{
+    string path;
+    int64_t bytes;
+};
+
+struct first_frame_stats_t
+{
+    uint64_t clips;
+    int64_t totalUs;
+    int64_t maxUs;
+};
+
+// Warms the page cache ahead of playContent on a thread of its own, so the
+// first frames of a clip come from memory instead of the kiosk's slow disk.
+// The FSM hints each state it enters: idle states warm the idle and ready
+// clips, READY warms the ready loop and the PREFETCH_GESTURES titles played
+// most often according to analytics. Warmed clips are kept in LRU order and
+// the oldest are dropped from the cache once PREFETCH_BUDGET_MB is used.
+//
+// As the player's FirstFrameObserver it also keeps time-to-first-frame
+// figures for warm and cold clips.
+class ClipPrefetcher : public FirstFrameObserver
+{
+private:
+    ContentCatalog *catalog;
+    AnalyticsStore store;
+    int64_t budget;
+
+    mutex lock;
+    condition_variable wake;
+    state_e requested;
+    bool hasRequest;
+    bool running;
+
+    list<prefetch_entry_t> warm;    // most recently used first
+    int64_t warmBytes;
+    first_frame_stats_t cold;
+    first_frame_stats_t warmed;
+    uint64_t evictions;
+
+    thread worker;
+
+    void plan(state_e state, const content_index_t &index, vector<const content_clip_t *> &clips);
+    void warmClips(const vector<const content_clip_t *> &clips);
+    void run(void);
+
+public:
+    // storeFile, if not empty, is the analytics store to rank gestures by
+    ClipPrefetcher(ContentCatalog *catalog, const string &storeFile, int64_t budgetBytes = (int64_t)PREFETCH_BUDGET_MB << 20);
+    ~ClipPrefetcher();
+
+    // Never waits on disk; only the newest hint is acted on
+    void hint(state_e state);
+
+    void onFirstFrame(const string &path, int64_t us);
+
+    void print(FILE *out);
+};
+
+#endif // PREFETCH_H
@@ -0,0 +1,101 @@
+#include "presence.h"
+
+// Background of a pixel that has not had depth yet: open space, farther than
+// anything the camera sees
+#define PRESENCE_OPEN (UINT16_MAX << 8)
+
+PresenceDetector::PresenceDetector() :
+    gridWidth(0),
+    gridHeight(0),
+    absentFrames(0),
+    presentFrames(0),
+    asleep(false),
+    framesAsleep(0),
+    wakes(0)
+{
+}
+
+// Grid pixels in the zone that are nearer than the background, learning the
+// background from the same pixels as it goes
+int PresenceDetector::foreground(const uint16_t *depth, int width, int height, int pitch)
+{
+    int left = width * PRESENCE_ZONE_LEFT_PCT / 100 / PRESENCE_STRIDE;
+    int right = width * PRESENCE_ZONE_RIGHT_PCT / 100 / PRESENCE_STRIDE;
+    int rows = height / PRESENCE_STRIDE;
+    int count = 0;
+
+    if(right - left != gridWidth || rows != gridHeight)
+    {
+        gridWidth = right - left;
+        gridHeight = rows;
+        background.assign(gridWidth * gridHeight, PRESENCE_OPEN);
+    }
+
+    for(int gy = 0; gy < gridHeight; gy++)
+    {
+        const uint16_t *row = (const uint16_t *)((const uint8_t *)depth + (size_t)gy * PRESENCE_STRIDE * pitch);
+        uint32_t *learned = background.data() + gy * gridWidth;
+
+        for(int gx = 0; gx < gridWidth; gx++)
+        {
+            uint32_t mm = row[(left + gx) * PRESENCE_STRIDE];
+            uint32_t b = learned[gx];
+
+            // 0 is a pixel without depth
+            if(mm == 0)
+            {
+                continue;
+            }
+
+            count += mm >= PRESENCE_NEAR_MM && mm <= PRESENCE_FAR_MM && b > ((mm + PRESENCE_MARGIN_MM) << 8);
+
+            if((mm << 8) > b)
+            {
+                learned[gx] = mm << 8;
+            }
+            else
+            {
+                learned[gx] = b - ((b - (mm << 8)) >> PRESENCE_LEARN_SHIFT);
+            }
+        }
+    }
+
+    return count;
+}
+
+bool PresenceDetector::step(const uint16_t *depth, int width, int height, int pitch, bool sleepAllowed)
+{
+    bool present = true;
+
+    if(depth && width >= PRESENCE_STRIDE && height >= PRESENCE_STRIDE)
+    {
+        int count = foreground(depth, width, height, pitch);
+        present = count * 1000 >= gridWidth * gridHeight * PRESENCE_MIN_PERMILLE;
+    }
+
+    if(!asleep)
+    {
+        absentFrames = (present || !sleepAllowed) ? 0 : absentFrames + 1;
+        if(absentFrames >= PRESENCE_SLEEP_FRAMES)
+        {
+            asleep = true;
+            presentFrames = 0;
+        }
+    }
+    else
+    {
+        presentFrames = present ? presentFrames + 1 : 0;
+        if(!sleepAllowed || presentFrames >= PRESENCE_WAKE_FRAMES)
+        {
+            asleep = false;
+            absentFrames = 0;
+            wakes.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    if(asleep)
+    {
+        framesAsleep.fetch_add(1, memory_order_relaxed);
+    }
+    return !asleep;
+}
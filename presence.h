@@ -0,0 +1,74 @@
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Presence gate for the idle video
+//
+// While the idle video loops nobody is in front of the tree, yet person
+// tracking, skeletons and gestures would still run on every frame. The
+// tracking stage instead watches the raw depth frame: a sparse grid of
+// pixels in the middle of the image, each compared with a learned
+// background. Once nothing has been near for a while it stops handing
+// frames to the person tracking module, and starts again as soon as enough
+// of the grid turns foreground.
+
+// Every PRESENCE_STRIDE-th pixel of every PRESENCE_STRIDE-th row is looked at
+#define PRESENCE_STRIDE 4
+// The zone: the middle columns of the image, a little wider than the centre
+// zone so someone is seen on their way in
+#define PRESENCE_ZONE_LEFT_PCT 25
+#define PRESENCE_ZONE_RIGHT_PCT 75
+// Depths that count, in mm; the centre zone ends at 2.4 m
+#define PRESENCE_NEAR_MM 500
+#define PRESENCE_FAR_MM 3000
+// How much nearer than the background a pixel must be to be foreground
+#define PRESENCE_MARGIN_MM 150
+// Foreground pixels, per mille of the zone, that make someone present
+#define PRESENCE_MIN_PERMILLE 20
+// The background follows anything farther at once and anything nearer at
+// 1 / 2^PRESENCE_LEARN_SHIFT per frame, so an object left in view fades in
+// over tens of seconds. At start everything is as far away as can be, so
+// furniture in the zone keeps the gate open for the first minute or so.
+#define PRESENCE_LEARN_SHIFT 8
+
+// Frames with nobody seen before tracking stops: 3 s at 30 fps
+#define PRESENCE_SLEEP_FRAMES 90
+// Frames in a row with someone present before it starts again. This bounds
+// the wake-up latency, before the tracker itself picks the person up.
+#define PRESENCE_WAKE_FRAMES 2
+
+class PresenceDetector
+{
+private:
+    vector<uint32_t> background;    // per grid pixel, mm with 8 fraction bits
+    int gridWidth;
+    int gridHeight;
+    int absentFrames;
+    int presentFrames;
+    bool asleep;
+
+    atomic<uint64_t> framesAsleep;
+    atomic<uint64_t> wakes;
+
+    int foreground(const uint16_t *depth, int width, int height, int pitch);
+
+public:
+    PresenceDetector();
+
+    // Steps the gate on one z16 depth frame (pitch in bytes) and says whether
+    // the frame should be tracked. sleepAllowed is false whenever the program
+    // needs tracking or the tracker still sees someone; without a depth frame
+    // the gate stays open.
+    bool step(const uint16_t *depth, int width, int height, int pitch, bool sleepAllowed);
+
+    bool isAsleep(void) const { return asleep; }
+    uint64_t getFramesAsleep(void) const { return framesAsleep.load(memory_order_relaxed); }
+    uint64_t getWakes(void) const { return wakes.load(memory_order_relaxed); }
+};
+
+#endif // PRESENCE_H
@@ -0,0 +1,66 @@
+#include "prng.h"
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+
+static thread_local uint64_t prng_state = 0;
+
+// Spreads any seed, even 0 or a small counter, over the whole state
+static uint64_t splitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void prngSeed(uint64_t seed)
+{
+    prng_state = splitMix64(seed);
+    if(prng_state == 0)
+    {
+        prng_state = 1;     // xorshift never leaves 0
+    }
+}
+
+uint64_t prngNext(void)
+{
+    if(prng_state == 0)
+    {
+        random_device device;
+        uint64_t seed = ((uint64_t)device() << 32) ^ device();
+        seed ^= hash<thread::id>()(this_thread::get_id());
+        seed ^= chrono::steady_clock::now().time_since_epoch().count();
+        prngSeed(seed);
+    }
+
+    prng_state ^= prng_state >> 12;
+    prng_state ^= prng_state << 25;
+    prng_state ^= prng_state >> 27;
+    return prng_state * 0x2545f4914f6cdd1dULL;
+}
+
+uint32_t prngBelow(uint32_t n)
+{
+    // Lemire's multiply-and-shift, rejecting the few values that would bias it
+    uint64_t m = (prngNext() >> 32) * (uint64_t)n;
+    uint32_t low = (uint32_t)m;
+
+    if(low < n)
+    {
+        uint32_t threshold = (uint32_t)(-n) % n;
+        while(low < threshold)
+        {
+            m = (prngNext() >> 32) * (uint64_t)n;
+            low = (uint32_t)m;
+        }
+    }
+    return m >> 32;
+}
+
+double prngUnit(void)
+{
+    return (prngNext() >> 11) * (1.0 / 9007199254740992.0);    // 53 bits
+}
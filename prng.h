@@ -0,0 +1,22 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <cstdint>
+
+using namespace std;
+
+// xorshift64* with its state in a thread_local, so the decision loop and the
+// worker threads can all draw numbers without sharing rand()'s hidden state.
+// Each thread seeds itself on first use.
+uint64_t prngNext(void);
+
+// Uniform in [0, n) without modulo bias; n must not be 0
+uint32_t prngBelow(uint32_t n);
+
+// Uniform in [0, 1)
+double prngUnit(void);
+
+// Reseed the calling thread's generator, for runs that must repeat
+void prngSeed(uint64_t seed);
+
+#endif // PRNG_H
@@ -0,0 +1,291 @@
+#include "recording.h"
+
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+static int16_t clampJoint(int value)
+{
+    if(value > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if(value < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)value;
+}
+
+void packJoints(const jointCoords_t &jc, int16_t *out)
+{
+    const int values[SKELETON_JOINT_VALUES] = {
+        jc.Lhandx, jc.Lhandy, jc.Lhandz,
+        jc.Rhandx, jc.Rhandy, jc.Rhandz,
+        jc.headx, jc.heady, jc.headz,
+        jc.Spinex, jc.Spiney, jc.Spinez,
+        jc.Lshoulderx, jc.Lshouldery, jc.Lshoulderz,
+        jc.Rshoulderx, jc.Rshouldery, jc.Rshoulderz
+    };
+
+    for(int i = 0; i < SKELETON_JOINT_VALUES; i++)
+    {
+        out[i] = clampJoint(values[i]);
+    }
+}
+
+void unpackJoints(const int16_t *in, jointCoords_t &jc)
+{
+    jc.Lhandx = in[0];
+    jc.Lhandy = in[1];
+    jc.Lhandz = in[2];
+    jc.Rhandx = in[3];
+    jc.Rhandy = in[4];
+    jc.Rhandz = in[5];
+    jc.headx = in[6];
+    jc.heady = in[7];
+    jc.headz = in[8];
+    jc.Spinex = in[9];
+    jc.Spiney = in[10];
+    jc.Spinez = in[11];
+    jc.Lshoulderx = in[12];
+    jc.Lshouldery = in[13];
+    jc.Lshoulderz = in[14];
+    jc.Rshoulderx = in[15];
+    jc.Rshouldery = in[16];
+    jc.Rshoulderz = in[17];
+}
+
+// Recordings keep the SDK joint order
+static const skeleton_joint_e sdk_joint_order[SKELETON_NUM_JOINTS] =
+{
+    JOINT_LHAND, JOINT_RHAND, JOINT_HEAD, JOINT_SPINE, JOINT_LSHOULDER, JOINT_RSHOULDER
+};
+
+void packConfidence(const uint8_t *confidence, uint8_t *out)
+{
+    for(int i = 0; i < SKELETON_NUM_JOINTS; i++)
+    {
+        out[i] = confidence[sdk_joint_order[i]];
+    }
+}
+
+void unpackConfidence(const uint8_t *in, uint8_t *confidence)
+{
+    for(int i = 0; i < SKELETON_NUM_JOINTS; i++)
+    {
+        confidence[sdk_joint_order[i]] = in[i];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SkeletonRecorder
+
+bool SkeletonRecorder::open(const string &path)
+{
+    skeleton_file_header_t header;
+
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        perror("Error opening skeleton recording");
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SKELETON_MAGIC, sizeof(header.magic));
+    header.version = SKELETON_VERSION;
+    header.numJoints = SKELETON_NUM_JOINTS;
+    fwrite(&header, sizeof(header), 1, file);
+
+    frames = 0;
+    return true;
+}
+
+void SkeletonRecorder::write(const tracked_frame_t &frame)
+{
+    skeleton_frame_header_t header;
+    skeleton_person_t people[MAX_TRACKED_PEOPLE];
+    skeleton_joints_t skeletons[MAX_GESTURE_PEOPLE];
+
+    if(!file)
+    {
+        return;
+    }
+
+    if(frames == 0)
+    {
+        first = frame.captured;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.timestamp_us = chrono::duration_cast<chrono::microseconds>(frame.captured - first).count();
+    header.frame_id = (uint32_t)frame.frame_id;
+    header.pidInCenter = frame.pidInCenter;
+    header.numPeople = (uint16_t)frame.numPeople;
+    header.numSampled = (uint8_t)frame.numSampled;
+    header.numSkeletons = (uint8_t)frame.numSkeletons;
+
+    for(int i = 0; i < frame.numSampled; i++)
+    {
+        people[i].pid = frame.people[i].pid;
+        people[i].com[0] = frame.people[i].comX;
+        people[i].com[1] = frame.people[i].comY;
+        people[i].com[2] = frame.people[i].comZ;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    for(int i = 0; i < frame.numSkeletons; i++)
+    {
+        skeletons[i].pid = frame.skeletons[i].pid;
+        packJoints(frame.skeletons[i].joints, skeletons[i].joints);
+        packConfidence(frame.skeletons[i].confidence, skeletons[i].confidence);
+        skeletons[i].reserved[0] = 0;
+        skeletons[i].reserved[1] = 0;
+    }
+
+    fwrite(people, sizeof(skeleton_person_t), frame.numSampled, file);
+    fwrite(skeletons, sizeof(skeleton_joints_t), frame.numSkeletons, file);
+
+    frames++;
+}
+
+void SkeletonRecorder::close(void)
+{
+    if(file)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SkeletonReplay
+
+bool SkeletonReplay::open(const string &path, bool realtime)
+{
+    skeleton_file_header_t header;
+
+    close();
+
+    file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        perror("Error opening skeleton recording");
+        return false;
+    }
+
+    if(fread(&header, sizeof(header), 1, file) != 1 ||
+       memcmp(header.magic, SKELETON_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != SKELETON_VERSION ||
+       header.numJoints != SKELETON_NUM_JOINTS)
+    {
+        cerr << "Error: " << path << " is not a skeleton recording this version can read" << endl;
+        close();
+        return false;
+    }
+
+    this->realtime = realtime;
+    start = chrono::steady_clock::now();
+    return true;
+}
+
+bool SkeletonReplay::next(tracked_frame_t &frame)
+{
+    skeleton_frame_header_t header;
+    skeleton_person_t people[MAX_TRACKED_PEOPLE];
+    skeleton_joints_t skeletons[MAX_GESTURE_PEOPLE];
+    bool ok;
+
+    if(!file || fread(&header, sizeof(header), 1, file) != 1)
+    {
+        return false;
+    }
+
+    ok = header.numSampled <= MAX_TRACKED_PEOPLE &&
+         header.numSkeletons <= MAX_GESTURE_PEOPLE &&
+         fread(people, sizeof(skeleton_person_t), header.numSampled, file) == header.numSampled &&
+         fread(skeletons, sizeof(skeleton_joints_t), header.numSkeletons, file) == header.numSkeletons;
+
+    if(!ok)
+    {
+        cerr << "Error: skeleton recording is truncated or corrupt" << endl;
+        return false;
+    }
+
+    frame.frame_id = header.frame_id;
+    frame.captured = start + chrono::microseconds(header.timestamp_us);
+    frame.numPeople = header.numPeople;
+    frame.numSampled = header.numSampled;
+    frame.pidInCenter = header.pidInCenter;
+    frame.numSkeletons = header.numSkeletons;
+
+    for(int i = 0; i < frame.numSampled; i++)
+    {
+        frame.people[i].pid = people[i].pid;
+        frame.people[i].comX = people[i].com[0];
+        frame.people[i].comY = people[i].com[1];
+        frame.people[i].comZ = people[i].com[2];
+    }
+
+    for(int i = 0; i < frame.numSkeletons; i++)
+    {
+        frame.skeletons[i].pid = skeletons[i].pid;
+        unpackJoints(skeletons[i].joints, frame.skeletons[i].joints);
+        unpackConfidence(skeletons[i].confidence, frame.skeletons[i].confidence);
+    }
+
+    // Only a real-time replay runs on the steady clock
+    frame.tracked = chrono::steady_clock::time_point();
+    if(realtime)
+    {
+        this_thread::sleep_until(frame.captured);
+        frame.tracked = chrono::steady_clock::now();
+    }
+
+    return true;
+}
+
+void SkeletonReplay::close(void)
+{
+    if(file)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool ResampledReplay::next(tracked_frame_t &frame)
+{
+    if(!started)
+    {
+        if(!replay.next(current))
+        {
+            return false;
+        }
+        start = current.captured;
+        haveUpcoming = replay.next(upcoming);
+        started = true;
+    }
+
+    chrono::steady_clock::time_point t = start +
+        chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(emitted / fps));
+
+    while(haveUpcoming && upcoming.captured <= t)
+    {
+        current = upcoming;
+        haveUpcoming = replay.next(upcoming);
+    }
+
+    if(!haveUpcoming && t > current.captured)
+    {
+        return false;
+    }
+
+    frame = current;
+    frame.frame_id = emitted++;
+    frame.captured = t;
+    return true;
+}
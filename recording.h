@@ -0,0 +1,131 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <string>
+
+#include "pipeline.h"
+
+using namespace std;
+
+// Skeleton stream recordings (.etsk)
+//
+// A file header followed by one record per tracked frame, little endian:
+//   skeleton_frame_header_t
+//   skeleton_person_t x numSampled      centre of mass of everyone in view
+//   skeleton_joints_t x numSkeletons    everyone in the centre zone
+//
+// Joints are stored in SDK order (left hand, right hand, head, spine, left
+// shoulder, right shoulder) as image x, image y, world z - exactly the values
+// the gesture engine reads from jointCoords_t. Confidences follow in the
+// same joint order.
+
+#define SKELETON_MAGIC "ETSK"
+#define SKELETON_VERSION 1
+#define SKELETON_NUM_JOINTS 6
+#define SKELETON_JOINT_VALUES (SKELETON_NUM_JOINTS * 3)
+
+struct skeleton_file_header_t
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t numJoints;
+    uint32_t reserved[2];
+};
+
+struct skeleton_frame_header_t
+{
+    uint64_t timestamp_us;      // since the first recorded frame
+    uint32_t frame_id;
+    int32_t pidInCenter;
+    uint16_t numPeople;
+    uint8_t numSampled;
+    uint8_t numSkeletons;
+    uint32_t reserved;
+};
+
+struct skeleton_person_t
+{
+    int32_t pid;
+    float com[3];
+};
+
+struct skeleton_joints_t
+{
+    int32_t pid;
+    int16_t joints[SKELETON_JOINT_VALUES];
+    uint8_t confidence[SKELETON_NUM_JOINTS];
+    uint8_t reserved[2];
+};
+
+static_assert(sizeof(skeleton_file_header_t) == 16, "skeleton file header must stay 16 bytes");
+static_assert(sizeof(skeleton_frame_header_t) == 24, "skeleton frame header must stay 24 bytes");
+static_assert(sizeof(skeleton_person_t) == 16, "skeleton person record must stay 16 bytes");
+static_assert(sizeof(skeleton_joints_t) == 48, "skeleton joints record must stay 48 bytes");
+static_assert(SKELETON_NUM_JOINTS == NUM_SKELETON_JOINTS, "recordings hold every joint the tracking stage reads");
+
+void packJoints(const jointCoords_t &jc, int16_t *out);
+void unpackJoints(const int16_t *in, jointCoords_t &jc);
+void packConfidence(const uint8_t *confidence, uint8_t *out);
+void unpackConfidence(const uint8_t *in, uint8_t *confidence);
+
+class SkeletonRecorder
+{
+private:
+    FILE *file;
+    chrono::steady_clock::time_point first;
+    uint64_t frames;
+
+public:
+    SkeletonRecorder() : file(nullptr), frames(0) {}
+    ~SkeletonRecorder() { close(); }
+
+    bool open(const string &path);
+    bool isOpen(void) { return file != nullptr; }
+    void write(const tracked_frame_t &frame);
+    void close(void);
+};
+
+// Plays a recording back as tracked frames. In real time it sleeps to keep
+// the recorded spacing; otherwise frames come as fast as they are asked for.
+// Either way the capture timestamps follow the recorded timeline.
+class SkeletonReplay
+{
+private:
+    FILE *file;
+    bool realtime;
+    chrono::steady_clock::time_point start;
+
+public:
+    SkeletonReplay() : file(nullptr), realtime(false) {}
+    ~SkeletonReplay() { close(); }
+
+    bool open(const string &path, bool realtime);
+    bool next(tracked_frame_t &frame);
+    void close(void);
+};
+
+// Plays a recording at a fixed frame rate, repeating or skipping recorded
+// frames, to check that gesture timing does not depend on the frame rate
+class ResampledReplay
+{
+private:
+    SkeletonReplay &replay;
+    double fps;
+    tracked_frame_t current;
+    tracked_frame_t upcoming;
+    bool started;
+    bool haveUpcoming;
+    uint64_t emitted;
+    chrono::steady_clock::time_point start;
+
+public:
+    ResampledReplay(SkeletonReplay &replay, double fps) :
+        replay(replay), fps(fps), started(false), haveUpcoming(false), emitted(0) {}
+
+    bool next(tracked_frame_t &frame);
+};
+
+#endif // RECORDING_H
@@ -1,4 +1,10 @@
 #!/bin/bash
 cd /home/capstone38/Desktop/electricTree
 ./cancel
- 
+
+# Give electricTree a moment to flush its last counts, then refresh the report
+for i in $(seq 1 25); do
+	pgrep -x electricTree > /dev/null || break
+	sleep 0.2
+done
+./etanalytics analytics.store analytics.txt
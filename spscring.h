@@ -0,0 +1,75 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+#define CACHE_LINE_SIZE 64
+
+// Bounded single-producer / single-consumer ring buffer that keeps every item
+// in order. Neither side ever blocks: a full ring rejects the new item and
+// counts it in drops(). Handoffs that only want the newest item use a
+// TripleBuffer instead.
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+private:
+    T slots[N];
+    alignas(CACHE_LINE_SIZE) atomic<size_t> head;    // written by the producer
+    alignas(CACHE_LINE_SIZE) atomic<size_t> tail;    // written by the consumer
+    alignas(CACHE_LINE_SIZE) atomic<uint64_t> dropCount;
+
+public:
+    SpscRing() : head(0), tail(0), dropCount(0) {}
+
+    bool push(const T &item)
+    {
+        size_t h = head.load(memory_order_relaxed);
+
+        if(h - tail.load(memory_order_acquire) == N)
+        {
+            dropCount.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        slots[h & (N - 1)] = item;
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+
+        if(t == head.load(memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = slots[t & (N - 1)];
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    size_t depth(void) const
+    {
+        return head.load(memory_order_acquire) - tail.load(memory_order_acquire);
+    }
+
+    uint64_t drops(void) const
+    {
+        return dropCount.load(memory_order_relaxed);
+    }
+
+    size_t capacity(void) const
+    {
+        return N;
+    }
+};
+
+#endif // SPSCRING_H
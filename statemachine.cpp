@@ -0,0 +1,260 @@
+#include "statemachine.h"
+#include "timeline.h"
+#include "trace.h"
+
+#include <iostream>
+
+using namespace std;
+
+StateMachine::StateMachine(GestureEngine *engine) : engine(engine)
+{
+    state = STATE_IDLE;
+    usSpentIdle = 0;
+    usSpentDetected = 0;
+    gestureDetected = GESTURE_UNDEFINED;
+    gesturePlaying = GESTURE_UNDEFINED;
+    shouldCancel = false;
+    seenFrame = false;
+    lastPidInCenter = INVALID_PERSONID;
+    awaitingFirstGesture = false;
+    idleLoopsSeen = 0;
+}
+
+static uint32_t msSince(chrono::steady_clock::time_point since, chrono::steady_clock::time_point now)
+{
+    return chrono::duration_cast<chrono::milliseconds>(now - since).count();
+}
+
+void StateMachine::step(const tracked_frame_t &frame)
+{
+    int pid_in_center = frame.pidInCenter;
+    state_e before = state;
+    int64_t elapsedUs = 0;
+
+    if(seenFrame)
+    {
+        elapsedUs = frameIntervalUs(lastFrame, frame.captured);
+    }
+    else
+    {
+        stateSince = frame.captured;
+        seenFrame = true;
+    }
+    lastFrame = frame.captured;
+
+    if(pid_in_center != INVALID_PERSONID && pid_in_center != lastPidInCenter)
+    {
+        analytics_timeline.personEntered();
+    }
+    lastPidInCenter = pid_in_center;
+
+    switch (state)
+    {
+    case STATE_IDLE:
+        if(pid_in_center != INVALID_PERSONID)
+        {
+            // If we are tracking exactly one person, detect their gesture
+            playContent(GESTURE_READY);
+
+            state = STATE_READY;
+            readySince = frame.captured;
+            awaitingFirstGesture = true;
+        }
+        else if(usSpentIdle >= MS_TO_US(IDLE_VIDEO_DELAY_MS))
+        {
+            // Idle for IDLE_VIDEO_DELAY_MS. Begin playback of idle video
+            state = STATE_IDLEVIDEO_START;
+
+            usSpentDetected = 0;
+        }
+
+        usSpentIdle += elapsedUs;
+        break;
+
+    case STATE_READY:
+        // Track skeleton joints of person in centre,
+        // or go back to idle if person has left centre
+
+        if(currentVideoType() == GESTURE_UNDEFINED)
+        {
+            playContent(GESTURE_READY);
+        }
+
+
+
+        if(pid_in_center != INVALID_PERSONID)
+        {
+            if(frame.numSkeletons > 0)
+            {
+                gestureDetected = engine->detect(frame.skeletons, frame.numSkeletons, frame.captured);
+            }
+            else
+            {
+                gestureDetected = GESTURE_UNDEFINED;
+            }
+
+            if(gestureDetected != GESTURE_UNDEFINED && gestureDetected != GESTURE_CANCEL)
+            {
+                gestureStamps = frameLatencyStamps(frame);
+                gestureStamps.ns[LATENCY_DECIDED] = latencyNow();
+
+                analytics_timeline.gestureStarted(gestureDetected);
+                if(awaitingFirstGesture)
+                {
+                    analytics_timeline.firstGesture(msSince(readySince, frame.captured));
+                    awaitingFirstGesture = false;
+                }
+
+                state = STATE_PLAYBACK_START;
+            }
+        }
+        else
+        {
+            analytics_timeline.personLeft(msSince(readySince, frame.captured));
+
+            state = STATE_IDLE;
+            usSpentIdle = 0;
+        }
+        break;
+
+    case STATE_PLAYBACK_START:
+        // Hand the gesture clip to the playback engine
+
+        playContent(gestureDetected, &gestureStamps);
+        gesturePlaying = gestureDetected;
+        shouldCancel = false;
+
+        state = STATE_PLAYBACK_UNDERWAY;
+        break;
+
+    case STATE_PLAYBACK_UNDERWAY:
+        // If we are still detecting a person, listen for cancel gesture
+
+        if(pid_in_center != INVALID_PERSONID)
+        {
+            if(frame.numSkeletons > 0)
+            {
+                gestureDetected = engine->detect(frame.skeletons, frame.numSkeletons, frame.captured);
+            }
+            else
+            {
+                gestureDetected = GESTURE_UNDEFINED;
+            }
+
+            // Implement cancel gesture.
+            if(gestureDetected == GESTURE_CANCEL)
+            {
+                shouldCancel = true;
+            }
+        }
+
+
+        // Once the clip is over the player is back on the ready loop by
+        // itself; a cancel cuts the clip short
+        if(currentVideoType() != gesturePlaying || shouldCancel)
+        {
+            if(shouldCancel)
+            {
+                analytics_timeline.clipCancelled();
+            }
+
+            state = STATE_READY;
+
+            playContent(GESTURE_READY);
+        }
+        break;
+
+
+    case STATE_IDLEVIDEO_START:
+        // Start the idle loop; the playback engine keeps it going
+        idleLoopsSeen = contentLoopClips();
+        playContent(GESTURE_IDLE);
+
+        usSpentDetected = 0;
+
+        state = STATE_IDLEVIDEO_UNDERWAY;
+        break;
+
+    case STATE_IDLEVIDEO_UNDERWAY:
+        if(contentLoopClips() != idleLoopsSeen)
+        {
+            analytics_timeline.idleLoop();
+            idleLoopsSeen = contentLoopClips();
+        }
+
+        if(pid_in_center != INVALID_PERSONID)
+        {
+            if(usSpentDetected >= MS_TO_US(IDLE_VIDEO_EXIT_MS)) {
+
+                state = STATE_IDLE;
+                usSpentIdle = 0;
+                break;
+            } else {
+                usSpentDetected += elapsedUs;
+            }
+        }
+        else
+        {
+            usSpentDetected = 0;
+        }
+
+        if(currentVideoType() == GESTURE_UNDEFINED)
+        {
+            state = STATE_IDLEVIDEO_START;
+        }
+
+        break;
+
+    default:
+        // INIT, UPDATE and UNDEFINED are never entered
+        break;
+    }
+
+    if(state != before)
+    {
+        uint32_t ms = msSince(stateSince, frame.captured);
+        traceEvent(TRACE_PROGRAM_STATE, 0, before, state, ms);
+        stateSince = frame.captured;
+        prefetchContent(state);
+    }
+}
+
+state_e StateMachine::getState(void)
+{
+    return state;
+}
+
+gestures_e StateMachine::getGestureDetected(void)
+{
+    return gestureDetected;
+}
+
+const char *stateName(state_e state)
+{
+    switch(state)
+    {
+    case STATE_INIT: return "INIT";
+    case STATE_IDLE: return "IDLE";
+    case STATE_READY: return "READY";
+    case STATE_PLAYBACK_START: return "PLAYBACK_START";
+    case STATE_PLAYBACK_UNDERWAY: return "PLAYBACK_UNDERWAY";
+    case STATE_IDLEVIDEO_START: return "IDLEVIDEO_START";
+    case STATE_IDLEVIDEO_UNDERWAY: return "IDLEVIDEO_UNDERWAY";
+    case STATE_UPDATE: return "UPDATE";
+    default: return "UNDEFINED";
+    }
+}
+
+void printJointCoords(jointCoords_t& jc)
+{
+    // 6: LH, 7: RH, 10: H, 19: S, 16: LS, 17: RS
+    cout << "LH: " << jc.Lhandx << ", " << jc.Lhandy
+         << ", " << jc.Lhandz
+         << "|RH: " << jc.Rhandx << ", " << jc.Rhandy
+         << ", " << jc.Rhandz
+         << "|LS: " << jc.Lshoulderx << ", " << jc.Lshouldery
+         << ", " << jc.Lshoulderz
+         << "|RS: " << jc.Rshoulderx << ", " << jc.Rshouldery
+         << ", " << jc.Rshoulderz
+         << endl;
+}
@@ -0,0 +1,54 @@
+#ifndef STATEMACHINE_H
+#define STATEMACHINE_H
+
+#include <chrono>
+#include <vector>
+
+#include "gesture.h"
+#include "gestureengine.h"
+#include "latency.h"
+#include "pipeline.h"
+#include "main.h"
+
+using namespace std;
+
+// Program timers, in milliseconds of capture time
+#define IDLE_VIDEO_DELAY_MS 0       // idle this long before the idle video starts
+#define IDLE_VIDEO_EXIT_MS 480      // someone in the centre this long ends the idle video (15 frames at 30 fps)
+
+// Program FSM, fed one tracked frame at a time by the decision stage or by a
+// recording replay.
+class StateMachine
+{
+private:
+    GestureEngine *engine;
+
+    state_e state;
+    int64_t usSpentIdle;
+    int64_t usSpentDetected;
+    gestures_e gestureDetected;
+    gestures_e gesturePlaying;
+    latency_stamps_t gestureStamps;     // of the frame the gesture was decided on
+    bool shouldCancel;
+    bool seenFrame;
+    chrono::steady_clock::time_point lastFrame;
+    chrono::steady_clock::time_point stateSince;
+
+    // For the analytics timeline
+    int lastPidInCenter;
+    bool awaitingFirstGesture;
+    chrono::steady_clock::time_point readySince;
+    uint64_t idleLoopsSeen;
+
+public:
+    StateMachine(GestureEngine *engine);
+
+    void step(const tracked_frame_t &frame);
+
+    state_e getState(void);
+    gestures_e getGestureDetected(void);
+};
+
+const char *stateName(state_e state);
+
+#endif // STATEMACHINE_H
@@ -0,0 +1,95 @@
+// Stands in for electricTree under etsupervise: beats in a control region
+// like the decision loop does, one frame per beat, then fails the way it is
+// told to.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "control.h"
+
+using namespace std;
+
+#define FAKEAPP_FRAME_MS 30
+
+int main(int argc, char** argv)
+{
+    string controlName(CONTROL_SHM_NAME);
+    bool silent = false;
+    uint64_t hangAfter = 0;
+    uint64_t freezeAfter = 0;
+    uint64_t crashAfter = 0;
+    uint64_t exitAfter = 0;
+    int exitStatus = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        string arg(argv[i]);
+
+        if(arg == "--control" && i + 1 < argc)
+        {
+            controlName = argv[++i];
+        }
+        else if(arg == "--silent")
+        {
+            // Never beat at all, like a camera that will not start
+            silent = true;
+        }
+        else if(arg == "--hang-after" && i + 1 < argc)
+        {
+            // Wedge the loop: no more heartbeats
+            hangAfter = strtoull(argv[++i], nullptr, 10);
+        }
+        else if(arg == "--freeze-after" && i + 1 < argc)
+        {
+            // Freeze the camera: heartbeats go on, frames stop
+            freezeAfter = strtoull(argv[++i], nullptr, 10);
+        }
+        else if(arg == "--crash-after" && i + 1 < argc)
+        {
+            crashAfter = strtoull(argv[++i], nullptr, 10);
+        }
+        else if(arg == "--exit-after" && i + 2 < argc)
+        {
+            exitAfter = strtoull(argv[++i], nullptr, 10);
+            exitStatus = atoi(argv[++i]);
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--control <name>] [--silent] [--hang-after <frames>]"
+                 << " [--freeze-after <frames>] [--crash-after <frames>] [--exit-after <frames> <status>]" << endl;
+            return -1;
+        }
+    }
+
+    ControlServer control(controlName);
+    if(!silent && !control.open())
+    {
+        return -1;
+    }
+
+    for(uint64_t frames = 0; ; )
+    {
+        this_thread::sleep_for(chrono::milliseconds(FAKEAPP_FRAME_MS));
+
+        if(silent || (hangAfter > 0 && frames >= hangAfter))
+        {
+            continue;
+        }
+        if(crashAfter > 0 && frames >= crashAfter)
+        {
+            abort();
+        }
+        if(exitAfter > 0 && frames >= exitAfter)
+        {
+            return exitStatus;
+        }
+        if(freezeAfter == 0 || frames < freezeAfter)
+        {
+            frames++;
+        }
+        control.heartbeat(frames, frames, frames);
+    }
+}
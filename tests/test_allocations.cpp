@@ -0,0 +1,124 @@
+// Fails if the per-frame path allocates. The scripted session is replayed
+// through the gesture engine alone, which must never touch the heap, then
+// through the program FSM, where only the frames that change the program
+// state, and so hand the player a clip, may.
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "recording.h"
+#include "testsession.h"
+
+using namespace std;
+
+// Heap allocations made by a thread while its counting is switched on
+static thread_local bool countingAllocations = false;
+static thread_local uint64_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    if(countingAllocations)
+    {
+        allocations++;
+    }
+
+    void *p = malloc(size ? size : 1);
+    if(!p)
+    {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+int main(void)
+{
+    string path = testScratchPath("test_allocations.etsk");
+    SkeletonReplay replay;
+    tracked_frame_t frame;
+    int failures = 0;
+
+    if(!writeTestSession(path) || !replay.open(path, false))
+    {
+        return 1;
+    }
+
+    {
+        GestureEngine engine(GestureTable::compile(builtinGestureDefinitions()));
+        uint64_t frames = 0;
+        uint64_t detections = 0;
+
+        while(replay.next(frame))
+        {
+            countingAllocations = true;
+            detections += engine.detect(frame.skeletons, frame.numSkeletons, frame.captured) != GESTURE_UNDEFINED;
+            countingAllocations = false;
+            frames++;
+        }
+
+        cout << "gesture engine: " << allocations << " heap allocations on " << frames << " frames, "
+             << detections << " detections" << endl;
+        if(allocations > 0 || detections == 0)
+        {
+            failures++;
+        }
+    }
+
+    replay.close();
+    if(!replay.open(path, false))
+    {
+        return 1;
+    }
+
+    {
+        SessionDriver driver;
+        uint64_t frames = 0;
+        uint64_t transitions = 0;
+        uint64_t allocating = 0;
+        uint64_t handOver = 0;
+
+        while(replay.next(frame))
+        {
+            state_e before = driver.stateMachine.getState();
+
+            driver.endClipIfDue(frame);
+            allocations = 0;
+            countingAllocations = true;
+            driver.stateMachine.step(frame);
+            countingAllocations = false;
+            driver.settle();
+            frames++;
+
+            state_e after = driver.stateMachine.getState();
+            if(after != before)
+            {
+                transitions++;
+                handOver += allocations;
+            }
+            else if(allocations > 0)
+            {
+                cout << "frame " << frame.frame_id << " in " << stateName(after) << ": "
+                     << allocations << " heap allocations" << endl;
+                allocating++;
+            }
+        }
+
+        cout << "program FSM: " << allocating << " of " << frames << " frames allocate outside the "
+             << transitions << " state changes, which make " << handOver << endl;
+        if(allocating > 0 || transitions == 0)
+        {
+            failures++;
+        }
+    }
+
+    remove(path.c_str());
+
+    cout << (failures ? "FAIL" : "ok") << endl;
+    return failures ? 1 : 0;
+}
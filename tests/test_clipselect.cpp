@@ -0,0 +1,188 @@
+// Statistical check of ClipSelector, needing no recording or content: over
+// millions of picks from several weight sets on several threads, each clip
+// must come up as often as its weight says (a chi-square test), and no pick
+// may repeat one of the recent clips.
+//
+// Usage: test_clipselect [picks]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catalog.h"
+#include "clipselect.h"
+
+using namespace std;
+
+#define SELECT_DEFAULT_DRAWS 4000000
+// A weight set whose chi-square scores above this fails
+#define SELECT_MAX_Z 4.0
+
+// Weight sets: mixed weights, a strict alternation, a
+// retired clip, one clip heavy enough to need the fallback walk, a lone clip
+static const vector<vector<double>> select_weight_sets =
+{
+    { 1, 2, 3, 4, 10 },
+    { 1, 1 },
+    { 5, 0, 1 },
+    { 100, 1, 1, 1 },
+    { 1 }
+};
+
+// Picks made on SELECT_THREADS threads at once, each with its own selector
+// as the decision thread has
+#define SELECT_THREADS 4
+
+struct select_tally_t
+{
+    vector<vector<uint64_t>> observed;
+    vector<vector<double>> expected;
+    uint64_t repeats;
+};
+
+static void tallySelection(const content_index_t &index, uint64_t draws, select_tally_t &tally)
+{
+    ClipSelector selector;
+    size_t sets = select_weight_sets.size();
+
+    tally.repeats = 0;
+    for(size_t g = 0; g < sets; g++)
+    {
+        tally.observed.push_back(vector<uint64_t>(select_weight_sets[g].size(), 0));
+        tally.expected.push_back(vector<double>(select_weight_sets[g].size(), 0.0));
+    }
+
+    for(uint64_t d = 0; d < draws; d++)
+    {
+        gestures_e g = (gestures_e)(d % sets);
+        const vector<double> &w = select_weight_sets[g];
+        int window = selector.window(index, g);
+        int recent[CLIP_NO_REPEAT];
+        copy(selector.history(g), selector.history(g) + window, recent);
+
+        // Chance of each clip on this draw: its share of what is not recent
+        double rest = 0;
+        for(size_t i = 0; i < w.size(); i++)
+        {
+            if(find(recent, recent + window, (int)i) == recent + window)
+            {
+                rest += w[i];
+            }
+        }
+        for(size_t i = 0; i < w.size(); i++)
+        {
+            if(find(recent, recent + window, (int)i) == recent + window)
+            {
+                tally.expected[g][i] += w[i] / rest;
+            }
+        }
+
+        int clip = selector.pick(index, g);
+        if(find(recent, recent + window, clip) != recent + window)
+        {
+            tally.repeats++;
+        }
+        tally.observed[g][clip]++;
+    }
+}
+
+// Summed over every draw, the chance the selector gave each clip should
+// match how often it came up
+static int checkSelection(uint64_t draws)
+{
+    content_index_t index;
+    size_t sets = select_weight_sets.size();
+
+    index.generation = 1;
+    for(size_t g = 0; g < sets; g++)
+    {
+        for(size_t i = 0; i < select_weight_sets[g].size(); i++)
+        {
+            content_clip_t clip;
+            clip.name = "clip" + to_string(i);
+            clip.weight = select_weight_sets[g][i];
+            index.clips[g].push_back(clip);
+        }
+        buildAliasTable(select_weight_sets[g], index.alias[g]);
+    }
+
+    vector<select_tally_t> tallies(SELECT_THREADS);
+    vector<thread> threads;
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for(int t = 0; t < SELECT_THREADS; t++)
+    {
+        threads.push_back(thread(tallySelection, cref(index), draws / SELECT_THREADS, ref(tallies[t])));
+    }
+    for(thread &t : threads)
+    {
+        t.join();
+    }
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    bool ok = true;
+    for(size_t g = 0; g < sets; g++)
+    {
+        double chi2 = 0;
+        int dof = -1;
+        uint64_t impossible = 0;
+
+        for(size_t i = 0; i < select_weight_sets[g].size(); i++)
+        {
+            uint64_t observed = 0;
+            double expected = 0;
+            for(int t = 0; t < SELECT_THREADS; t++)
+            {
+                observed += tallies[t].observed[g][i];
+                expected += tallies[t].expected[g][i];
+            }
+
+            if(expected > 0)
+            {
+                chi2 += (observed - expected) * (observed - expected) / expected;
+                dof++;
+            }
+            else
+            {
+                impossible += observed;
+            }
+        }
+
+        // Wilson-Hilferty: chi-square to an approximately normal score
+        double z = 0;
+        if(dof > 0)
+        {
+            double k = dof;
+            z = (cbrt(chi2 / k) - (1 - 2 / (9 * k))) / sqrt(2 / (9 * k));
+        }
+        bool pass = z < SELECT_MAX_Z && impossible == 0;
+        ok = ok && pass;
+
+        printf("set %zu: %zu clips, chi-square %.2f on %d dof, z %.2f, %llu impossible picks: %s\n",
+               g, select_weight_sets[g].size(), chi2, dof, z, (unsigned long long)impossible, pass ? "ok" : "FAIL");
+    }
+
+    uint64_t repeats = 0;
+    for(int t = 0; t < SELECT_THREADS; t++)
+    {
+        repeats += tallies[t].repeats;
+    }
+    ok = ok && repeats == 0;
+    printf("%llu picks on %d threads, %llu repeats within the no-repeat window, %.1f ns/pick with bookkeeping: %s\n",
+           (unsigned long long)(draws / SELECT_THREADS * SELECT_THREADS), SELECT_THREADS,
+           (unsigned long long)repeats, sec * 1e9 * SELECT_THREADS / draws, ok ? "ok" : "FAIL");
+
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t draws = argc > 1 ? strtoull(argv[1], nullptr, 10) : SELECT_DEFAULT_DRAWS;
+
+    return checkSelection(draws) == 0 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// Gesture timing follows capture time, not the frame count: the scripted
+// session replayed at 15, 30 and 60 fps must trigger the same gestures, in
+// the same order, at nearly the same moments.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "recording.h"
+#include "testsession.h"
+
+using namespace std;
+
+// A trigger may move by up to a frame at the slower of the two rates, as
+// that is when the held time first shows; anything more is lag that depends
+// on the frame rate
+#define FRAMERATE_SLACK_SEC 0.001
+
+struct trigger_t
+{
+    gestures_e gesture;
+    double sec;     // capture time since the first frame
+};
+
+static bool replayAt(const string &path, double fps, vector<trigger_t> &triggers)
+{
+    SkeletonReplay replay;
+    tracked_frame_t frame;
+    chrono::steady_clock::time_point first;
+    bool started = false;
+
+    if(!replay.open(path, false))
+    {
+        return false;
+    }
+
+    ResampledReplay resampled(replay, fps);
+    SessionDriver driver;
+
+    while(resampled.next(frame))
+    {
+        if(!started)
+        {
+            first = frame.captured;
+            started = true;
+        }
+
+        driver.step(frame);
+        if(driver.stateMachine.getState() == STATE_PLAYBACK_START)
+        {
+            trigger_t t;
+            t.gesture = driver.stateMachine.getGestureDetected();
+            t.sec = chrono::duration<double>(frame.captured - first).count();
+            triggers.push_back(t);
+        }
+    }
+
+    cout << fps << " fps:";
+    for(const trigger_t &t : triggers)
+    {
+        printf(" %s at %.3f s", gestureName(t.gesture), t.sec);
+    }
+    cout << endl;
+    return true;
+}
+
+int main(void)
+{
+    static const double rates[] = { 15, 30, 60 };
+    string path = testScratchPath("test_framerate.etsk");
+    vector<trigger_t> reference;
+    int failures = 0;
+
+    if(!writeTestSession(path) || !replayAt(path, TEST_SESSION_FPS, reference))
+    {
+        return 1;
+    }
+    if(reference.empty())
+    {
+        cout << "FAIL: the session triggers no gesture" << endl;
+        failures++;
+    }
+
+    for(double fps : rates)
+    {
+        vector<trigger_t> triggers;
+
+        if(!replayAt(path, fps, triggers))
+        {
+            return 1;
+        }
+
+        if(triggers.size() != reference.size())
+        {
+            cout << "FAIL: " << triggers.size() << " gestures at " << fps << " fps, "
+                 << reference.size() << " at " << TEST_SESSION_FPS << endl;
+            failures++;
+            continue;
+        }
+
+        double tolerance = 1.0 / min(fps, (double)TEST_SESSION_FPS) + FRAMERATE_SLACK_SEC;
+
+        for(size_t i = 0; i < triggers.size(); i++)
+        {
+            if(triggers[i].gesture != reference[i].gesture ||
+               fabs(triggers[i].sec - reference[i].sec) > tolerance)
+            {
+                printf("FAIL: gesture %zu at %g fps is %s at %.3f s, at %d fps %s at %.3f s\n",
+                       i, fps, gestureName(triggers[i].gesture), triggers[i].sec,
+                       TEST_SESSION_FPS, gestureName(reference[i].gesture), reference[i].sec);
+                failures++;
+            }
+        }
+    }
+
+    remove(path.c_str());
+
+    cout << (failures ? "FAIL" : "ok") << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+// A joint the SDK is unsure of keeps its smoothed position for a frame or
+// two, so a dropout does not break a held pose, but not for long enough to
+// carry the pose to its trigger: a hand out of sight is not a hand in a box.
+
+#include <cstring>
+#include <iostream>
+
+#include "gesturedefinitions.h"
+#include "gestureengine.h"
+
+using namespace std;
+
+#define OCCLUSION_FRAME_US 33333
+#define OCCLUSION_FRAMES 60
+
+// Holds the USAIN pose in front of the engine at 30 fps. From frame
+// lostFrom, for lostFrames frames, the right hand has no confidence and the
+// SDK's guess for it is nowhere near. Returns the frame USAIN triggers on,
+// or -1.
+static int holdUsain(int lostFrom, int lostFrames)
+{
+    GestureEngine engine(GestureTable::compile(builtinGestureDefinitions()));
+    chrono::steady_clock::time_point captured = chrono::steady_clock::now();
+    person_skeleton_t person;
+    jointCoords_t &jc = person.joints;
+
+    memset(&person, 0, sizeof(person));
+    person.pid = 1;
+    jc.Lshoulderx = 300;
+    jc.Lshouldery = 200;
+    jc.Lshoulderz = 1500;
+    jc.Rshoulderx = 200;
+    jc.Rshouldery = 200;
+    jc.Rshoulderz = 1500;
+    jc.Spinex = 250;
+    jc.Spiney = 300;
+    jc.Spinez = 1500;
+    jc.headx = 250;
+    jc.heady = 100;
+    jc.headz = 1500;
+    jc.Lhandx = 260;
+    jc.Lhandy = 215;
+    jc.Lhandz = 1300;
+
+    for(int f = 0; f < OCCLUSION_FRAMES; f++)
+    {
+        bool lost = f >= lostFrom && f < lostFrom + lostFrames;
+
+        jc.Rhandx = lost ? 0 : 275;
+        jc.Rhandy = lost ? 900 : 155;
+        jc.Rhandz = 1300;
+        for(int j = 0; j < NUM_SKELETON_JOINTS; j++)
+        {
+            person.confidence[j] = (lost && j == JOINT_RHAND) ? 0 : 100;
+        }
+
+        captured += chrono::microseconds(OCCLUSION_FRAME_US);
+        if(engine.detect(&person, 1, captured) == GESTURE_USAIN)
+        {
+            return f;
+        }
+    }
+    return -1;
+}
+
+int main(void)
+{
+    int failures = 0;
+    int clean = holdUsain(0, 0);
+    int dropout = holdUsain(4, 1);
+    int occluded = holdUsain(3, OCCLUSION_FRAMES);
+    int neverSeen = holdUsain(0, OCCLUSION_FRAMES);
+
+    cout << "USAIN triggers on frame " << clean << " in full view, " << dropout << " through a one frame dropout, "
+         << occluded << " with the hand lost for good, " << neverSeen << " with it never seen" << endl;
+
+    if(clean < 0 || dropout != clean)
+    {
+        cout << "FAIL: a one frame dropout changes the trigger" << endl;
+        failures++;
+    }
+    if(occluded >= 0 || neverSeen >= 0)
+    {
+        cout << "FAIL: a hand out of sight holds the pose to its trigger" << endl;
+        failures++;
+    }
+
+    cout << (failures ? "FAIL" : "ok") << endl;
+    return failures ? 1 : 0;
+}
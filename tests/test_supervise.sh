@@ -0,0 +1,86 @@
+#!/bin/bash
+
+# Runs etsupervise against fakeapp with short deadlines, once per way the app
+# can fail, and checks the restart reasons and the backoff in its log.
+#
+# Usage: test_supervise.sh <etsupervise> <fakeapp>
+
+SUPERVISE="$1"
+FAKEAPP="$2"
+CONTROL="etree_control_test_$$"
+LOG="${TMPDIR:-/tmp}/test_supervise-$$.log"
+DEADLINES="--startup-ms 1000 --beat-ms 300 --stall-ms 300 --backoff-ms 100"
+failures=0
+
+fail()
+{
+    echo "FAIL: $1"
+    sed 's/^/    /' "$LOG"
+    failures=$((failures + 1))
+}
+
+# supervise <restarts> <fakeapp args...>: supervise the fake app until it has
+# been restarted that many times, or for a second when that is 0, then stop
+# the supervisor
+supervise()
+{
+    local restarts=$1
+    shift
+
+    rm -f "$LOG"
+    "$SUPERVISE" --log "$LOG" $DEADLINES --control "$CONTROL" -- "$FAKEAPP" --control "$CONTROL" "$@" 2>/dev/null &
+    local pid=$!
+
+    for i in $(seq 100); do
+        local seen=$(grep -c 'restarting in' "$LOG" 2>/dev/null)
+        [ $restarts -gt 0 ] && [ ${seen:-0} -ge $restarts ] && break
+        [ $restarts -eq 0 ] && [ $i -ge 10 ] && break
+        kill -0 $pid 2>/dev/null || break
+        sleep 0.1
+    done
+
+    kill -TERM $pid 2>/dev/null
+    wait $pid
+}
+
+# expect <what> <pattern>: the log has a line matching pattern
+expect()
+{
+    grep -q -- "$2" "$LOG" || fail "$1: no line matching '$2'"
+}
+
+supervise 3 --hang-after 5
+expect "hang" "restarting in 100 ms: main loop silent for"
+expect "hang" "restarting in 200 ms: main loop silent for"
+expect "hang" "restarting in 400 ms: main loop silent for"
+
+supervise 0
+expect "healthy" "supervisor asked to stop, not restarting"
+grep -q "restarting in" "$LOG" && fail "healthy: restarted"
+
+supervise 1 --freeze-after 5
+expect "freeze" "restarting in 100 ms: capture stage stalled at frame 5 for"
+
+supervise 1 --silent
+expect "silent" "restarting in 100 ms: no heartbeat within 1000 ms of starting"
+
+supervise 2 --crash-after 5
+expect "crash" "restarting in 100 ms: killed by signal 6"
+expect "crash" "restarting in 200 ms: killed by signal 6"
+
+supervise 1 --exit-after 5 3
+expect "exit" "restarting in 100 ms: exited with status 3"
+
+# A clean exit ends supervision without a restart or a stop request
+supervise 1 --exit-after 5 0
+expect "clean exit" "exited with status 0, not restarting"
+grep -q "restarting in" "$LOG" && fail "clean exit: restarted"
+grep -q "supervisor asked to stop" "$LOG" && fail "clean exit: supervisor did not stop by itself"
+
+rm -f "$LOG" "/dev/shm/$CONTROL"
+
+if [ $failures -ne 0 ]; then
+    echo "FAIL"
+    exit 1
+fi
+echo "ok"
@@ -0,0 +1,193 @@
+#include "testsession.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+#include "recording.h"
+
+// Hand positions as shoulder minus hand, the way the threshold boxes see them
+struct test_pose_t
+{
+    int lx, ly, rx, ry;
+};
+
+static const test_pose_t pose_rest =   { 0, -200, 0, -200 };
+static const test_pose_t pose_usain =  { 40, -15, -75, 45 };
+static const test_pose_t pose_t =      { 90, 0, -90, 0 };
+static const test_pose_t pose_wings =  { 80, 5, 0, 15 };
+static const test_pose_t pose_flap =   { 80, -50, 0, -70 };
+
+// Sensor noise on every joint coordinate, in units
+#define TEST_SESSION_NOISE 2
+
+class SessionWriter
+{
+private:
+    SkeletonRecorder recorder;
+    chrono::steady_clock::time_point captured;
+    uint64_t frameId;
+    test_pose_t last;
+
+    static int noise(void)
+    {
+        return rand() % (2 * TEST_SESSION_NOISE + 1) - TEST_SESSION_NOISE;
+    }
+
+    void emit(bool present, const test_pose_t &pose)
+    {
+        tracked_frame_t frame;
+
+        frame.frame_id = frameId++;
+        frame.captured = captured;
+        frame.tracked = chrono::steady_clock::time_point();
+        frame.numPeople = present ? 1 : 0;
+        frame.numSampled = 0;
+        frame.pidInCenter = present ? TEST_SESSION_PID : INVALID_PERSONID;
+        frame.numSkeletons = present ? 1 : 0;
+
+        if(present)
+        {
+            person_skeleton_t &person = frame.skeletons[0];
+            jointCoords_t &jc = person.joints;
+
+            person.pid = TEST_SESSION_PID;
+            jc.Lshoulderx = 300 + noise();
+            jc.Lshouldery = 200 + noise();
+            jc.Lshoulderz = 1500 + noise();
+            jc.Rshoulderx = 200 + noise();
+            jc.Rshouldery = 200 + noise();
+            jc.Rshoulderz = 1500 + noise();
+            jc.Lhandx = 300 - pose.lx + noise();
+            jc.Lhandy = 200 - pose.ly + noise();
+            jc.Lhandz = 1300 + noise();
+            jc.Rhandx = 200 - pose.rx + noise();
+            jc.Rhandy = 200 - pose.ry + noise();
+            jc.Rhandz = 1300 + noise();
+            jc.Spinex = 250 + noise();
+            jc.Spiney = 300 + noise();
+            jc.Spinez = 1500 + noise();
+            jc.headx = 250 + noise();
+            jc.heady = 100 + noise();
+            jc.headz = 1500 + noise();
+            for(int j = 0; j < NUM_SKELETON_JOINTS; j++)
+            {
+                person.confidence[j] = 100;
+            }
+        }
+
+        recorder.write(frame);
+        captured += chrono::microseconds(1000000 / TEST_SESSION_FPS);
+    }
+
+public:
+    SessionWriter() : captured(chrono::steady_clock::now()), frameId(0), last(pose_rest) {}
+
+    bool open(const string &path) { return recorder.open(path); }
+    void close(void) { recorder.close(); }
+
+    void nobody(double sec)
+    {
+        for(int i = 0; i < sec * TEST_SESSION_FPS; i++)
+        {
+            emit(false, last);
+        }
+    }
+
+    // Move to pose over a few frames, then hold it for sec
+    void hold(const test_pose_t &pose, double sec)
+    {
+        const int moveFrames = 4;
+
+        for(int i = 1; i <= moveFrames; i++)
+        {
+            test_pose_t p;
+            p.lx = last.lx + (pose.lx - last.lx) * i / moveFrames;
+            p.ly = last.ly + (pose.ly - last.ly) * i / moveFrames;
+            p.rx = last.rx + (pose.rx - last.rx) * i / moveFrames;
+            p.ry = last.ry + (pose.ry - last.ry) * i / moveFrames;
+            emit(true, p);
+        }
+        last = pose;
+        for(int i = 0; i < sec * TEST_SESSION_FPS; i++)
+        {
+            emit(true, pose);
+        }
+    }
+};
+
+bool writeTestSession(const string &path)
+{
+    SessionWriter writer;
+
+    srand(1);
+    if(!writer.open(path))
+    {
+        return false;
+    }
+
+    writer.nobody(2.0);
+    writer.hold(pose_rest, 3.0);
+    writer.hold(pose_usain, 1.5);
+    writer.hold(pose_rest, 5.0);
+    for(int flap = 0; flap < 3; flap++)
+    {
+        writer.hold(pose_wings, 0.3);
+        writer.hold(pose_flap, 0.3);
+    }
+    writer.hold(pose_rest, 5.0);
+    writer.hold(pose_t, 1.5);
+    writer.hold(pose_rest, 5.0);
+    writer.nobody(2.0);
+
+    writer.close();
+    return true;
+}
+
+string testScratchPath(const string &name)
+{
+    const char *dir = getenv("TMPDIR");
+
+    return string(dir ? dir : "/tmp") + "/" + name + "-" + to_string(getpid());
+}
+
+SessionDriver::SessionDriver() :
+    sink(discard),
+    videoPlayer(&sink),
+    clipType(GESTURE_UNDEFINED),
+    clipCount(0),
+    engine(GestureTable::compile(builtinGestureDefinitions())),
+    stateMachine(&engine)
+{
+    player = &videoPlayer;
+}
+
+SessionDriver::~SessionDriver()
+{
+    videoPlayer.waitIdle();
+    player = nullptr;
+}
+
+void SessionDriver::endClipIfDue(const tracked_frame_t &frame)
+{
+    gestures_e playing = videoPlayer.current();
+    uint64_t started = sink.clipsStarted();
+
+    if(playing != clipType || started != clipCount)
+    {
+        clipType = playing;
+        clipCount = started;
+        clipStart = frame.captured;
+    }
+    else if(playing != GESTURE_UNDEFINED &&
+            frame.captured - clipStart >= chrono::duration<double>(TEST_CLIP_SEC))
+    {
+        sink.finish();
+    }
+}
+
+void SessionDriver::step(const tracked_frame_t &frame)
+{
+    endClipIfDue(frame);
+    stateMachine.step(frame);
+    settle();
+}
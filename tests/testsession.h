@@ -0,0 +1,58 @@
+#ifndef TESTSESSION_H
+#define TESTSESSION_H
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "gestureengine.h"
+#include "pipeline.h"
+#include "statemachine.h"
+#include "videoplayer.h"
+
+using namespace std;
+
+// A scripted visit in front of the tree, for the tests that need a
+// recording: nobody at first, then one person walks into the centre, holds
+// the USAIN pose, rests, flaps their arms (FLYING), holds the T pose and
+// leaves. Joints carry a little deterministic sensor noise.
+
+#define TEST_SESSION_FPS 30
+#define TEST_SESSION_PID 1
+// How long the stub player shows each gesture clip, in seconds of capture time
+#define TEST_CLIP_SEC 3.0
+
+// Writes the session to path as a skeleton recording
+bool writeTestSession(const string &path);
+
+// A path for a scratch file of the test, removed by the caller
+string testScratchPath(const string &name);
+
+// The program FSM and gesture engine on the built-in gestures, playing to a
+// stub player whose clips end after TEST_CLIP_SEC, as etreplay runs them
+class SessionDriver
+{
+private:
+    ofstream discard;
+    StubSink sink;
+    VideoPlayer videoPlayer;
+    chrono::steady_clock::time_point clipStart;
+    gestures_e clipType;
+    uint64_t clipCount;
+
+public:
+    GestureEngine engine;
+    StateMachine stateMachine;
+
+    SessionDriver();
+    ~SessionDriver();
+
+    // Stand in for the end of the clip on screen, before stepping on frame
+    void endClipIfDue(const tracked_frame_t &frame);
+    // Let the player catch up after a step, so runs do not depend on thread timing
+    void settle(void) { videoPlayer.waitIdle(); }
+
+    void step(const tracked_frame_t &frame);
+};
+
+#endif // TESTSESSION_H
@@ -0,0 +1,257 @@
+#include "timeline.h"
+
+#include <ctime>
+
+AnalyticsTimeline analytics_timeline;
+
+static const char *counter_names[NUM_TIMELINE_COUNTERS] =
+{
+    "entries",
+    "gestures",
+    "cancels",
+    "idle",
+    "first",
+    "first_ms",
+    "first_max_ms",
+    "visits",
+    "dwell_ms"
+};
+
+static int64_t nowSeconds(void)
+{
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+AnalyticsTimeline::AnalyticsTimeline()
+{
+    for(int s = 0; s < NUM_TIMELINE_SCALES; s++)
+    {
+        int size;
+        slot_t *slots = ring((timeline_scale_e)s, &size);
+
+        for(int i = 0; i < size; i++)
+        {
+            slots[i].seq = 0;
+            slots[i].index = -1;
+            for(int c = 0; c < NUM_TIMELINE_COUNTERS; c++)
+            {
+                slots[i].counters[c] = 0;
+            }
+            for(int g = 0; g < GESTURE_IDLE; g++)
+            {
+                slots[i].gestures[g] = 0;
+            }
+        }
+    }
+}
+
+int64_t AnalyticsTimeline::bucketSeconds(timeline_scale_e scale)
+{
+    return scale == TIMELINE_SCALE_MINUTE ? 60 : 3600;
+}
+
+AnalyticsTimeline::slot_t *AnalyticsTimeline::ring(timeline_scale_e scale, int *size)
+{
+    if(scale == TIMELINE_SCALE_MINUTE)
+    {
+        *size = TIMELINE_MINUTES;
+        return minutes;
+    }
+    *size = TIMELINE_HOURS;
+    return hours;
+}
+
+// The slot for now, cleared first if it still holds an older bucket
+AnalyticsTimeline::slot_t &AnalyticsTimeline::current(timeline_scale_e scale, int64_t now)
+{
+    int size;
+    slot_t *slots = ring(scale, &size);
+    int64_t index = now / bucketSeconds(scale);
+    slot_t &slot = slots[index % size];
+
+    if(slot.index.load(memory_order_relaxed) != index)
+    {
+        uint32_t seq = slot.seq.load(memory_order_relaxed);
+
+        slot.seq.store(seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        slot.index.store(index, memory_order_relaxed);
+        for(int c = 0; c < NUM_TIMELINE_COUNTERS; c++)
+        {
+            slot.counters[c].store(0, memory_order_relaxed);
+        }
+        for(int g = 0; g < GESTURE_IDLE; g++)
+        {
+            slot.gestures[g].store(0, memory_order_relaxed);
+        }
+
+        slot.seq.store(seq + 2, memory_order_release);
+    }
+
+    return slot;
+}
+
+// Single writer, so a plain load and store is enough for every update
+void AnalyticsTimeline::add(timeline_counter_e counter, uint32_t value)
+{
+    int64_t now = nowSeconds();
+
+    for(int s = 0; s < NUM_TIMELINE_SCALES; s++)
+    {
+        atomic<uint32_t> &field = current((timeline_scale_e)s, now).counters[counter];
+        uint32_t old = field.load(memory_order_relaxed);
+
+        if(counter == TIMELINE_FIRST_GESTURE_MAX_MS)
+        {
+            if(value > old)
+            {
+                field.store(value, memory_order_relaxed);
+            }
+        }
+        else
+        {
+            field.store(old + value, memory_order_relaxed);
+        }
+    }
+}
+
+void AnalyticsTimeline::personEntered(void)
+{
+    add(TIMELINE_ENTRIES, 1);
+}
+
+void AnalyticsTimeline::gestureStarted(gestures_e gesture)
+{
+    int64_t now = nowSeconds();
+
+    add(TIMELINE_GESTURES, 1);
+    if(gesture < GESTURE_IDLE)
+    {
+        for(int s = 0; s < NUM_TIMELINE_SCALES; s++)
+        {
+            atomic<uint32_t> &field = current((timeline_scale_e)s, now).gestures[gesture];
+            field.store(field.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        }
+    }
+}
+
+void AnalyticsTimeline::firstGesture(uint32_t msSinceReady)
+{
+    add(TIMELINE_FIRST_GESTURES, 1);
+    add(TIMELINE_FIRST_GESTURE_MS, msSinceReady);
+    add(TIMELINE_FIRST_GESTURE_MAX_MS, msSinceReady);
+}
+
+void AnalyticsTimeline::clipCancelled(void)
+{
+    add(TIMELINE_CANCELS, 1);
+}
+
+void AnalyticsTimeline::idleLoop(void)
+{
+    add(TIMELINE_IDLE_LOOPS, 1);
+}
+
+void AnalyticsTimeline::personLeft(uint32_t msSinceReady)
+{
+    add(TIMELINE_VISITS, 1);
+    add(TIMELINE_DWELL_MS, msSinceReady);
+}
+
+int AnalyticsTimeline::query(timeline_scale_e scale, int count, timeline_bucket_t *out)
+{
+    int size;
+    slot_t *slots = ring(scale, &size);
+    int64_t seconds = bucketSeconds(scale);
+    int64_t newest = nowSeconds() / seconds;
+
+    if(count > size)
+    {
+        count = size;
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        int64_t index = newest - (count - 1 - i);
+        slot_t &slot = slots[index % size];
+        timeline_bucket_t &bucket = out[i];
+        uint32_t before;
+        uint32_t after;
+        int64_t held;
+
+        // Retry while the writer is clearing the slot underneath us
+        do
+        {
+            before = slot.seq.load(memory_order_acquire);
+            held = slot.index.load(memory_order_relaxed);
+            for(int c = 0; c < NUM_TIMELINE_COUNTERS; c++)
+            {
+                bucket.counters[c] = slot.counters[c].load(memory_order_relaxed);
+            }
+            for(int g = 0; g < GESTURE_IDLE; g++)
+            {
+                bucket.gestures[g] = slot.gestures[g].load(memory_order_relaxed);
+            }
+            atomic_thread_fence(memory_order_acquire);
+            after = slot.seq.load(memory_order_relaxed);
+        } while((before & 1) || before != after);
+
+        bucket.start = index * seconds;
+        if(held != index)
+        {
+            for(int c = 0; c < NUM_TIMELINE_COUNTERS; c++)
+            {
+                bucket.counters[c] = 0;
+            }
+            for(int g = 0; g < GESTURE_IDLE; g++)
+            {
+                bucket.gestures[g] = 0;
+            }
+        }
+    }
+
+    return count;
+}
+
+void AnalyticsTimeline::print(ostream &out, timeline_scale_e scale, int count)
+{
+    timeline_bucket_t buckets[TIMELINE_HOURS > TIMELINE_MINUTES ? TIMELINE_HOURS : TIMELINE_MINUTES];
+    int n = query(scale, count, buckets);
+
+    for(int i = 0; i < n; i++)
+    {
+        const timeline_bucket_t &bucket = buckets[i];
+        bool empty = true;
+
+        for(int c = 0; c < NUM_TIMELINE_COUNTERS; c++)
+        {
+            empty = empty && bucket.counters[c] == 0;
+        }
+        if(empty)
+        {
+            continue;
+        }
+
+        time_t start = bucket.start;
+        struct tm local;
+        char text[32];
+
+        localtime_r(&start, &local);
+        strftime(text, sizeof(text), "%Y-%m-%d %H:%M", &local);
+        out << text;
+
+        for(int c = 0; c < NUM_TIMELINE_COUNTERS; c++)
+        {
+            out << " " << counter_names[c] << "=" << bucket.counters[c];
+        }
+        for(int g = 0; g < GESTURE_IDLE; g++)
+        {
+            if(bucket.gestures[g] > 0)
+            {
+                out << " " << gestureName((gestures_e)g) << "=" << bucket.gestures[g];
+            }
+        }
+        out << endl;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "gesture.h"
+
+using namespace std;
+
+// Time-bucketed interaction analytics
+//
+// Events land in the current bucket of two rings: a minute ring covering the
+// last TIMELINE_MINUTES and an hour ring covering the last TIMELINE_HOURS.
+// A bucket is cleared when its ring comes round to it again, so memory stays
+// the same however long the process runs. There is one writer, the decision
+// thread; any thread may query at any time.
+
+#define TIMELINE_MINUTES 120
+#define TIMELINE_HOURS 168
+
+enum timeline_counter_e
+{
+    TIMELINE_ENTRIES=0,             // people entering the centre zone
+    TIMELINE_GESTURES,              // gestures that started a clip
+    TIMELINE_CANCELS,               // clips stopped by the cancel gesture
+    TIMELINE_IDLE_LOOPS,            // idle video starts
+    TIMELINE_FIRST_GESTURES,        // visits that got as far as a gesture
+    TIMELINE_FIRST_GESTURE_MS,      // READY to first gesture, summed over those visits
+    TIMELINE_FIRST_GESTURE_MAX_MS,
+    TIMELINE_VISITS,                // people leaving the zone again
+    TIMELINE_DWELL_MS,              // READY to leaving, summed over those visits
+    NUM_TIMELINE_COUNTERS
+};
+
+enum timeline_scale_e
+{
+    TIMELINE_SCALE_MINUTE=0,
+    TIMELINE_SCALE_HOUR,
+    NUM_TIMELINE_SCALES
+};
+
+// A copy of one bucket, as returned by queries
+struct timeline_bucket_t
+{
+    int64_t start;                  // unix time, seconds
+    uint32_t counters[NUM_TIMELINE_COUNTERS];
+    uint32_t gestures[GESTURE_IDLE];
+};
+
+class AnalyticsTimeline
+{
+private:
+    struct slot_t
+    {
+        atomic<uint32_t> seq;       // odd while the slot is being cleared
+        atomic<int64_t> index;      // bucket number since the epoch
+        atomic<uint32_t> counters[NUM_TIMELINE_COUNTERS];
+        atomic<uint32_t> gestures[GESTURE_IDLE];
+    };
+
+    slot_t minutes[TIMELINE_MINUTES];
+    slot_t hours[TIMELINE_HOURS];
+
+    static int64_t bucketSeconds(timeline_scale_e scale);
+    slot_t *ring(timeline_scale_e scale, int *size);
+    slot_t &current(timeline_scale_e scale, int64_t now);
+    void add(timeline_counter_e counter, uint32_t value);
+
+public:
+    AnalyticsTimeline();
+
+    void personEntered(void);
+    void gestureStarted(gestures_e gesture);
+    void firstGesture(uint32_t msSinceReady);
+    void clipCancelled(void);
+    void idleLoop(void);
+    void personLeft(uint32_t msSinceReady);
+
+    // The newest count buckets of a scale, oldest first, ending with the
+    // current one. Buckets nothing happened in come back zeroed.
+    int query(timeline_scale_e scale, int count, timeline_bucket_t *out);
+
+    // Non-empty buckets of the newest count, one line each
+    void print(ostream &out, timeline_scale_e scale, int count);
+};
+
+extern AnalyticsTimeline analytics_timeline;
+
+#endif // TIMELINE_H
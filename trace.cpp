@@ -0,0 +1,137 @@
+#include "trace.h"
+#include "spscring.h"
+
+#include <chrono>
+#include <cstring>
+
+static SpscRing<trace_record_t, TRACE_RING_SIZE> traceRing;
+static atomic<bool> traceEnabled(false);
+
+static uint64_t nowNs(void)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void traceEvent(trace_kind_e kind, int id, int from, int to, uint32_t value)
+{
+    if(!traceEnabled.load(memory_order_relaxed))
+    {
+        return;
+    }
+
+    trace_record_t record;
+    record.time_ns = nowNs();
+    record.kind = (uint8_t)kind;
+    record.id = (uint8_t)id;
+    record.from = (uint8_t)from;
+    record.to = (uint8_t)to;
+    record.value = value;
+
+    traceRing.push(record);
+}
+
+const char *traceKindName(trace_kind_e kind)
+{
+    switch(kind)
+    {
+    case TRACE_STATIC_STATE: return "static";
+    case TRACE_DYNAMIC_STAGE: return "dynamic";
+    case TRACE_GESTURE_DETECTED: return "detected";
+    case TRACE_PROGRAM_STATE: return "program";
+    case TRACE_DROPPED: return "dropped";
+    default: return "undefined";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// TraceWriter
+
+bool TraceWriter::open(const string &path)
+{
+    trace_file_header_t header;
+
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        perror("Error opening trace file");
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(trace_record_t);
+    header.wallStart_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    header.steadyStart_ns = nowNs();
+    fwrite(&header, sizeof(header), 1, file);
+    fflush(file);
+
+    // Whatever piled up while nothing was writing belongs to no trace
+    trace_record_t stale;
+    while(traceRing.pop(stale));
+    dropsWritten = traceRing.drops();
+
+    running = true;
+    worker = thread(&TraceWriter::run, this);
+    traceEnabled = true;
+    return true;
+}
+
+void TraceWriter::close(void)
+{
+    if(!file)
+    {
+        return;
+    }
+
+    traceEnabled = false;
+    running = false;
+    worker.join();
+
+    drain();
+    fclose(file);
+    file = nullptr;
+}
+
+void TraceWriter::drain(void)
+{
+    trace_record_t batch[TRACE_BATCH];
+    size_t n = 0;
+
+    while(traceRing.pop(batch[n]))
+    {
+        if(++n == TRACE_BATCH)
+        {
+            fwrite(batch, sizeof(trace_record_t), n, file);
+            n = 0;
+        }
+    }
+
+    uint64_t drops = traceRing.drops();
+    if(drops != dropsWritten)
+    {
+        trace_record_t &record = batch[n++];
+        memset(&record, 0, sizeof(record));
+        record.time_ns = nowNs();
+        record.kind = TRACE_DROPPED;
+        record.value = (uint32_t)(drops - dropsWritten);
+        dropsWritten = drops;
+    }
+
+    if(n > 0)
+    {
+        fwrite(batch, sizeof(trace_record_t), n, file);
+    }
+    fflush(file);
+}
+
+void TraceWriter::run(void)
+{
+    while(running)
+    {
+        this_thread::sleep_for(chrono::milliseconds(TRACE_FLUSH_MS));
+        drain();
+    }
+}
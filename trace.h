@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Binary trace of gesture and program state transitions (.ettr)
+//
+// traceEvent() only copies a 16 byte record into a lock-free ring; a
+// TraceWriter thread drains the ring to disk in batches. ettrace turns a
+// trace file back into text. File layout, little endian:
+//   trace_file_header_t
+//   trace_record_t x N
+
+#define TRACE_MAGIC "ETTR"
+#define TRACE_VERSION 1
+#define TRACE_RING_SIZE 4096
+#define TRACE_FLUSH_MS 250
+#define TRACE_BATCH 256
+
+enum trace_kind_e
+{
+    TRACE_STATIC_STATE=0,       // id gesture, from/to static_gesture_states_e
+    TRACE_DYNAMIC_STAGE,        // id gesture, from/to stage index
+    TRACE_GESTURE_DETECTED,     // id gesture
+    TRACE_PROGRAM_STATE,        // from/to state_e
+    TRACE_DROPPED,              // value records lost to a full ring
+    TRACE_UNDEFINED
+};
+
+struct trace_record_t
+{
+    uint64_t time_ns;           // steady clock
+    uint8_t kind;               // trace_kind_e
+    uint8_t id;
+    uint8_t from;
+    uint8_t to;
+    uint32_t value;             // milliseconds spent in the old state
+};
+
+struct trace_file_header_t
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t recordSize;
+    int64_t wallStart_ns;       // system clock when the trace was opened
+    uint64_t steadyStart_ns;    // steady clock at the same moment
+};
+
+static_assert(sizeof(trace_record_t) == 16, "trace record must stay 16 bytes");
+static_assert(sizeof(trace_file_header_t) == 24, "trace file header must stay 24 bytes");
+
+// Record one transition. Call from the decision thread only; does nothing
+// unless a TraceWriter is open.
+void traceEvent(trace_kind_e kind, int id, int from, int to, uint32_t value);
+
+class TraceWriter
+{
+private:
+    FILE *file;
+    atomic<bool> running;
+    thread worker;
+    uint64_t dropsWritten;
+
+    void drain(void);
+    void run(void);
+
+public:
+    TraceWriter() : file(nullptr), running(false), dropsWritten(0) {}
+    ~TraceWriter() { close(); }
+
+    bool open(const string &path);
+    void close(void);
+};
+
+const char *traceKindName(trace_kind_e kind);
+
+#endif // TRACE_H
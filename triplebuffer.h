@@ -0,0 +1,100 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "spscring.h"
+
+using namespace std;
+
+// Newest-only handoff between one producer and one consumer. Of three slots
+// the producer writes one, the consumer reads another, and the third holds
+// the newest finished item. Publishing swaps the written slot in; an item
+// there the consumer never took is overwritten and counted in drops(). So
+// neither side ever blocks or waits, and the consumer always gets the newest
+// item, however far behind it fell.
+template <typename T>
+class TripleBuffer
+{
+private:
+    // The ready slot's index, with this bit set until the consumer takes it
+    static const uint8_t FRESH = 4;
+
+    T slots[3];
+    uint8_t back;       // the producer's slot
+    alignas(CACHE_LINE_SIZE) uint8_t front;     // the consumer's slot
+    alignas(CACHE_LINE_SIZE) atomic<uint8_t> ready;
+    alignas(CACHE_LINE_SIZE) atomic<uint64_t> dropCount;
+
+public:
+    TripleBuffer() : back(0), front(1), ready(2), dropCount(0) {}
+
+    // The producer fills the slot claim() returns, in place, and then
+    // publish()es it
+    T *claim(void)
+    {
+        return &slots[back];
+    }
+
+    void publish(void)
+    {
+        uint8_t previous = ready.exchange(back | FRESH, memory_order_acq_rel);
+
+        if(previous & FRESH)
+        {
+            dropCount.fetch_add(1, memory_order_relaxed);
+        }
+        back = previous & ~FRESH;
+    }
+
+    void push(const T &item)
+    {
+        *claim() = item;
+        publish();
+    }
+
+    // The newest item not yet taken, or nullptr. It stays where it lies,
+    // untouched by the producer, until the next call.
+    const T *peekLatest(void)
+    {
+        if(!(ready.load(memory_order_relaxed) & FRESH))
+        {
+            return nullptr;
+        }
+
+        front = ready.exchange(front, memory_order_acq_rel) & ~FRESH;
+        return &slots[front];
+    }
+
+    bool popLatest(T &item)
+    {
+        const T *latest = peekLatest();
+
+        if(!latest)
+        {
+            return false;
+        }
+        item = *latest;
+        return true;
+    }
+
+    // 1 while a published item waits for the consumer
+    size_t depth(void) const
+    {
+        return (ready.load(memory_order_acquire) & FRESH) ? 1 : 0;
+    }
+
+    uint64_t drops(void) const
+    {
+        return dropCount.load(memory_order_relaxed);
+    }
+
+    size_t capacity(void) const
+    {
+        return 1;
+    }
+};
+
+#endif // TRIPLEBUFFER_H
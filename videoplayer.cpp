@@ -0,0 +1,719 @@
+#include "videoplayer.h"
+
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// ---------------------------------------------------------------------------
+// VlcSink
+
+static string decodeUri(const string &uri)
+{
+    string out;
+    size_t i = 0;
+
+    if(uri.compare(0, 7, "file://") == 0)
+    {
+        i = 7;
+    }
+
+    for(; i < uri.size(); i++)
+    {
+        if(uri[i] == '%' && i + 2 < uri.size())
+        {
+            out += (char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        }
+        else
+        {
+            out += uri[i];
+        }
+    }
+
+    return out;
+}
+
+bool VlcSink::open(void)
+{
+    int in_fds[2];
+    int out_fds[2];
+
+    if(isAlive())
+    {
+        return true;
+    }
+
+    // Collect the reader of a player that has died, and the command pipe
+    // it left behind
+    if(reader.joinable())
+    {
+        reader.join();
+    }
+    if(cmd_fd >= 0)
+    {
+        ::close(cmd_fd);
+        cmd_fd = -1;
+    }
+
+    // A dead player must not take us down with SIGPIPE on the next write
+    signal(SIGPIPE, SIG_IGN);
+
+    if(pipe(in_fds) != 0)
+    {
+        perror("Error creating player pipe");
+        return false;
+    }
+    if(pipe(out_fds) != 0)
+    {
+        perror("Error creating player pipe");
+        ::close(in_fds[0]);
+        ::close(in_fds[1]);
+        return false;
+    }
+
+    pid_t child = fork();
+    if(child < 0)
+    {
+        perror("Error starting player");
+        ::close(in_fds[0]);
+        ::close(in_fds[1]);
+        ::close(out_fds[0]);
+        ::close(out_fds[1]);
+        return false;
+    }
+
+    if(child == 0)
+    {
+        int devnull = ::open("/dev/null", O_WRONLY);
+
+        dup2(in_fds[0], STDIN_FILENO);
+        dup2(out_fds[1], STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        ::close(in_fds[0]);
+        ::close(in_fds[1]);
+        ::close(out_fds[0]);
+        ::close(out_fds[1]);
+        ::close(devnull);
+
+        execlp(VLC_BIN, VLC_BIN, VLC_ARGS, (char *)nullptr);
+        _exit(127);
+    }
+
+    ::close(in_fds[0]);
+    ::close(out_fds[1]);
+    cmd_fd = in_fds[1];
+    out_fd = out_fds[0];
+    fcntl(cmd_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(out_fd, F_SETFD, FD_CLOEXEC);
+
+    {
+        lock_guard<mutex> guard(lock);
+        pid = child;
+    }
+    alive = true;
+    reader = thread(&VlcSink::readEvents, this);
+
+    return true;
+}
+
+void VlcSink::close(void)
+{
+    if(alive)
+    {
+        send("quit");
+
+        // Give VLC a moment to exit on its own before forcing it
+        for(int i = 0; i < 20 && alive; i++)
+        {
+            usleep(50000);
+        }
+
+        // The reader clears pid when it reaps the player, so a pid still set
+        // is at worst a zombie and never someone else's process
+        lock_guard<mutex> guard(lock);
+        if(pid > 0)
+        {
+            kill(pid, SIGKILL);
+        }
+    }
+
+    if(reader.joinable())
+    {
+        reader.join();
+    }
+
+    if(cmd_fd >= 0)
+    {
+        ::close(cmd_fd);
+        cmd_fd = -1;
+    }
+}
+
+bool VlcSink::isAlive(void)
+{
+    return alive;
+}
+
+void VlcSink::readEvents(void)
+{
+    char buf[512];
+    string line;
+    ssize_t n;
+
+    while((n = read(out_fd, buf, sizeof(buf))) > 0)
+    {
+        for(ssize_t i = 0; i < n; i++)
+        {
+            if(buf[i] == '\n')
+            {
+                parseLine(line);
+                line.clear();
+            }
+            else
+            {
+                line += buf[i];
+            }
+        }
+    }
+
+    // The pipe only closes when VLC goes away. Wait for it to exit without
+    // reaping, then reap it and clear pid together so close() cannot signal
+    // a recycled pid.
+    siginfo_t info;
+    pid_t child;
+    {
+        lock_guard<mutex> guard(lock);
+        child = pid;
+    }
+    while(waitid(P_PID, child, &info, WEXITED | WNOWAIT) != 0 && errno == EINTR)
+    {
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        waitpid(child, nullptr, 0);
+        pid = -1;
+    }
+    ::close(out_fd);
+    out_fd = -1;
+    alive = false;
+
+    if(listener)
+    {
+        listener->onPlayerExited();
+    }
+}
+
+void VlcSink::parseLine(const string &line)
+{
+    const string new_input("new input: ");
+    size_t pos;
+
+    if(!listener || line.find("status change:") == string::npos)
+    {
+        return;
+    }
+
+    if((pos = line.find(new_input)) != string::npos)
+    {
+        string uri = line.substr(pos + new_input.size());
+        size_t close_paren = uri.rfind(" )");
+        if(close_paren != string::npos)
+        {
+            uri.erase(close_paren);
+        }
+        listener->onClipStarted(decodeUri(uri));
+    }
+    else if(line.find("stop state") != string::npos)
+    {
+        listener->onClipEnded();
+    }
+}
+
+void VlcSink::send(const string &cmd)
+{
+    string line(cmd + "\n");
+
+    if(cmd_fd < 0)
+    {
+        return;
+    }
+
+    if(write(cmd_fd, line.c_str(), line.size()) != (ssize_t)line.size())
+    {
+        perror("Error writing to player");
+    }
+}
+
+void VlcSink::play(const string &path)
+{
+    // Restart the player if it died since the last clip
+    if(!open())
+    {
+        return;
+    }
+
+    send("clear");
+    send("add file://" + path);
+}
+
+void VlcSink::enqueue(const string &path)
+{
+    if(!open())
+    {
+        return;
+    }
+
+    send("enqueue file://" + path);
+    send("play");
+}
+
+void VlcSink::stop(void)
+{
+    if(isAlive())
+    {
+        send("stop");
+        send("clear");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// StubSink
+
+void StubSink::record(const string &cmd, const string &arg)
+{
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    log << "[" << fixed << setprecision(3) << setw(12) << ms << " ms] " << cmd;
+    if(!arg.empty())
+    {
+        log << " " << arg;
+    }
+    log << endl;
+}
+
+bool StubSink::open(void)
+{
+    record("OPEN", "");
+    return true;
+}
+
+void StubSink::close(void)
+{
+    record("CLOSE", "");
+}
+
+void StubSink::play(const string &path)
+{
+    record("PLAY", path);
+
+    {
+        lock_guard<mutex> guard(lock);
+        queued.clear();
+        playing = true;
+        started++;
+    }
+
+    if(listener)
+    {
+        listener->onClipStarted(path);
+    }
+}
+
+void StubSink::enqueue(const string &path)
+{
+    bool start_now;
+
+    record("ENQUEUE", path);
+
+    {
+        lock_guard<mutex> guard(lock);
+        start_now = !playing;
+        if(start_now)
+        {
+            playing = true;
+            started++;
+        }
+        else
+        {
+            queued.push_back(path);
+        }
+    }
+
+    if(start_now && listener)
+    {
+        listener->onClipStarted(path);
+    }
+}
+
+void StubSink::stop(void)
+{
+    record("STOP", "");
+
+    {
+        lock_guard<mutex> guard(lock);
+        queued.clear();
+        playing = false;
+    }
+
+    if(listener)
+    {
+        listener->onClipEnded();
+    }
+}
+
+void StubSink::finish(void)
+{
+    string next;
+
+    record("FINISH", "");
+
+    {
+        lock_guard<mutex> guard(lock);
+        if(queued.empty())
+        {
+            playing = false;
+        }
+        else
+        {
+            next = queued.front();
+            queued.pop_front();
+            started++;
+        }
+    }
+
+    if(listener)
+    {
+        if(next.empty())
+        {
+            listener->onClipEnded();
+        }
+        else
+        {
+            listener->onClipStarted(next);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// VideoPlayer
+
+VideoPlayer::VideoPlayer(PlayerSink *sink) : sink(sink), busy(false), currentType(GESTURE_UNDEFINED), awaitingStart(false), observer(nullptr),
+    loopGesture(GESTURE_UNDEFINED), loopSource(nullptr), loopClips(0)
+{
+    status.gesture = GESTURE_UNDEFINED;
+    status.since = chrono::steady_clock::now();
+
+    sink->setListener(this);
+
+    // Start the player up front so the first clip does not pay for it
+    sink->open();
+
+    worker = thread(&VideoPlayer::run, this);
+}
+
+VideoPlayer::~VideoPlayer()
+{
+    submit(PLAYER_CMD_QUIT, GESTURE_UNDEFINED, "");
+    worker.join();
+    sink->close();
+    sink->setListener(nullptr);
+}
+
+void VideoPlayer::submit(player_cmd_e type, gestures_e gesture, const string &path,
+                         ClipSource *source, const latency_stamps_t *stamps)
+{
+    player_cmd_t cmd;
+    cmd.type = type;
+    cmd.gesture = gesture;
+    cmd.path = path;
+
+    {
+        lock_guard<mutex> guard(lock);
+
+        if(type == PLAYER_CMD_LOOP && loopGesture == gesture && currentType == gesture)
+        {
+            return;
+        }
+
+        // A preempt, loop or stop makes anything still waiting obsolete
+        if(type != PLAYER_CMD_PLAY && type != PLAYER_CMD_LOOP_NEXT)
+        {
+            commands.clear();
+            expected.clear();
+        }
+        commands.push_back(cmd);
+
+        // Report the requested clip straight away so the FSM does not see a
+        // gap while the player is still switching over
+        if(type == PLAYER_CMD_PREEMPT || type == PLAYER_CMD_LOOP ||
+           (type == PLAYER_CMD_PLAY && currentType == GESTURE_UNDEFINED))
+        {
+            currentType = gesture;
+            awaitingStart = true;
+            requested = chrono::steady_clock::now();
+        }
+        else if(type == PLAYER_CMD_STOP || type == PLAYER_CMD_QUIT)
+        {
+            currentType = GESTURE_UNDEFINED;
+            awaitingStart = false;
+        }
+
+        if(type == PLAYER_CMD_LOOP)
+        {
+            loopGesture = gesture;
+            loopSource = source;
+        }
+        else if(type == PLAYER_CMD_STOP || type == PLAYER_CMD_QUIT)
+        {
+            loopGesture = GESTURE_UNDEFINED;
+            loopSource = nullptr;
+        }
+
+        if(type == PLAYER_CMD_PLAY || type == PLAYER_CMD_PREEMPT)
+        {
+            expected_clip_t clip;
+            clip.path = path;
+            clip.gesture = gesture;
+            clip.loop = false;
+            clip.stamps = latency_stamps_t();
+            if(stamps)
+            {
+                clip.stamps = *stamps;
+                clip.stamps.ns[LATENCY_COMMANDED] = latencyNow();
+            }
+            expected.push_back(clip);
+        }
+    }
+
+    wake.notify_one();
+}
+
+// Pick the loop's next clip and expect it, before the sink is told, so its
+// start event always finds it. False if no loop is running.
+bool VideoPlayer::queueLoopClip(string &path)
+{
+    gestures_e gesture;
+    ClipSource *source;
+
+    {
+        lock_guard<mutex> guard(lock);
+        gesture = loopGesture;
+        source = loopSource;
+    }
+
+    if(gesture == GESTURE_UNDEFINED || !source->nextClip(gesture, path))
+    {
+        return false;
+    }
+
+    lock_guard<mutex> guard(lock);
+    if(loopGesture != gesture)
+    {
+        return false;
+    }
+
+    expected_clip_t clip;
+    clip.path = path;
+    clip.gesture = gesture;
+    clip.loop = true;
+    clip.stamps = latency_stamps_t();
+    expected.push_back(clip);
+    return true;
+}
+
+void VideoPlayer::play(gestures_e gesture, const string &path)
+{
+    submit(PLAYER_CMD_PLAY, gesture, path);
+}
+
+void VideoPlayer::preempt(gestures_e gesture, const string &path, const latency_stamps_t *stamps)
+{
+    submit(PLAYER_CMD_PREEMPT, gesture, path, nullptr, stamps);
+}
+
+void VideoPlayer::loop(gestures_e gesture, ClipSource *source)
+{
+    submit(PLAYER_CMD_LOOP, gesture, "", source);
+}
+
+void VideoPlayer::stop(void)
+{
+    submit(PLAYER_CMD_STOP, GESTURE_UNDEFINED, "");
+}
+
+playback_status_t VideoPlayer::query(void)
+{
+    lock_guard<mutex> guard(lock);
+    return status;
+}
+
+void VideoPlayer::run(void)
+{
+    while(true)
+    {
+        player_cmd_t cmd;
+
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [this] { return !commands.empty(); });
+            cmd = commands.front();
+            commands.pop_front();
+            busy = true;
+        }
+
+        string first;
+        string next;
+
+        switch(cmd.type)
+        {
+        case PLAYER_CMD_PLAY:
+            sink->enqueue(cmd.path);
+            break;
+        case PLAYER_CMD_PREEMPT:
+        {
+            // A loop carries on once this clip is over
+            bool queued = queueLoopClip(next);
+            sink->play(cmd.path);
+            if(queued)
+            {
+                sink->enqueue(next);
+            }
+            break;
+        }
+        case PLAYER_CMD_LOOP:
+            if(queueLoopClip(first))
+            {
+                bool queued = queueLoopClip(next);
+                sink->play(first);
+                if(queued)
+                {
+                    sink->enqueue(next);
+                }
+            }
+            cmd.path = first;
+            break;
+        case PLAYER_CMD_LOOP_NEXT:
+            if(queueLoopClip(next))
+            {
+                sink->enqueue(next);
+            }
+            break;
+        case PLAYER_CMD_STOP:
+            sink->stop();
+            break;
+        case PLAYER_CMD_QUIT:
+            sink->stop();
+            return;
+        }
+
+        lock_guard<mutex> guard(lock);
+        if(cmd.type != PLAYER_CMD_LOOP_NEXT)
+        {
+            status.gesture = cmd.gesture;
+            status.path = cmd.path;
+            status.since = chrono::steady_clock::now();
+        }
+        busy = false;
+        idle.notify_all();
+    }
+}
+
+void VideoPlayer::waitIdle(void)
+{
+    unique_lock<mutex> guard(lock);
+    idle.wait(guard, [this] { return commands.empty() && !busy; });
+}
+
+void VideoPlayer::onClipStarted(const string &path)
+{
+    int64_t firstFrameUs = -1;
+    bool loopNext = false;
+    latency_stamps_t stamps = latency_stamps_t();
+
+    {
+        lock_guard<mutex> guard(lock);
+
+        for(size_t i = 0; i < expected.size(); i++)
+        {
+            if(expected[i].path == path)
+            {
+                bool loop = expected[i].loop;
+
+                stamps = expected[i].stamps;
+                currentType = expected[i].gesture;
+                expected.erase(expected.begin(), expected.begin() + i + 1);
+
+                // Keep the next pass queued behind this one
+                if(loop)
+                {
+                    loopClips++;
+                    loopNext = expected.empty() && loopGesture == currentType;
+                }
+                break;
+            }
+        }
+
+        if(awaitingStart)
+        {
+            firstFrameUs = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - requested).count();
+        }
+        awaitingStart = false;
+    }
+
+    if(loopNext)
+    {
+        submit(PLAYER_CMD_LOOP_NEXT, GESTURE_UNDEFINED, "");
+    }
+
+    if(stamps.ns[LATENCY_DECIDED] != 0)
+    {
+        stamps.ns[LATENCY_CONFIRMED] = latencyNow();
+        recordClipLatency(stamps);
+    }
+
+    FirstFrameObserver *o = observer.load();
+    if(o && firstFrameUs >= 0)
+    {
+        o->onFirstFrame(path, firstFrameUs);
+    }
+}
+
+void VideoPlayer::onClipEnded(void)
+{
+    lock_guard<mutex> guard(lock);
+
+    // The clip being replaced reports its end after the new one was asked for
+    if(awaitingStart &&
+       chrono::steady_clock::now() - requested < chrono::milliseconds(PLAYER_START_TIMEOUT_MS))
+    {
+        return;
+    }
+
+    if(expected.empty())
+    {
+        currentType = GESTURE_UNDEFINED;
+        awaitingStart = false;
+    }
+    else
+    {
+        // The player moves on to the next queued clip by itself
+        currentType = expected.front().gesture;
+        awaitingStart = true;
+        requested = chrono::steady_clock::now();
+    }
+}
+
+void VideoPlayer::onPlayerExited(void)
+{
+    lock_guard<mutex> guard(lock);
+
+    expected.clear();
+    currentType = GESTURE_UNDEFINED;
+    awaitingStart = false;
+    loopGesture = GESTURE_UNDEFINED;
+}
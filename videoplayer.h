@@ -0,0 +1,235 @@
+#ifndef VIDEOPLAYER_H
+#define VIDEOPLAYER_H
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+#include <sys/types.h>
+
+#include "gesture.h"
+#include "latency.h"
+
+using namespace std;
+
+// One VLC instance is started with the rc interface and kept for the whole run.
+// Clips are switched by writing rc commands to its stdin.
+#define VLC_BIN "vlc"
+#define VLC_ARGS "-I", "rc", "--rc-fake-tty", "-f", "--no-video-title-show", "--no-osd"
+
+// How long after a play command an end-of-clip event is still taken to
+// belong to the clip that was replaced rather than to the new one
+#define PLAYER_START_TIMEOUT_MS 3000
+
+// Receives start/end events pushed by a sink. Called on the sink's own thread.
+class PlaybackListener
+{
+public:
+    virtual ~PlaybackListener() {}
+
+    virtual void onClipStarted(const string &path) = 0;
+    virtual void onClipEnded(void) = 0;
+    virtual void onPlayerExited(void) = 0;
+};
+
+// Told how long each clip took from its play command to the player
+// reporting it started. Called on the sink's thread.
+class FirstFrameObserver
+{
+public:
+    virtual ~FirstFrameObserver() {}
+
+    virtual void onFirstFrame(const string &path, int64_t us) = 0;
+};
+
+// Supplies the clips of a loop one at a time. Called on the player's thread.
+class ClipSource
+{
+public:
+    virtual ~ClipSource() {}
+
+    // False if there is nothing to play for gesture
+    virtual bool nextClip(gestures_e gesture, string &path) = 0;
+};
+
+// Where the playback engine sends its commands. The real sink drives VLC,
+// StubSink just logs so the engine can be exercised without a screen.
+class PlayerSink
+{
+protected:
+    PlaybackListener *listener;
+
+public:
+    PlayerSink() : listener(nullptr) {}
+    virtual ~PlayerSink() {}
+
+    void setListener(PlaybackListener *l) { listener = l; }
+
+    virtual bool open(void) = 0;
+    virtual void close(void) = 0;
+
+    // Replace whatever is on screen with path right away
+    virtual void play(const string &path) = 0;
+    // Play path after the current clip, or right away if nothing is playing
+    virtual void enqueue(const string &path) = 0;
+    virtual void stop(void) = 0;
+};
+
+// VLC reports "status change:" lines on its rc output. A reader thread turns
+// those into listener events, and reaps the process if it exits.
+class VlcSink : public PlayerSink
+{
+private:
+    mutex lock;                 // guards pid against the reader reaping it
+    pid_t pid;
+    int cmd_fd;
+    int out_fd;
+    atomic<bool> alive;
+    thread reader;
+
+    bool isAlive(void);
+    void send(const string &cmd);
+    void readEvents(void);
+    void parseLine(const string &line);
+
+public:
+    VlcSink() : pid(-1), cmd_fd(-1), out_fd(-1), alive(false) {}
+    ~VlcSink() { close(); }
+
+    bool open(void);
+    void close(void);
+    void play(const string &path);
+    void enqueue(const string &path);
+    void stop(void);
+};
+
+// Starts clips instantly and only ends them when finish() is called
+class StubSink : public PlayerSink
+{
+private:
+    ostream &log;
+    chrono::steady_clock::time_point start;
+    mutex lock;
+    deque<string> queued;
+    bool playing;
+    atomic<uint64_t> started;
+
+    void record(const string &cmd, const string &arg);
+
+public:
+    StubSink(ostream &log) : log(log), start(chrono::steady_clock::now()), playing(false), started(0) {}
+
+    bool open(void);
+    void close(void);
+    void play(const string &path);
+    void enqueue(const string &path);
+    void stop(void);
+
+    // Simulate the current clip running to its end
+    void finish(void);
+
+    // Clips started so far, to tell a restart of the same clip from a new one
+    uint64_t clipsStarted(void) const { return started.load(); }
+};
+
+enum player_cmd_e
+{
+    PLAYER_CMD_PLAY=0,
+    PLAYER_CMD_PREEMPT,
+    PLAYER_CMD_STOP,
+    PLAYER_CMD_QUIT,
+    PLAYER_CMD_LOOP,
+    PLAYER_CMD_LOOP_NEXT        // queue the loop's next clip, sent by the player itself
+};
+
+struct player_cmd_t
+{
+    player_cmd_e type;
+    gestures_e gesture;
+    string path;
+};
+
+struct playback_status_t
+{
+    gestures_e gesture;
+    string path;
+    chrono::steady_clock::time_point since;
+};
+
+struct expected_clip_t
+{
+    string path;
+    gestures_e gesture;
+    bool loop;
+    latency_stamps_t stamps;    // all 0 unless the clip answers a gesture
+};
+
+// Long-lived playback engine. The main loop only queues commands here; a
+// worker thread hands them to the sink so a slow player never stalls a frame.
+// The type of the clip on screen is kept in an atomic fed by sink events.
+//
+// A loop keeps clips of one type playing back to back: the sink always has
+// the loop's next clip queued behind the one on screen, so the player moves
+// on by itself with no gap. A preempting clip interrupts the loop, which
+// carries on after it.
+class VideoPlayer : public PlaybackListener
+{
+private:
+    PlayerSink *sink;
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    condition_variable idle;
+    deque<player_cmd_t> commands;
+    bool busy;
+    playback_status_t status;
+
+    atomic<int> currentType;
+    deque<expected_clip_t> expected;
+    bool awaitingStart;
+    chrono::steady_clock::time_point requested;
+    atomic<FirstFrameObserver *> observer;
+
+    gestures_e loopGesture;     // GESTURE_UNDEFINED when not looping
+    ClipSource *loopSource;
+    atomic<uint64_t> loopClips;
+
+    void submit(player_cmd_e type, gestures_e gesture, const string &path,
+                ClipSource *source = nullptr, const latency_stamps_t *stamps = nullptr);
+    bool queueLoopClip(string &path);
+    void run(void);
+
+public:
+    VideoPlayer(PlayerSink *sink);
+    ~VideoPlayer();
+
+    void play(gestures_e gesture, const string &path);
+    // stamps, if given, go into the latency histograms once the clip is on screen
+    void preempt(gestures_e gesture, const string &path, const latency_stamps_t *stamps = nullptr);
+    // Loop clips of gesture from source. Does nothing if that loop is on screen already.
+    void loop(gestures_e gesture, ClipSource *source);
+    void stop(void);
+    playback_status_t query(void);
+
+    // Block until every command submitted so far has reached the sink
+    void waitIdle(void);
+
+    // nullptr to stop reporting; the observer must outlive any report in flight
+    void setFirstFrameObserver(FirstFrameObserver *o) { observer = o; }
+
+    // Type of the clip on screen, GESTURE_UNDEFINED when nothing is playing
+    gestures_e current(void) { return (gestures_e)currentType.load(memory_order_acquire); }
+
+    // Loop clips the player has started, each pass of a loop counting once
+    uint64_t loopClipsStarted(void) const { return loopClips.load(memory_order_relaxed); }
+
+    void onClipStarted(const string &path);
+    void onClipEnded(void);
+    void onPlayerExited(void);
+};
+
+#endif // VIDEOPLAYER_H